@@ -0,0 +1,381 @@
+/*
+ * Copyright 2020 Joe T. Sylve, Ph.D.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include "bit.hpp"
+#include "bitmap.hpp"
+
+namespace yat {
+
+/// A bitmap that can be modified by many threads at once without locking.
+///
+/// Each storage word is a `std::atomic<uint64_t>`.  Single bits are set and
+/// cleared with atomic read-modify-write operations and ranges of bits are
+/// claimed with compare-and-swap, so that a claim either sets every bit in the
+/// range or, if any of them were already set, none of them.  This makes it
+/// suitable for allocators where threads claim free bits or runs of bits and
+/// release them again.
+///
+/// Read-only scanning is done on a `snapshot()`.
+class atomic_bitmap {
+  static constexpr uint64_t word_bits = std::numeric_limits<uint64_t>::digits;
+  static constexpr uint64_t all_ones = std::numeric_limits<uint64_t>::max();
+
+  /// The number of bits in a cache line.  Claims that aren't given a hint
+  /// start at a cache line chosen by the calling thread so that threads don't
+  /// all contend for the first words.
+  static constexpr uint64_t line_bits = 512;
+
+  /// Calculate the number of words we need to store n bits
+  static constexpr uint64_t cas(uint64_t n) noexcept {
+    return (n + word_bits - 1) / word_bits;
+  }
+
+  /// Calculate the storage index of a bit
+  static constexpr size_t si(uint64_t n) noexcept {
+    return static_cast<size_t>(n / word_bits);
+  }
+
+  /// Calculate the bit mask of a bit in its storage word
+  static constexpr uint64_t bm(uint64_t n) noexcept {
+    return uint64_t{1} << (n % word_bits);
+  }
+
+ public:
+  /// Special marker that is returned when there are no bits left to claim
+  static constexpr uint64_t no_bits_left = bitmap_view::no_bits_left;
+
+  /// Create an empty bitmap
+  atomic_bitmap() noexcept {};  // clang 5 had a bug when using
+                                // "= default" here
+
+  /// Create a bitmap with `n` unset bits
+  explicit atomic_bitmap(uint64_t n)
+      : _words(static_cast<size_t>(cas(n))), _count{n} {}
+
+  /// Create a bitmap that holds a copy of the bits in a view
+  explicit atomic_bitmap(const bitmap_view& view)
+      : atomic_bitmap{view.count()} {
+    for (size_t i = 0; i < _words.size(); i++) {
+      _words[i].store(view.word(i) & valid_mask(i), std::memory_order_relaxed);
+    }
+  }
+
+  // The words can't be copied atomically
+  atomic_bitmap(const atomic_bitmap&) = delete;
+  atomic_bitmap& operator=(const atomic_bitmap&) = delete;
+
+  /// Return the count of bits in the set
+  [[nodiscard]] uint64_t count() const noexcept { return _count; }
+
+  /// Returns the value of a given bit.  No bounds checking is performed and
+  /// accessing an invalid index is undefined behavior.
+  [[nodiscard]] bool test(
+      uint64_t n,
+      std::memory_order order = std::memory_order_seq_cst) const noexcept {
+    return (_words[si(n)].load(order) & bm(n)) != 0;
+  }
+
+  /// Access a given bit.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  bool operator[](uint64_t n) const noexcept { return test(n); }
+
+  /// Set a given bit.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  void set(uint64_t n,
+           std::memory_order order = std::memory_order_seq_cst) noexcept {
+    _words[si(n)].fetch_or(bm(n), order);
+  }
+
+  /// Clear a given bit.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  void clear(uint64_t n,
+             std::memory_order order = std::memory_order_seq_cst) noexcept {
+    _words[si(n)].fetch_and(~bm(n), order);
+  }
+
+  /// Set a given bit and return its previous value.  No bounds checking is
+  /// performed and accessing an invalid index is undefined behavior.
+  bool test_and_set(uint64_t n, std::memory_order order =
+                                    std::memory_order_seq_cst) noexcept {
+    return (_words[si(n)].fetch_or(bm(n), order) & bm(n)) != 0;
+  }
+
+  /// Clear a given bit and return its previous value.  No bounds checking is
+  /// performed and accessing an invalid index is undefined behavior.
+  bool test_and_clear(uint64_t n, std::memory_order order =
+                                      std::memory_order_seq_cst) noexcept {
+    return (_words[si(n)].fetch_and(~bm(n), order) & bm(n)) != 0;
+  }
+
+  /// Atomically sets the bits [start, start + count) if none of them are set.
+  ///
+  /// Returns true if the bits were claimed.  If any of them were already set,
+  /// then the bits that this call had set are cleared again and false is
+  /// returned.  No bounds checking is performed and accessing an invalid index
+  /// is undefined behavior.
+  bool try_claim(uint64_t start, uint64_t count) noexcept {
+    uint64_t claimed = 0;
+
+    const bool ok = detail::visit_word_range(
+        start, count,
+        [this, &claimed](uint64_t w, uint64_t mask) {
+          if (!claim_word(static_cast<size_t>(w), mask)) {
+            return false;
+          }
+
+          claimed += static_cast<uint64_t>(popcount(mask));
+          return true;
+        },
+        [this, &claimed](uint64_t first, uint64_t last) {
+          for (auto w = first; w < last; w++) {
+            if (!claim_word(static_cast<size_t>(w), all_ones)) {
+              return false;
+            }
+
+            claimed += word_bits;
+          }
+
+          return true;
+        });
+
+    // Roll back the part of the range that we did manage to claim
+    if (!ok) {
+      release(start, claimed);
+    }
+
+    return ok;
+  }
+
+  /// Clears the bits [start, start + count), such as after they were claimed.
+  /// No bounds checking is performed and accessing an invalid index is
+  /// undefined behavior.
+  void release(uint64_t start, uint64_t count) noexcept {
+    detail::visit_word_range(
+        start, count,
+        [this](uint64_t w, uint64_t mask) {
+          _words[static_cast<size_t>(w)].fetch_and(~mask,
+                                                   std::memory_order_release);
+          return true;
+        },
+        [this](uint64_t first, uint64_t last) {
+          for (auto w = first; w < last; w++) {
+            _words[static_cast<size_t>(w)].store(0, std::memory_order_release);
+          }
+
+          return true;
+        });
+  }
+
+  /// Claims the first unset bit at or after `hint`, wrapping around to the
+  /// start of the bitmap if needed.  Returns the index of the claimed bit or
+  /// `no_bits_left` if every bit is set.
+  uint64_t claim_first(uint64_t hint) noexcept {
+    if (_words.empty()) {
+      return no_bits_left;
+    }
+
+    hint = (hint < _count) ? hint : 0;
+
+    const auto first = si(hint);
+    const auto n = _words.size();
+
+    for (size_t i = 0; i <= n; i++) {
+      const auto w = (first + i) % n;
+
+      // Start at the hinted bit in the hinted word, but come back to its
+      // earlier bits once we've wrapped around
+      const auto from = (i == 0) ? ~detail::word_mask(0, hint % word_bits)
+                                 : all_ones;
+
+      if (const auto b = claim_bit(w, valid_mask(w) & from);
+          b != no_bits_left) {
+        return b;
+      }
+    }
+
+    return no_bits_left;
+  }
+
+  /// Claims an unset bit, starting the search at a cache line chosen by the
+  /// calling thread (see claim_first)
+  uint64_t claim_first() noexcept { return claim_first(thread_hint()); }
+
+  /// Claims the first run of `length` unset bits at or after `hint`, wrapping
+  /// around to the start of the bitmap if needed.  Returns the start of the
+  /// claimed run or `no_bits_left` if there's no such run.
+  uint64_t claim_run(uint64_t length, uint64_t hint) noexcept {
+    if (length == 0 || length > _count) {
+      return no_bits_left;
+    }
+
+    hint = (hint < _count) ? hint : 0;
+
+    // Search from the hint to the end and then from the start up to the end
+    // of any run that could include the hint
+    const uint64_t windows[2][2] = {
+        {hint, _count},
+        {0, std::min(_count, hint + length - 1)},
+    };
+
+    for (const auto& [first, last] : windows) {
+      auto s = find_clear_run(length, first, last);
+
+      while (s != no_bits_left) {
+        if (try_claim(s, length)) {
+          return s;
+        }
+
+        // Someone else got in first, so keep looking past the start
+        s = find_clear_run(length, s + 1, last);
+      }
+    }
+
+    return no_bits_left;
+  }
+
+  /// Claims a run of `length` unset bits, starting the search at a cache line
+  /// chosen by the calling thread (see claim_run)
+  uint64_t claim_run(uint64_t length) noexcept {
+    return claim_run(length, thread_hint());
+  }
+
+  /// Returns a copy of the bits that can be viewed or scanned.  Each word is
+  /// read atomically, but the words are read one at a time, so the copy is
+  /// only consistent if nothing is modifying the bitmap.
+  [[nodiscard]] bitmap snapshot(
+      std::memory_order order = std::memory_order_acquire) const {
+    bitmap copy{_count};
+
+    for (size_t i = 0; i < _words.size(); i++) {
+      copy._storage[i] = _words[i].load(order);
+    }
+
+    return copy;
+  }
+
+ private:
+  /// Returns the mask of the bits of a word that are within the bitmap
+  [[nodiscard]] uint64_t valid_mask(size_t w) const noexcept {
+    if (w + 1 == _words.size() && _count % word_bits != 0) {
+      return detail::word_mask(0, _count % word_bits);
+    }
+
+    return all_ones;
+  }
+
+  /// Returns a starting point for claims that differs between threads
+  [[nodiscard]] uint64_t thread_hint() const noexcept {
+    if (_count == 0) {
+      return 0;
+    }
+
+    const auto lines = (_count + line_bits - 1) / line_bits;
+    const auto h = std::hash<std::thread::id>{}(std::this_thread::get_id());
+
+    return (static_cast<uint64_t>(h) % lines) * line_bits;
+  }
+
+  /// Sets the bits of a mask in a word if none of them are set
+  bool claim_word(size_t w, uint64_t mask) noexcept {
+    auto& word = _words[w];
+    auto value = word.load(std::memory_order_relaxed);
+
+    do {
+      if ((value & mask) != 0) {
+        return false;
+      }
+    } while (!word.compare_exchange_weak(value, value | mask,
+                                         std::memory_order_acq_rel,
+                                         std::memory_order_relaxed));
+
+    return true;
+  }
+
+  /// Claims the lowest unset bit of a word that is in `candidates`, returning
+  /// its index or `no_bits_left` if there are none
+  uint64_t claim_bit(size_t w, uint64_t candidates) noexcept {
+    auto& word = _words[w];
+    auto value = word.load(std::memory_order_relaxed);
+
+    while (const auto free = ~value & candidates) {
+      const auto bit = free & (~free + 1);
+
+      if (word.compare_exchange_weak(value, value | bit,
+                                     std::memory_order_acq_rel,
+                                     std::memory_order_relaxed)) {
+        return w * word_bits + static_cast<uint64_t>(countr_zero(bit));
+      }
+    }
+
+    return no_bits_left;
+  }
+
+  /// Returns the start of the first run of `length` unset bits that lies
+  /// within [first, last), or `no_bits_left` if there is none.  The words are
+  /// read without synchronizing with other threads, so the run has to be
+  /// claimed before it can be relied on.
+  [[nodiscard]] uint64_t find_clear_run(uint64_t length, uint64_t first,
+                                        uint64_t last) const noexcept {
+    uint64_t run_start = first;
+    uint64_t pos = first;
+
+    while (pos < last) {
+      const auto w = si(pos);
+      const auto b = pos % word_bits;
+
+      // Shift away the bits before `pos` and treat the bits beyond the end of
+      // the bitmap as set so that runs can't extend into them
+      const auto value =
+          (_words[w].load(std::memory_order_relaxed) | ~valid_mask(w)) >> b;
+
+      // Count the unset bits that follow pos and then the set bits after
+      // them, which end the current run
+      const auto zeros =
+          std::min(static_cast<uint64_t>(countr_zero(value)), word_bits - b);
+
+      if (zeros != 0) {
+        pos += zeros;
+
+        if (std::min(pos, last) - run_start >= length) {
+          return run_start;
+        }
+
+        if (zeros == word_bits - b) {
+          continue;
+        }
+      }
+
+      pos += static_cast<uint64_t>(countr_one(value >> zeros));
+      run_start = pos;
+    }
+
+    return no_bits_left;
+  }
+
+  std::vector<std::atomic<uint64_t>> _words{};  ///< The storage words
+  uint64_t _count{};                           ///< The number of bits
+};
+
+}  // namespace yat
@@ -0,0 +1,610 @@
+/*
+ * Copyright 2020 Joe T. Sylve, Ph.D.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+#include "bit.hpp"
+#include "bitmap.hpp"
+#include "endian.hpp"
+#include "ranges.hpp"
+
+namespace yat::detail {
+
+/// Returns the `n` bits (at most 64) that start at bit `b` of the byte at
+/// `p`.  Only the bytes that hold the bits are read.
+[[nodiscard]] inline uint64_t load_bits(const std::byte* p, uint64_t b,
+                                        uint64_t n) noexcept {
+  constexpr uint64_t word_bits = std::numeric_limits<uint64_t>::digits;
+
+  const auto num_bytes = static_cast<size_t>((b + n + 7) / 8);
+  little_uint64_t raw{};
+
+  if (num_bytes >= sizeof(raw)) {
+    std::memcpy(static_cast<void*>(&raw), p, sizeof(raw));
+  } else {
+    std::memcpy(static_cast<void*>(&raw), p, num_bytes);
+  }
+
+  auto bits = uint64_t{raw} >> b;
+
+  // Bits that don't start at a byte boundary can spill into a ninth byte
+  if (num_bytes > sizeof(raw)) {
+    bits |= std::to_integer<uint64_t>(p[sizeof(raw)]) << (word_bits - b);
+  }
+
+  return bits & word_mask(0, n);
+}
+
+/// Stores the low `n` bits (at most 64) of `bits` starting at bit `b` of the
+/// byte at `p`.  Only the bytes that hold the bits are written and the other
+/// bits of those bytes are left alone.
+inline void store_bits(std::byte* p, uint64_t b, uint64_t bits,
+                       uint64_t n) noexcept {
+  constexpr uint64_t word_bits = std::numeric_limits<uint64_t>::digits;
+
+  const auto num_bytes = static_cast<size_t>((b + n + 7) / 8);
+  little_uint64_t raw{};
+
+  // Whole words don't need to be merged
+  if (b == 0 && n == word_bits) {
+    raw = bits;
+    std::memcpy(p, static_cast<const void*>(&raw), sizeof(raw));
+    return;
+  }
+
+  const auto head = std::min(num_bytes, sizeof(raw));
+  std::memcpy(static_cast<void*>(&raw), p, head);
+
+  const auto mask = word_mask(b, std::min(n, word_bits - b));
+  raw = (uint64_t{raw} & ~mask) | ((bits << b) & mask);
+  std::memcpy(p, static_cast<const void*>(&raw), head);
+
+  // Bits that don't start at a byte boundary can spill into a ninth byte
+  if (num_bytes > sizeof(raw)) {
+    const auto spill = word_mask(0, b + n - word_bits);
+    const auto val = std::to_integer<uint64_t>(p[sizeof(raw)]);
+
+    p[sizeof(raw)] = static_cast<std::byte>(
+        (val & ~spill) | ((bits >> (word_bits - b)) & spill));
+  }
+}
+
+/// Moves a (byte, bit) position forward by `n` bits
+template <typename BytePointer>
+constexpr void advance_bits(BytePointer& p, uint64_t& b, uint64_t n) noexcept {
+  b += n;
+  p += b / 8;
+  b %= 8;
+}
+
+}  // namespace yat::detail
+
+namespace yat {
+
+/// A proxy reference to a single bit of a bit_span, like
+/// std::vector<bool>::reference
+class bit_reference {
+ public:
+  /// Create a reference to bit `bit` of the byte at `byte`
+  constexpr bit_reference(std::byte* byte, unsigned bit) noexcept
+      : _byte{byte}, _mask{static_cast<std::byte>(1U << bit)} {}
+
+  /// Copy constructor.  This refers to the same bit as `other`.
+  constexpr bit_reference(const bit_reference& other) noexcept = default;
+
+  /// Returns the value of the bit
+  constexpr operator bool() const noexcept {
+    return (*_byte & _mask) != std::byte{};
+  }
+
+  /// Returns the inverse of the value of the bit
+  constexpr bool operator~() const noexcept { return !bool{*this}; }
+
+  /// Sets or clears the bit.  This is const, like
+  /// std::vector<bool>::reference in C++23, so that iterators of a bit_span
+  /// can be used as output iterators by the ranges algorithms.
+  constexpr const bit_reference& operator=(bool value) const noexcept {
+    if (value) {
+      *_byte |= _mask;
+    } else {
+      *_byte &= ~_mask;
+    }
+
+    return *this;
+  }
+
+  /// Assigns the value of the bit that `other` refers to
+  constexpr const bit_reference& operator=(
+      const bit_reference& other) const noexcept {
+    return *this = bool{other};
+  }
+
+  /// Flips the bit
+  constexpr void flip() const noexcept { *_byte ^= _mask; }
+
+ private:
+  std::byte* _byte;  ///< The byte that holds the bit
+  std::byte _mask;   ///< The mask of the bit within the byte
+};
+
+/// A random access iterator over the bits of a bit_span.  Bits are addressed
+/// by the byte that holds them and their position within it, so bits can be
+/// read and written without touching any other bytes.
+template <bool Const>
+class basic_bit_iterator {
+  using byte_pointer = std::conditional_t<Const, const std::byte*, std::byte*>;
+
+ public:
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = bool;
+  using difference_type = std::ptrdiff_t;
+  using pointer = void;
+  using reference = std::conditional_t<Const, bool, bit_reference>;
+
+  /// Construct an empty iterator
+  constexpr basic_bit_iterator() noexcept {};  // clang 5 had a bug when using
+                                               // "= default" here
+
+  /// Construct an iterator to bit `bit` (from 0 to 7) of the byte at `byte`
+  constexpr basic_bit_iterator(byte_pointer byte, unsigned bit) noexcept
+      : _byte{byte}, _bit{bit} {}
+
+  /// Convert an iterator over mutable bits into an iterator over const bits
+  template <bool C = Const, std::enable_if_t<C, int> = 0>
+  constexpr basic_bit_iterator(const basic_bit_iterator<false>& it) noexcept
+      : _byte{it.data()}, _bit{it.offset()} {}
+
+  /// Returns a pointer to the byte that holds the current bit
+  [[nodiscard]] constexpr byte_pointer data() const noexcept { return _byte; }
+
+  /// Returns the position of the current bit within its byte
+  [[nodiscard]] constexpr unsigned offset() const noexcept { return _bit; }
+
+  /// Dereference operator
+  constexpr reference operator*() const noexcept {
+    if constexpr (Const) {
+      return ((*_byte >> _bit) & std::byte{1}) != std::byte{};
+    } else {
+      return bit_reference{_byte, _bit};
+    }
+  }
+
+  /// Subscript operator
+  constexpr reference operator[](difference_type n) const noexcept {
+    return *(*this + n);
+  }
+
+  /// Prefix increment operator
+  constexpr basic_bit_iterator& operator++() noexcept {
+    if (++_bit == 8) {
+      _bit = 0;
+      _byte++;
+    }
+
+    return *this;
+  }
+
+  /// Postfix increment operator
+  constexpr basic_bit_iterator operator++(int) noexcept {
+    basic_bit_iterator copy{*this};
+
+    operator++();
+
+    return copy;
+  }
+
+  /// Prefix decrement operator
+  constexpr basic_bit_iterator& operator--() noexcept {
+    if (_bit == 0) {
+      _bit = 8;
+      _byte--;
+    }
+
+    _bit--;
+
+    return *this;
+  }
+
+  /// Postfix decrement operator
+  constexpr basic_bit_iterator operator--(int) noexcept {
+    basic_bit_iterator copy{*this};
+
+    operator--();
+
+    return copy;
+  }
+
+  /// Advance the iterator by `n` bits
+  constexpr basic_bit_iterator& operator+=(difference_type n) noexcept {
+    n += static_cast<difference_type>(_bit);
+
+    // Round towards negative infinity so that the bit is never negative
+    auto bytes = n / 8;
+    auto bit = n % 8;
+
+    if (bit < 0) {
+      bit += 8;
+      bytes--;
+    }
+
+    _byte += bytes;
+    _bit = static_cast<unsigned>(bit);
+
+    return *this;
+  }
+
+  /// Move the iterator back by `n` bits
+  constexpr basic_bit_iterator& operator-=(difference_type n) noexcept {
+    return *this += -n;
+  }
+
+  /// Returns an iterator that is advanced by `n` bits
+  friend constexpr basic_bit_iterator operator+(basic_bit_iterator it,
+                                                difference_type n) noexcept {
+    return it += n;
+  }
+
+  /// Returns an iterator that is advanced by `n` bits
+  friend constexpr basic_bit_iterator operator+(
+      difference_type n, basic_bit_iterator it) noexcept {
+    return it += n;
+  }
+
+  /// Returns an iterator that is moved back by `n` bits
+  friend constexpr basic_bit_iterator operator-(basic_bit_iterator it,
+                                                difference_type n) noexcept {
+    return it -= n;
+  }
+
+  /// Returns the number of bits between two iterators
+  friend constexpr difference_type operator-(
+      const basic_bit_iterator& lhs, const basic_bit_iterator& rhs) noexcept {
+    return (lhs._byte - rhs._byte) * 8 +
+           (static_cast<difference_type>(lhs._bit) -
+            static_cast<difference_type>(rhs._bit));
+  }
+
+  /// Equality operator
+  friend constexpr bool operator==(const basic_bit_iterator& lhs,
+                                   const basic_bit_iterator& rhs) noexcept {
+    return lhs._byte == rhs._byte && lhs._bit == rhs._bit;
+  }
+
+  /// Inequality operator
+  friend constexpr bool operator!=(const basic_bit_iterator& lhs,
+                                   const basic_bit_iterator& rhs) noexcept {
+    return !(lhs == rhs);
+  }
+
+  /// Less than operator
+  friend constexpr bool operator<(const basic_bit_iterator& lhs,
+                                  const basic_bit_iterator& rhs) noexcept {
+    return lhs._byte < rhs._byte ||
+           (lhs._byte == rhs._byte && lhs._bit < rhs._bit);
+  }
+
+  /// Greater than operator
+  friend constexpr bool operator>(const basic_bit_iterator& lhs,
+                                  const basic_bit_iterator& rhs) noexcept {
+    return rhs < lhs;
+  }
+
+  /// Less than or equal operator
+  friend constexpr bool operator<=(const basic_bit_iterator& lhs,
+                                   const basic_bit_iterator& rhs) noexcept {
+    return !(rhs < lhs);
+  }
+
+  /// Greater than or equal operator
+  friend constexpr bool operator>=(const basic_bit_iterator& lhs,
+                                   const basic_bit_iterator& rhs) noexcept {
+    return !(lhs < rhs);
+  }
+
+ private:
+  byte_pointer _byte{};  ///< The byte that holds the current bit
+  unsigned _bit{};       ///< The position of the current bit in its byte
+};
+
+/// An iterator over mutable bits
+using bit_iterator = basic_bit_iterator<false>;
+
+/// An iterator over const bits
+using const_bit_iterator = basic_bit_iterator<true>;
+
+/// A non-owning range of the bits of a yat::bitmap, a yat::bitmap_view or any
+/// other buffer that uses the yat::bitmap layout, where bit `i` is bit `i % 8`
+/// of byte `i / 8`.  This is like std::span for bits.
+///
+/// The iterators can be used with any algorithm, but the overloads of copy,
+/// fill, find, count, equal and mismatch in this header work on whole 64-bit
+/// words at a time, the way libc++ optimizes std::vector<bool>.  They are
+/// found by argument dependent lookup, so unqualified calls in generic code
+/// use them.  Only the bytes that hold the bits of a span are ever read or
+/// written.  The viewed bits must outlive the span.
+template <bool Const>
+class basic_bit_span
+    : public yat::ranges::view_interface<basic_bit_span<Const>> {
+  using byte_pointer = std::conditional_t<Const, const std::byte*, std::byte*>;
+
+ public:
+  using iterator = basic_bit_iterator<Const>;
+  using value_type = bool;
+  using reference = typename iterator::reference;
+  using difference_type = typename iterator::difference_type;
+  using size_type = uint64_t;
+
+  /// Create an empty span
+  constexpr basic_bit_span() noexcept {};  // clang 5 had a bug when using
+                                           // "= default" here
+
+  /// Create a span of the first `num_bits` bits of a buffer
+  constexpr basic_bit_span(byte_pointer data, uint64_t num_bits) noexcept
+      : _first{data, 0}, _size{num_bits} {}
+
+  /// Create a span of the bits of a bitmap
+  template <typename Allocator, size_t Alignment, bool C = Const,
+            std::enable_if_t<!C, int> = 0>
+  basic_bit_span(basic_bitmap<Allocator, Alignment>& bm) noexcept
+      : basic_bit_span{reinterpret_cast<std::byte*>(bm._storage.data()),
+                       bm.count()} {}
+
+  /// Create a span of the bits of a const bitmap
+  template <typename Allocator, size_t Alignment, bool C = Const,
+            std::enable_if_t<C, int> = 0>
+  basic_bit_span(const basic_bitmap<Allocator, Alignment>& bm) noexcept
+      : basic_bit_span{bitmap_view{bm}} {}
+
+  /// Create a span of the bits of a view
+  template <bool C = Const, std::enable_if_t<C, int> = 0>
+  basic_bit_span(const bitmap_view& view) noexcept
+      : basic_bit_span{reinterpret_cast<const std::byte*>(view.words().data()),
+                       view.count()} {}
+
+  /// Convert a span of mutable bits into a span of const bits
+  template <bool C = Const, std::enable_if_t<C, int> = 0>
+  constexpr basic_bit_span(const basic_bit_span<false>& span) noexcept
+      : _first{span.begin()}, _size{span.size()} {}
+
+  /// Returns an iterator to the first bit
+  [[nodiscard]] constexpr iterator begin() const noexcept { return _first; }
+
+  /// Returns an iterator past the last bit
+  [[nodiscard]] constexpr iterator end() const noexcept {
+    return _first + static_cast<difference_type>(_size);
+  }
+
+  /// Returns the number of bits in the span
+  [[nodiscard]] constexpr uint64_t size() const noexcept { return _size; }
+
+  /// Returns true if the span has no bits
+  [[nodiscard]] constexpr bool empty() const noexcept { return _size == 0; }
+
+  /// Access a given bit.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  constexpr reference operator[](uint64_t n) const noexcept {
+    return _first[static_cast<difference_type>(n)];
+  }
+
+  /// Returns a span of the `count` bits starting at `first`.  No bounds
+  /// checking is performed and accessing an invalid index is undefined
+  /// behavior.
+  [[nodiscard]] constexpr basic_bit_span subspan(
+      uint64_t first, uint64_t count) const noexcept {
+    basic_bit_span span{};
+    span._first = _first + static_cast<difference_type>(first);
+    span._size = count;
+    return span;
+  }
+
+ private:
+  iterator _first{};  ///< The first bit
+  uint64_t _size{};   ///< The number of bits
+};
+
+/// A span of mutable bits
+using bit_span = basic_bit_span<false>;
+
+/// A span of const bits
+using const_bit_span = basic_bit_span<true>;
+
+/// Copies the bits of [first, last) to the bits starting at `out` and returns
+/// the end of the copied bits.  The bits are copied a word at a time.  `out`
+/// must not be in [first, last).
+template <bool Const>
+bit_iterator copy(basic_bit_iterator<Const> first,
+                  basic_bit_iterator<Const> last, bit_iterator out) noexcept {
+  constexpr uint64_t word_bits = std::numeric_limits<uint64_t>::digits;
+
+  const auto result = out + (last - first);
+  auto n = static_cast<uint64_t>(last - first);
+  auto src = first.data();
+  uint64_t sb = first.offset();
+  auto dst = out.data();
+
+  // Copy up to the next destination byte so that whole words can be stored
+  if (const uint64_t db = out.offset(); db != 0 && n != 0) {
+    const auto k = std::min<uint64_t>(n, 8 - db);
+    detail::store_bits(dst++, db, detail::load_bits(src, sb, k), k);
+    detail::advance_bits(src, sb, k);
+    n -= k;
+  }
+
+  for (; n >= word_bits; n -= word_bits) {
+    detail::store_bits(dst, 0, detail::load_bits(src, sb, word_bits),
+                       word_bits);
+    src += sizeof(uint64_t);
+    dst += sizeof(uint64_t);
+  }
+
+  if (n != 0) {
+    detail::store_bits(dst, 0, detail::load_bits(src, sb, n), n);
+  }
+
+  return result;
+}
+
+/// Sets (or clears) every bit in [first, last).  The whole bytes in between
+/// are filled with memset.
+inline void fill(bit_iterator first, bit_iterator last, bool value) noexcept {
+  const uint64_t pattern = value ? std::numeric_limits<uint64_t>::max() : 0;
+
+  auto n = static_cast<uint64_t>(last - first);
+  auto p = first.data();
+
+  // Fill up to the next byte
+  if (const uint64_t b = first.offset(); b != 0 && n != 0) {
+    const auto k = std::min<uint64_t>(n, 8 - b);
+    detail::store_bits(p++, b, pattern, k);
+    n -= k;
+  }
+
+  std::memset(p, value ? 0xFF : 0, static_cast<size_t>(n / 8));
+  p += n / 8;
+
+  if (n % 8 != 0) {
+    detail::store_bits(p, 0, pattern, n % 8);
+  }
+}
+
+/// Returns an iterator to the first bit in [first, last) that is equal to
+/// `value`, or `last` if there are none.  The bits are searched a word at a
+/// time.
+template <bool Const>
+[[nodiscard]] basic_bit_iterator<Const> find(basic_bit_iterator<Const> first,
+                                             basic_bit_iterator<Const> last,
+                                             bool value) noexcept {
+  constexpr uint64_t word_bits = std::numeric_limits<uint64_t>::digits;
+
+  const auto n = static_cast<uint64_t>(last - first);
+  auto p = first.data();
+
+  for (uint64_t done = 0; done < n; done += word_bits) {
+    const auto k = std::min(n - done, word_bits);
+    auto bits = detail::load_bits(p, first.offset(), k);
+
+    if (!value) {
+      bits = ~bits & detail::word_mask(0, k);
+    }
+
+    if (bits != 0) {
+      return first + static_cast<std::ptrdiff_t>(
+                         done + static_cast<uint64_t>(countr_zero(bits)));
+    }
+
+    p += sizeof(uint64_t);
+  }
+
+  return last;
+}
+
+/// Returns the number of bits in [first, last) that are equal to `value`.  The
+/// bits are counted a word at a time.
+template <bool Const>
+[[nodiscard]] std::ptrdiff_t count(basic_bit_iterator<Const> first,
+                                   basic_bit_iterator<Const> last,
+                                   bool value) noexcept {
+  constexpr uint64_t word_bits = std::numeric_limits<uint64_t>::digits;
+
+  const auto n = static_cast<uint64_t>(last - first);
+  auto p = first.data();
+  uint64_t set = 0;
+
+  for (uint64_t done = 0; done < n; done += word_bits) {
+    const auto k = std::min(n - done, word_bits);
+    set += static_cast<uint64_t>(
+        popcount(detail::load_bits(p, first.offset(), k)));
+    p += sizeof(uint64_t);
+  }
+
+  return static_cast<std::ptrdiff_t>(value ? set : n - set);
+}
+
+/// Returns iterators to the first bits of [first1, last1) and the bits
+/// starting at `first2` that are not equal, or to the end of the first range
+/// and the matching bit of the second if they are all equal.  The bits are
+/// compared a word at a time.
+template <bool Const1, bool Const2>
+[[nodiscard]] std::pair<basic_bit_iterator<Const1>, basic_bit_iterator<Const2>>
+mismatch(basic_bit_iterator<Const1> first1, basic_bit_iterator<Const1> last1,
+         basic_bit_iterator<Const2> first2) noexcept {
+  constexpr uint64_t word_bits = std::numeric_limits<uint64_t>::digits;
+
+  const auto n = static_cast<uint64_t>(last1 - first1);
+  auto p1 = first1.data();
+  auto p2 = first2.data();
+  uint64_t done = 0;
+
+  for (; done < n; done += word_bits) {
+    const auto k = std::min(n - done, word_bits);
+    const auto diff = detail::load_bits(p1, first1.offset(), k) ^
+                      detail::load_bits(p2, first2.offset(), k);
+
+    if (diff != 0) {
+      done += static_cast<uint64_t>(countr_zero(diff));
+      break;
+    }
+
+    p1 += sizeof(uint64_t);
+    p2 += sizeof(uint64_t);
+  }
+
+  done = std::min(done, n);
+
+  return {first1 + static_cast<std::ptrdiff_t>(done),
+          first2 + static_cast<std::ptrdiff_t>(done)};
+}
+
+/// Returns iterators to the first bits of [first1, last1) and [first2, last2)
+/// that are not equal, stopping at the end of the shorter range (see
+/// mismatch)
+template <bool Const1, bool Const2>
+[[nodiscard]] std::pair<basic_bit_iterator<Const1>, basic_bit_iterator<Const2>>
+mismatch(basic_bit_iterator<Const1> first1, basic_bit_iterator<Const1> last1,
+         basic_bit_iterator<Const2> first2,
+         basic_bit_iterator<Const2> last2) noexcept {
+  const auto n = std::min(last1 - first1, last2 - first2);
+  return mismatch(first1, first1 + n, first2);
+}
+
+/// Returns true if the bits of [first1, last1) are equal to the bits starting
+/// at `first2`.  The bits are compared a word at a time.
+template <bool Const1, bool Const2>
+[[nodiscard]] bool equal(basic_bit_iterator<Const1> first1,
+                         basic_bit_iterator<Const1> last1,
+                         basic_bit_iterator<Const2> first2) noexcept {
+  return mismatch(first1, last1, first2).first == last1;
+}
+
+/// Returns true if [first1, last1) and [first2, last2) have the same number
+/// of bits and they are all equal
+template <bool Const1, bool Const2>
+[[nodiscard]] bool equal(basic_bit_iterator<Const1> first1,
+                         basic_bit_iterator<Const1> last1,
+                         basic_bit_iterator<Const2> first2,
+                         basic_bit_iterator<Const2> last2) noexcept {
+  return (last1 - first1) == (last2 - first2) && equal(first1, last1, first2);
+}
+
+}  // namespace yat
@@ -15,30 +15,507 @@
  */
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
 #include <limits>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define YAT_INTERNAL_HAS_MEMORY_RESOURCE
+#endif
+
 #include "bit.hpp"
+#include "bitmap_simd.hpp"
 #include "endian.hpp"
+#include "memory.hpp"
 #include "ranges.hpp"
 #include "span.hpp"
+#include "type_traits.hpp"
+
+namespace yat {
+
+/// The order in which the bits of a bitmap are numbered within its words
+enum class bit_order {
+  lsb_first,  ///< Bit 0 is the least significant bit of the first word
+  msb_first,  ///< Bit 0 is the most significant bit of the first word
+};
+
+}  // namespace yat
+
+namespace yat::detail {
+
+/// Returns a storage word mask with `count` bits set starting at bit `first`.
+/// `first + count` must not be larger than the number of bits in a word.
+[[nodiscard]] constexpr uint64_t word_mask(uint64_t first,
+                                           uint64_t count) noexcept {
+  constexpr auto word_bits = std::numeric_limits<uint64_t>::digits;
+
+  if (count >= word_bits) {
+    return std::numeric_limits<uint64_t>::max();
+  }
+
+  return ((uint64_t{1} << count) - 1) << first;
+}
+
+/// Splits the range of bits [start, start + count) into the storage words that
+/// it touches.  `partial(word, mask)` is called for the (at most two) words at
+/// the edges of the range that are only partially covered, and `full(first,
+/// last)` is called once with the span of words [first, last) that are
+/// completely covered.  Visiting stops early if either callback returns false.
+///
+/// Returns false if visiting was stopped early.
+template <typename PartialFn, typename FullFn>
+constexpr bool visit_word_range(uint64_t start, uint64_t count,
+                                PartialFn&& partial, FullFn&& full) {
+  constexpr auto word_bits = std::numeric_limits<uint64_t>::digits;
+
+  if (count == 0) {
+    return true;
+  }
+
+  auto w = start / word_bits;
+
+  // Handle a head word that is not completely covered
+  if (const auto b = start % word_bits; b != 0 || count < word_bits) {
+    const auto n = std::min<uint64_t>(count, word_bits - b);
+
+    if (!partial(w, word_mask(b, n))) {
+      return false;
+    }
+
+    w++;
+    count -= n;
+  }
+
+  // Handle the words that are completely covered
+  if (const auto n = count / word_bits; n != 0) {
+    if (!full(w, w + n)) {
+      return false;
+    }
+
+    w += n;
+  }
+
+  // Handle a tail word that is not completely covered
+  if (const auto n = count % word_bits; n != 0) {
+    return partial(w, word_mask(0, n));
+  }
+
+  return true;
+}
+
+/// Sets the bits [start, start + count) of an array of storage words
+inline void set_bits(little_uint64_t* words, uint64_t start,
+                     uint64_t count) noexcept {
+  visit_word_range(
+      start, count,
+      [words](uint64_t w, uint64_t mask) {
+        words[w] = words[w] | mask;
+        return true;
+      },
+      [words](uint64_t first, uint64_t last) {
+        std::memset(static_cast<void*>(&words[first]), 0xFF,
+                    (last - first) * sizeof(little_uint64_t));
+        return true;
+      });
+}
+
+/// Clears the bits [start, start + count) of an array of storage words
+inline void clear_bits(little_uint64_t* words, uint64_t start,
+                       uint64_t count) noexcept {
+  visit_word_range(
+      start, count,
+      [words](uint64_t w, uint64_t mask) {
+        words[w] = words[w] & ~mask;
+        return true;
+      },
+      [words](uint64_t first, uint64_t last) {
+        std::memset(static_cast<void*>(&words[first]), 0,
+                    (last - first) * sizeof(little_uint64_t));
+        return true;
+      });
+}
+
+/// Flips the bits [start, start + count) of an array of storage words
+inline void flip_bits(little_uint64_t* words, uint64_t start,
+                      uint64_t count) noexcept {
+  visit_word_range(
+      start, count,
+      [words](uint64_t w, uint64_t mask) {
+        words[w] = words[w] ^ mask;
+        return true;
+      },
+      [words](uint64_t first, uint64_t last) {
+        for (auto w = first; w < last; w++) {
+          words[w] = ~words[w];
+        }
+        return true;
+      });
+}
+
+/// Copies the `count` bits starting at bit `src_first` of a source to the
+/// bits starting at bit `dst_first` of an array of storage words.  `src(w)`
+/// returns source word `w` and is only called for words that hold bits of
+/// the source range.  Source bits that aren't aligned with the destination
+/// words are joined from two neighboring words with a funnel shift.
+///
+/// If the source is the destination array and the ranges overlap, `backward`
+/// must be true when the destination starts after the source, like memmove.
+template <typename SrcFn>
+inline void copy_bits(little_uint64_t* dst, uint64_t dst_first, SrcFn&& src,
+                      uint64_t src_first, uint64_t count,
+                      bool backward) noexcept {
+  constexpr auto word_bits = std::numeric_limits<uint64_t>::digits;
+
+  if (count == 0) {
+    return;
+  }
+
+  // Returns `n` source bits starting at bit `pos`
+  const auto extract = [&src](uint64_t pos, uint64_t n) {
+    const auto w = pos / word_bits;
+    const auto b = pos % word_bits;
+    auto bits = src(w) >> b;
+
+    if (b + n > word_bits) {
+      bits |= src(w + 1) << (word_bits - b);
+    }
+
+    return bits;
+  };
+
+  // Stores `n` bits into a destination word starting at bit `pos`
+  const auto store = [dst](uint64_t pos, uint64_t bits, uint64_t n) {
+    const auto b = pos % word_bits;
+    const auto mask = word_mask(b, n);
+    auto& val = dst[pos / word_bits];
+    val = (val & ~mask) | ((bits << b) & mask);
+  };
+
+  if (!backward) {
+    uint64_t done = 0;
+
+    // Handle a destination head word that is not completely covered
+    if (const auto b = dst_first % word_bits; b != 0) {
+      done = std::min<uint64_t>(count, word_bits - b);
+      store(dst_first, extract(src_first, done), done);
+    }
+
+    // Handle the destination words that are completely covered, carrying
+    // the upper source word of each funnel shift over to the next one
+    if (count - done >= word_bits) {
+      auto d = (dst_first + done) / word_bits;
+      auto w = (src_first + done) / word_bits;
+
+      if (const auto b = (src_first + done) % word_bits; b == 0) {
+        for (; count - done >= word_bits; done += word_bits) {
+          dst[d++] = src(w++);
+        }
+      } else {
+        auto lo = src(w);
+
+        for (; count - done >= word_bits; done += word_bits) {
+          const auto hi = src(++w);
+          dst[d++] = (lo >> b) | (hi << (word_bits - b));
+          lo = hi;
+        }
+      }
+    }
+
+    // Handle a destination tail word that is not completely covered
+    if (done < count) {
+      store(dst_first + done, extract(src_first + done, count - done),
+            count - done);
+    }
+
+    return;
+  }
+
+  auto left = count;
+
+  // Handle a destination tail word that is not completely covered
+  if (const auto e = (dst_first + count) % word_bits; e != 0) {
+    const auto n = std::min<uint64_t>(count, e);
+    left -= n;
+    store(dst_first + left, extract(src_first + left, n), n);
+  }
+
+  // Handle the destination words that are completely covered from the end,
+  // carrying the lower source word of each funnel shift over to the next one
+  if (left >= word_bits) {
+    auto d = (dst_first + left) / word_bits;
+    auto w = (src_first + left) / word_bits;
+
+    if (const auto b = (src_first + left) % word_bits; b == 0) {
+      for (; left >= word_bits; left -= word_bits) {
+        dst[--d] = src(--w);
+      }
+    } else {
+      auto hi = src(w);
+
+      for (; left >= word_bits; left -= word_bits) {
+        const auto lo = src(--w);
+        dst[--d] = (lo >> b) | (hi << (word_bits - b));
+        hi = lo;
+      }
+    }
+  }
+
+  // Handle a destination head word that is not completely covered
+  if (left != 0) {
+    store(dst_first, extract(src_first, left), left);
+  }
+}
+
+/// Tells whether the bytes of a bitmap storage word are stored big endian
+template <typename Word>
+inline constexpr bool is_big_endian_word_v = is_big_endian_system;
+
+template <typename T, typename ByteSwapper>
+inline constexpr bool
+    is_big_endian_word_v<basic_endian_scalar<T, endian::big, ByteSwapper>> =
+        true;
+
+template <typename T, typename ByteSwapper>
+inline constexpr bool
+    is_big_endian_word_v<basic_endian_scalar<T, endian::little, ByteSwapper>> =
+        false;
+
+/// Reverses the order of the bytes within each `LaneBytes` wide lane of `v`
+template <size_t LaneBytes>
+[[nodiscard]] constexpr uint64_t swap_lane_bytes(uint64_t v) noexcept {
+  if constexpr (LaneBytes >= 2) {
+    v = ((v >> 8) & 0x00FF00FF00FF00FFULL) | ((v & 0x00FF00FF00FF00FFULL) << 8);
+  }
+
+  if constexpr (LaneBytes >= 4) {
+    v = ((v >> 16) & 0x0000FFFF0000FFFFULL) |
+        ((v & 0x0000FFFF0000FFFFULL) << 16);
+  }
+
+  if constexpr (LaneBytes >= 8) {
+    v = (v >> 32) | (v << 32);
+  }
+
+  return v;
+}
+
+/// Reverses the order of the bits within each byte of `v`
+[[nodiscard]] constexpr uint64_t reverse_byte_bits(uint64_t v) noexcept {
+  v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+  v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+  return ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) |
+         ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+}
+
+/// Tells whether 64 bits of a bitmap that is stored as `Word`s with bits
+/// numbered in `Order` need to be rearranged to match the yat::bitmap layout
+template <typename Word, bit_order Order>
+inline constexpr bool is_foreign_bitmap_layout_v =
+    Order == bit_order::msb_first ||
+    (sizeof(Word) > 1 && is_big_endian_word_v<Word>);
+
+/// 64 bits of a bitmap that is stored as `Word`s with bits numbered in `Order`.
+/// It converts to a word with the same bits in the yat::bitmap layout (LSB
+/// first in a little endian word).
+///
+/// Bits that are at the same position in both layouts are a permutation of
+/// each other, so words that are all zeros or all ones, population counts and
+/// bitwise operations between words of the same layout are unaffected by the
+/// conversion and can be done on the raw words.
+template <typename Word, bit_order Order>
+class bitmap_word {
+  static_assert(sizeof(uint64_t) % sizeof(Word) == 0,
+                "Word must be 8, 16, 32 or 64 bits wide");
+
+ public:
+  /// Returns the bits in the yat::bitmap layout
+  constexpr operator uint64_t() const noexcept {
+    uint64_t v = _raw;
+
+    // Once the words are in little endian order the bits are numbered LSB
+    // first.  MSB first words in big endian order only need their bits
+    // reversed within each byte.
+    if constexpr (is_big_endian_word_v<Word> !=
+                  (Order == bit_order::msb_first)) {
+      v = swap_lane_bytes<sizeof(Word)>(v);
+    }
+
+    if constexpr (Order == bit_order::msb_first) {
+      v = reverse_byte_bits(v);
+    }
+
+    return v;
+  }
+
+ private:
+  little_uint64_t _raw{};  ///< The stored bits
+};
+
+/// The type that is used to read 64 bits of a bitmap that is stored as `Word`s
+/// with bits numbered in `Order`
+template <typename Word, bit_order Order>
+using bitmap_storage_t =
+    std::conditional_t<is_foreign_bitmap_layout_v<Word, Order>,
+                       bitmap_word<Word, Order>, little_uint64_t>;
+
+/// An allocator adaptor that allocates `T`s from blocks of `Alignment` bytes
+/// that are aligned to `Alignment`, using an allocator of `T`s that is rebound
+/// to the blocks.  The adapted allocator must use raw pointers and honor the
+/// alignment of the type it allocates, which `std::allocator` and
+/// `std::pmr::polymorphic_allocator` both do.
+template <typename T, typename Allocator, size_t Alignment>
+class aligned_allocator {
+  static_assert(Alignment >= alignof(T) && (Alignment & (Alignment - 1)) == 0,
+                "Alignment must be a power of two at least as large as T's");
+
+  /// A block of aligned storage
+  struct alignas(Alignment) block {
+    unsigned char bytes[Alignment];
+  };
+
+  using traits = std::allocator_traits<Allocator>;
+  using block_allocator = typename traits::template rebind_alloc<block>;
+  using block_traits = std::allocator_traits<block_allocator>;
+
+  /// Calculates the number of blocks that are needed to hold n `T`s
+  static constexpr size_t blocks(size_t n) noexcept {
+    return (n * sizeof(T) + Alignment - 1) / Alignment;
+  }
+
+ public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment =
+      typename traits::propagate_on_container_copy_assignment;
+  using propagate_on_container_move_assignment =
+      typename traits::propagate_on_container_move_assignment;
+  using propagate_on_container_swap =
+      typename traits::propagate_on_container_swap;
+  using is_always_equal = typename traits::is_always_equal;
+
+  template <typename U>
+  struct rebind {
+    using other = aligned_allocator<U, Allocator, Alignment>;
+  };
+
+  /// Create an adaptor for a default constructed allocator
+  aligned_allocator() {};  // clang 5 had a bug when using "= default" here
+
+  /// Create an adaptor for an allocator
+  explicit aligned_allocator(const Allocator& alloc) noexcept
+      : _alloc{alloc} {}
+
+  // cppcheck-suppress noExplicitConstructor
+  /// Create an adaptor from an adaptor of another type
+  template <typename U>
+  aligned_allocator(
+      const aligned_allocator<U, Allocator, Alignment>& other) noexcept
+      : _alloc{other.inner()} {}
+
+  /// Allocates aligned storage for n `T`s
+  [[nodiscard]] T* allocate(size_t n) {
+    block_allocator alloc{_alloc};
+    return reinterpret_cast<T*>(
+        yat::to_address(block_traits::allocate(alloc, blocks(n))));
+  }
+
+  /// Deallocates storage that was returned by allocate(n)
+  void deallocate(T* p, size_t n) noexcept {
+    block_allocator alloc{_alloc};
+    block_traits::deallocate(alloc, reinterpret_cast<block*>(p), blocks(n));
+  }
+
+  /// Returns the adaptor to use for a copy of a container
+  [[nodiscard]] aligned_allocator select_on_container_copy_construction()
+      const {
+    return aligned_allocator{
+        traits::select_on_container_copy_construction(_alloc)};
+  }
+
+  /// Returns the adapted allocator
+  [[nodiscard]] const Allocator& inner() const noexcept { return _alloc; }
+
+  /// Equality operator
+  friend bool operator==(const aligned_allocator& lhs,
+                         const aligned_allocator& rhs) noexcept {
+    return lhs._alloc == rhs._alloc;
+  }
+
+  /// Inequality operator
+  friend bool operator!=(const aligned_allocator& lhs,
+                         const aligned_allocator& rhs) noexcept {
+    return !(lhs == rhs);
+  }
+
+ private:
+  Allocator _alloc{};  ///< The adapted allocator
+};
+
+}  // namespace yat::detail
 
 namespace yat {
 
-/// `bitmap` represents a sequence of bits that can be manipulated efficiently.
+class atomic_bitmap;
+
+template <bool Const>
+class basic_bit_span;
+
+template <typename Word = little_uint64_t,
+          bit_order Order = bit_order::lsb_first>
+class basic_bitmap_view;
+
+/// A view into a bitmap that uses the yat::bitmap layout
+using bitmap_view = basic_bitmap_view<>;
+
+/// The result of a batched scan (see bitmap_scanner::scan_batch and
+/// bitmap_view::flatten)
+struct bitmap_scan_batch {
+  size_t count;     ///< The number of ranges or indices that were written
+  uint64_t cursor;  ///< The bit to resume scanning from
+};
+
+/// `basic_bitmap` represents a sequence of bits that can be manipulated
+/// efficiently.
 ///
 /// This is similar to std::vector<bool>, but the layout of the bits in memory
-/// is well defined.
-class bitmap {
+/// is well defined.  The storage words are allocated with `Allocator` and are
+/// aligned to `Alignment` bytes.  The storage is padded with unset bits to a
+/// multiple of `Alignment` bytes, so whole aligned vectors can be read up to
+/// the end of the bitmap.
+template <typename Allocator = std::allocator<little_uint64_t>,
+          size_t Alignment = 64>
+class basic_bitmap {
   using storage_type = yat::little_uint64_t;
+  using storage_allocator =
+      detail::aligned_allocator<storage_type, Allocator, Alignment>;
   static constexpr uint64_t storage_bits =
       std::numeric_limits<storage_type::value_type>::digits;
+  static constexpr uint64_t block_words = Alignment / sizeof(storage_type);
+
+  static_assert(std::is_same_v<typename Allocator::value_type, storage_type>,
+                "Allocator must allocate little_uint64_t");
+  static_assert(Alignment % sizeof(storage_type) == 0,
+                "Alignment must be a multiple of the storage word size");
 
   /// Calculate the number of storage ints we need to store n bits
   static constexpr uint64_t cas(uint64_t n) noexcept {
     return (n + storage_bits - 1) / storage_bits;
   }
 
+  /// Calculate the number of storage ints we allocate to store n bits
+  static constexpr size_t padded(uint64_t n) noexcept {
+    return static_cast<size_t>((cas(n) + block_words - 1) / block_words *
+                               block_words);
+  }
+
   /// Calculate the storage index
   static constexpr uint64_t si(uint64_t n) noexcept { return n / storage_bits; }
 
@@ -51,11 +528,52 @@ class bitmap {
   }
 
  public:
+  using allocator_type = Allocator;
+
+  /// Special marker that is returned when there are no bits left to scan
+  static constexpr uint64_t no_bits_left = std::numeric_limits<uint64_t>::max();
+
+  /// The alignment of the storage words in bytes
+  static constexpr size_t alignment = Alignment;
+
   /// Create an empty bitmap
-  bitmap() noexcept {};  // clang 5 had a bug when using "= default" here
+  basic_bitmap() noexcept {};  // clang 5 had a bug when using "= default" here
+
+  /// Create an empty bitmap that uses an allocator
+  explicit basic_bitmap(const Allocator& alloc) noexcept
+      : _storage(storage_allocator{alloc}) {}
 
   /// Create a bitmap with `n` unset bits
-  explicit bitmap(uint64_t n) : _storage(cas(n)), _count{n} {}
+  explicit basic_bitmap(uint64_t n, const Allocator& alloc = Allocator{})
+      : _storage(padded(n), storage_allocator{alloc}), _count{n} {}
+
+  /// Create a bitmap that holds a copy of the bits in a view
+  explicit basic_bitmap(const bitmap_view& view,
+                        const Allocator& alloc = Allocator{});
+
+  /// Create a bitmap with a bit for each value that is set if `pred(value)`
+  /// is true.  The results are packed into whole words before they are
+  /// stored.
+  template <typename T, typename Pred>
+  [[nodiscard]] static basic_bitmap from_predicate(
+      yat::span<T> values, Pred&& pred, const Allocator& alloc = Allocator{}) {
+    basic_bitmap bm{values.size(), alloc};
+    bm.assign_predicate(0, values, std::forward<Pred>(pred));
+    return bm;
+  }
+
+  /// Create a bitmap with a bit for each value that is set if `value op rhs`
+  /// is true.  Integer and floating point values are compared with vectorized
+  /// kernels.
+  template <typename T>
+  [[nodiscard]] static basic_bitmap from_compare(
+      yat::span<T> values, compare_op op,
+      const yat::type_identity_t<std::remove_const_t<T>>& rhs,
+      const Allocator& alloc = Allocator{}) {
+    basic_bitmap bm{values.size(), alloc};
+    bm.assign_compare(0, values, op, rhs);
+    return bm;
+  }
 
   /// Access a given bit.  No bounds checking is performed and accessing an
   /// invalid index is undefined behavior.
@@ -72,22 +590,8 @@ class bitmap {
 
   /// Set a range of bits.  No bounds checking is performed and accessing an
   /// invalid index is undefined behavior.
-  void set(uint64_t start, uint64_t count) {
-    while (count > 0) {
-      if (bi(start) == 0 && count >= storage_bits) {
-        // We're dealing the the entire element, so set all the bits
-        _storage[si(start)] =
-            std::numeric_limits<storage_type::value_type>::max();
-
-        start += storage_bits;
-        count -= storage_bits;
-        continue;
-      }
-
-      set(start);
-      start++;
-      count--;
-    }
+  void set(uint64_t start, uint64_t count) noexcept {
+    detail::set_bits(_storage.data(), start, count);
   }
 
   /// Clear a given bit.  No bounds checking is performed and accessing an
@@ -99,49 +603,311 @@ class bitmap {
 
   /// Clear a range of bits.  No bounds checking is performed and accessing an
   /// invalid index is undefined behavior.
-  void clear(uint64_t start, uint64_t count) {
-    while (count > 0) {
-      if (bi(start) == 0 && count >= storage_bits) {
-        // We're dealing the the entire element, so clear all the bits
-        _storage[si(start)] = 0;
+  void clear(uint64_t start, uint64_t count) noexcept {
+    detail::clear_bits(_storage.data(), start, count);
+  }
 
-        start += storage_bits;
-        count -= storage_bits;
-        continue;
-      }
+  /// Flip a given bit.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  void flip(uint64_t n) noexcept {
+    auto& val = _storage[si(n)];
+    val = val ^ bm(n);
+  }
 
-      clear(start);
-      start++;
-      count--;
-    }
+  /// Flip a range of bits.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  void flip(uint64_t start, uint64_t count) noexcept {
+    detail::flip_bits(_storage.data(), start, count);
+  }
+
+  /// Set each bit in [first, first + values.size()) if `pred` is true for the
+  /// corresponding value and clear it otherwise.  The words that are covered
+  /// entirely are written without being read, so calls that cover different
+  /// words can be made concurrently.  No bounds checking is performed and
+  /// accessing an invalid index is undefined behavior.
+  template <typename T, typename Pred>
+  basic_bitmap& assign_predicate(uint64_t first, yat::span<T> values,
+                                 Pred&& pred) {
+    assign_packed(
+        first, values.size(),
+        [&](size_t i, size_t num_words, storage_type* out) {
+          detail::pack_words(values.data() + i, num_words, pred, out);
+        },
+        [&](size_t i, size_t n) {
+          return detail::pack_word(values.data() + i, n, pred);
+        });
+
+    return *this;
+  }
+
+  /// Set each bit in [first, first + values.size()) if `value op rhs` is true
+  /// for the corresponding value and clear it otherwise (see
+  /// assign_predicate).  Integer and floating point values are compared with
+  /// vectorized kernels.
+  template <typename T>
+  basic_bitmap& assign_compare(
+      uint64_t first, yat::span<T> values, compare_op op,
+      const yat::type_identity_t<std::remove_const_t<T>>& rhs) {
+    using value_type = std::remove_const_t<T>;
+
+    assign_packed(
+        first, values.size(),
+        [&](size_t i, size_t num_words, storage_type* out) {
+          detail::compare_words<value_type>(values.data() + i, num_words, op,
+                                            rhs, out);
+        },
+        [&](size_t i, size_t n) {
+          return detail::pack_word(
+              values.data() + i, n, [&](const value_type& v) {
+                return detail::compare_values(op, v, rhs);
+              });
+        });
+
+    return *this;
+  }
+
+  /// Returns true if every bit in the bitmap is set
+  [[nodiscard]] bool all_set() const noexcept;
+
+  /// Returns true if every bit in a range is set.  No bounds checking is
+  /// performed and accessing an invalid index is undefined behavior.
+  [[nodiscard]] bool all_set(uint64_t start, uint64_t count) const noexcept;
+
+  /// Returns true if any bit in the bitmap is set
+  [[nodiscard]] bool any_set() const noexcept;
+
+  /// Returns true if any bit in a range is set.  No bounds checking is
+  /// performed and accessing an invalid index is undefined behavior.
+  [[nodiscard]] bool any_set(uint64_t start, uint64_t count) const noexcept;
+
+  /// Returns true if no bit in the bitmap is set
+  [[nodiscard]] bool none_set() const noexcept;
+
+  /// Returns true if no bit in a range is set.  No bounds checking is
+  /// performed and accessing an invalid index is undefined behavior.
+  [[nodiscard]] bool none_set(uint64_t start, uint64_t count) const noexcept;
+
+  /// Returns the number of set bits in the bitmap
+  [[nodiscard]] uint64_t count_set() const noexcept;
+
+  /// Returns the number of set bits in a range.  No bounds checking is
+  /// performed and accessing an invalid index is undefined behavior.
+  [[nodiscard]] uint64_t count_set(uint64_t start,
+                                   uint64_t count) const noexcept;
+
+  /// Returns the index of the first set bit at or after `first`, or
+  /// `no_bits_left` if there are none
+  [[nodiscard]] uint64_t find_next_set(uint64_t first) const noexcept;
+
+  /// Returns the index of the first set bit in [first, last), or
+  /// `no_bits_left` if there are none
+  [[nodiscard]] uint64_t find_next_set(uint64_t first,
+                                       uint64_t last) const noexcept;
+
+  /// Returns the index of the first unset bit at or after `first`, or
+  /// `no_bits_left` if there are none
+  [[nodiscard]] uint64_t find_next_clear(uint64_t first) const noexcept;
+
+  /// Returns the index of the first unset bit in [first, last), or
+  /// `no_bits_left` if there are none
+  [[nodiscard]] uint64_t find_next_clear(uint64_t first,
+                                         uint64_t last) const noexcept;
+
+  /// Returns the index of the last set bit before `last`, or `no_bits_left` if
+  /// there are none
+  [[nodiscard]] uint64_t find_prev_set(uint64_t last) const noexcept;
+
+  /// Returns the index of the last set bit in [first, last), or
+  /// `no_bits_left` if there are none
+  [[nodiscard]] uint64_t find_prev_set(uint64_t first,
+                                       uint64_t last) const noexcept;
+
+  /// Returns the index of the last unset bit before `last`, or `no_bits_left`
+  /// if there are none
+  [[nodiscard]] uint64_t find_prev_clear(uint64_t last) const noexcept;
+
+  /// Returns the index of the last unset bit in [first, last), or
+  /// `no_bits_left` if there are none
+  [[nodiscard]] uint64_t find_prev_clear(uint64_t first,
+                                         uint64_t last) const noexcept;
+
+  /// Returns the start of the first run of at least `length` set (or unset)
+  /// bits at or after `first`, or `no_bits_left` if there are none.  If the
+  /// run begins before `first`, `first` is returned.
+  [[nodiscard]] uint64_t find_first_run(uint64_t length, bool set,
+                                        uint64_t first = 0) const noexcept;
+
+  /// Returns the start of the first run of at least `length` set (or unset)
+  /// bits that lies within [first, last), or `no_bits_left` if there are none.
+  [[nodiscard]] uint64_t find_first_run(uint64_t length, bool set,
+                                        uint64_t first,
+                                        uint64_t last) const noexcept;
+
+  /// Writes the indices of the set (or unset) bits at or after `first` to
+  /// `out` until it is full (see bitmap_view::flatten)
+  [[nodiscard]] bitmap_scan_batch flatten(yat::span<uint32_t> out,
+                                          bool set = true,
+                                          uint64_t first = 0) const noexcept;
+
+  /// Writes the indices of the set (or unset) bits at or after `first` to
+  /// `out` until it is full (see bitmap_view::flatten)
+  [[nodiscard]] bitmap_scan_batch flatten(yat::span<uint64_t> out,
+                                          bool set = true,
+                                          uint64_t first = 0) const noexcept;
+
+  /// Applies a bitwise operation between this bitmap and `rhs`, storing the
+  /// result in this bitmap.  If `rhs` has fewer bits than this bitmap, its
+  /// missing bits are treated as unset.  Bits of `rhs` beyond the size of this
+  /// bitmap are ignored.
+  basic_bitmap& apply(bitwise_op op, const bitmap_view& rhs) noexcept;
+
+  /// In-place bitwise AND (see apply)
+  basic_bitmap& operator&=(const bitmap_view& rhs) noexcept {
+    return apply(bitwise_op::bit_and, rhs);
+  }
+
+  /// In-place bitwise OR (see apply)
+  basic_bitmap& operator|=(const bitmap_view& rhs) noexcept {
+    return apply(bitwise_op::bit_or, rhs);
+  }
+
+  /// In-place bitwise XOR (see apply)
+  basic_bitmap& operator^=(const bitmap_view& rhs) noexcept {
+    return apply(bitwise_op::bit_xor, rhs);
+  }
+
+  /// In-place bitwise AND NOT (see apply)
+  basic_bitmap& and_not(const bitmap_view& rhs) noexcept {
+    return apply(bitwise_op::bit_and_not, rhs);
   }
 
+  /// Copies the `n` bits of `src` starting at `src_offset` to the bits of
+  /// this bitmap starting at `dst_offset`.  The bits are copied a word at a
+  /// time, joining source words that aren't aligned with funnel shifts.  `src`
+  /// may be a view of this bitmap, in which case the ranges may overlap.  No
+  /// bounds checking is performed and accessing an invalid index is undefined
+  /// behavior.
+  basic_bitmap& copy_bits(uint64_t dst_offset, const bitmap_view& src,
+                          uint64_t src_offset, uint64_t n) noexcept;
+
+  /// Returns a bitmap that holds a copy of the `n` bits starting at `first`
+  /// and uses the same allocator.  No bounds checking is performed and
+  /// accessing an invalid index is undefined behavior.
+  [[nodiscard]] basic_bitmap slice(uint64_t first, uint64_t n) const;
+
+  /// Moves every bit `n` positions towards the end of the bitmap, like
+  /// std::bitset::operator<<=.  Bits that are moved past the end are dropped
+  /// and the first `n` bits are cleared.
+  basic_bitmap& shift_left(uint64_t n) noexcept;
+
+  /// Moves every bit `n` positions towards the start of the bitmap, like
+  /// std::bitset::operator>>=.  Bits that are moved before the start are
+  /// dropped and the last `n` bits are cleared.
+  basic_bitmap& shift_right(uint64_t n) noexcept;
+
   /// Return the count of bits in the set
   constexpr uint64_t count() const noexcept { return _count; }
 
-  /// Resize the bitset
+  /// Resize the bitset.  Any new bits are unset.
   void resize(uint64_t n) {
-    _storage.resize(cas(n));
+    // Clear the bits that are cut off so that they don't reappear if we grow
+    // again and so that the padding stays unset
+    if (n < _count) {
+      clear(n, _count - n);
+    }
+
+    _storage.resize(padded(n));
     _count = n;
   }
 
+  /// Appends a copy of the bits in a view to the end of the bitmap
+  basic_bitmap& append(const bitmap_view& bits);
+
+  /// Returns the allocator that is used for the storage
+  [[nodiscard]] Allocator get_allocator() const noexcept {
+    return _storage.get_allocator().inner();
+  }
+
  private:
-  std::vector<storage_type> _storage{};  ///< Underlying bit storage
-  uint64_t _count{};                     ///< Number of bits in bitset
+  /// Stores packed bits in [first, first + count).  `words(i, num_words,
+  /// out)` packs whole words starting at value `i` and `partial(i, n)`
+  /// returns `n` packed values starting at value `i`.
+  template <typename WordsFn, typename PartialFn>
+  void assign_packed(uint64_t first, uint64_t count, WordsFn&& words,
+                     PartialFn&& partial) {
+    // Merges packed bits into a word that is only partially covered
+    const auto merge = [this](uint64_t w, uint64_t bits, uint64_t mask) {
+      auto& val = _storage[static_cast<size_t>(w)];
+      val = (val & ~mask) | (bits & mask);
+    };
+
+    uint64_t i = 0;
+
+    if (bi(first) != 0 && count != 0) {
+      i = std::min(count, storage_bits - bi(first));
+      merge(si(first),
+            partial(size_t{0}, static_cast<size_t>(i)) << bi(first),
+            detail::word_mask(bi(first), i));
+    }
+
+    const auto num_words = (count - i) / storage_bits;
+
+    if (num_words != 0) {
+      words(static_cast<size_t>(i), static_cast<size_t>(num_words),
+            _storage.data() + si(first + i));
+      i += num_words * storage_bits;
+    }
+
+    if (i < count) {
+      merge(si(first + i),
+            partial(static_cast<size_t>(i), static_cast<size_t>(count - i)),
+            detail::word_mask(0, count - i));
+    }
+  }
 
-  friend class bitmap_view;
+  std::vector<storage_type, storage_allocator> _storage{};  ///< Bit storage
+  uint64_t _count{};  ///< Number of bits in bitset
+
+  friend class atomic_bitmap;
+
+  template <bool>
+  friend class basic_bit_span;
+
+  template <typename, bit_order>
+  friend class basic_bitmap_view;
 };
 
-/// A view into a bitmap
-class bitmap_view {
+/// A bitmap that uses the default allocator
+using bitmap = basic_bitmap<>;
+
+#ifdef YAT_INTERNAL_HAS_MEMORY_RESOURCE
+namespace pmr {
+
+/// A bitmap that allocates its storage from a `std::pmr::memory_resource`
+using bitmap =
+    basic_bitmap<std::pmr::polymorphic_allocator<little_uint64_t>>;
+
+}  // namespace pmr
+#endif
+
+/// A view into a bitmap that is stored as an array of `Word`s with the bits
+/// of each word numbered in `Order`.
+///
+/// `Word` is an unsigned integer type of 8, 16, 32 or 64 bits, such as
+/// `uint8_t` or `big_uint32_t`.  The default is the yat::bitmap layout.  Bits
+/// are always read 64 at a time and rearranged into the yat::bitmap layout as
+/// they are loaded, so any layout can be viewed in place.
+template <typename Word, bit_order Order>
+class basic_bitmap_view {
  protected:
   //
   //  Rather than reading one byte at a time, we can use little endian unsigned
   //  integers of any size and the byte reordering will work as expected.
+  //  Other layouts use a wrapper that converts to the same bits.
   //
-  using storage_type = yat::little_uint64_t;
+  using storage_type = detail::bitmap_storage_t<Word, Order>;
   static constexpr uint64_t storage_bits =
-      std::numeric_limits<storage_type::value_type>::digits;
+      std::numeric_limits<uint64_t>::digits;
 
   /// Calculates the needed array size to hold a certain amount of bits
   static constexpr size_t cas(uint64_t block_count) noexcept {
@@ -155,194 +921,1127 @@ class bitmap_view {
   static constexpr uint64_t bi(uint64_t n) noexcept { return n % storage_bits; }
 
   /// Calculate the bitmask for an index
-  static constexpr storage_type::value_type bm(uint64_t n) noexcept {
-    return 1ULL << bi(n);
+  static constexpr uint64_t bm(uint64_t n) noexcept { return 1ULL << bi(n); }
+
+  /// Returns storage words as they are laid out in memory, for use with the
+  /// kernels that give the same results for every layout (see
+  /// detail::bitmap_word)
+  [[nodiscard]] static const little_uint64_t* raw(
+      const storage_type* words) noexcept {
+    if constexpr (std::is_same_v<storage_type, little_uint64_t>) {
+      return words;
+    } else {
+      return reinterpret_cast<const little_uint64_t*>(words);
+    }
+  }
+
+  /// Returns the viewed storage words as they are laid out in memory
+  [[nodiscard]] const little_uint64_t* raw_words() const noexcept {
+    return raw(_bits.data());
+  }
+
+  /// Reads a storage word that might not be aligned
+  [[nodiscard]] static uint64_t load(const storage_type* p) noexcept {
+    storage_type word{};
+    std::memcpy(static_cast<void*>(&word), p, sizeof(word));
+    return word;
   }
 
  public:
-  /// Create a bitmap view a set of bits
-  bitmap_view(const void* data, uint64_t num_bits) noexcept
+  /// Special marker that is returned when there are no bits left to scan
+  static constexpr uint64_t no_bits_left = std::numeric_limits<uint64_t>::max();
+
+  /// Create a bitmap view a set of bits.  The data must be readable in whole
+  /// 64-bit words, but doesn't need to be aligned.
+  basic_bitmap_view(const void* data, uint64_t num_bits) noexcept
       : _num_bits{num_bits},
         _bits{static_cast<const storage_type*>(data), cas(num_bits)} {}
 
+  /// Create a bitmap view over a buffer that holds at least the bytes that
+  /// store `num_bits` bits.  The buffer doesn't need to be aligned or padded to
+  /// a whole 64-bit word.  The whole words are read in place and the bytes of
+  /// a partial last word are copied when the view is created, so nothing
+  /// outside of the buffer is ever read.
+  basic_bitmap_view(yat::span<const std::byte> bytes,
+                    uint64_t num_bits) noexcept
+      : _num_bits{num_bits},
+        _bits{reinterpret_cast<const storage_type*>(bytes.data()),
+              std::min(cas(num_bits), bytes.size() / sizeof(storage_type))} {
+    if (_bits.size() < cas(num_bits)) {
+      const auto offset = _bits.size() * sizeof(storage_type);
+      storage_type tail{};
+
+      std::memcpy(static_cast<void*>(&tail), bytes.data() + offset,
+                  std::min(bytes.size() - offset, sizeof(tail)));
+      _tail = tail;
+    }
+  }
+
   /// Create a bitmap view from a bitmap
-  bitmap_view(const bitmap& bm) noexcept
-      : bitmap_view{bm._storage.data(), bm._count} {}
+  template <typename Allocator, size_t Alignment, typename S = storage_type,
+            typename = std::enable_if_t<std::is_same_v<S, little_uint64_t>>>
+  basic_bitmap_view(const basic_bitmap<Allocator, Alignment>& bm) noexcept
+      : basic_bitmap_view{bm._storage.data(), bm._count} {}
 
   /// Access a given bit.  No bounds checking is performed and accessing an
   /// invalid index is undefined behavior.
   bool operator[](uint64_t n) const noexcept {
-    return (_bits[si(n)] & bm(n)) != 0;
+    return (word(static_cast<size_t>(si(n))) & bm(n)) != 0;
   }
 
- protected:
-  uint64_t _num_bits{};  ///< The number of bits that we're scanning for
-  yat::span<const storage_type> _bits{};  ///< The view into the data
-};
+  /// Returns the number of bits in the view
+  [[nodiscard]] constexpr uint64_t count() const noexcept { return _num_bits; }
 
-/// A bitmap scanner is used to scan bitmaps for ranges of set or unset bits.
-///
-/// It assumes that bitmaps are stored as an array of bytes that count bits from
-/// LSB->MSB.
-class bitmap_scanner : public bitmap_view {
-  /// Special marker that is returned when there are no bits left to scan
-  static constexpr uint64_t no_bits_left = std::numeric_limits<uint64_t>::max();
+  /// Returns the underlying storage words.  Bits in the last word beyond the
+  /// end of the view have unspecified values.  A partial last word of a view
+  /// over a byte buffer is not included (see word()).
+  [[nodiscard]] constexpr yat::span<const storage_type> words() const noexcept {
+    return _bits;
+  }
 
-  /// An iterator for bitmap_scanner that iterates through the scanned ranges
-  class iterator {
-   public:
-    using iterator_category = std::input_iterator_tag;
-    using value_type = struct {
-      uint64_t start;  /// start of the range
-      uint64_t count;  /// number of elements in the range
-    };
-    using difference_type = void;  // No meaningful way of taking difference
-    using pointer = const value_type*;
-    using reference = const value_type&;
+  /// Returns the 64 bits of a storage word in the yat::bitmap layout.  This
+  /// also works for the partial last word of a view over a byte buffer.  Bits
+  /// beyond the end of the view have unspecified values.
+  [[nodiscard]] uint64_t word(size_t w) const noexcept {
+    return (w < _bits.size()) ? load(_bits.data() + w) : _tail;
+  }
 
-    /// Construct an empty iterator (this will compare with end())
-    constexpr iterator() noexcept {};  // clang 5 had a bug when using
-                                       // "= default" here
+  /// Returns true if every bit in the view is set
+  [[nodiscard]] bool all_set() const noexcept { return all_set(0, _num_bits); }
+
+  /// Returns true if every bit in a range is set.  No bounds checking is
+  /// performed and accessing an invalid index is undefined behavior.
+  [[nodiscard]] bool all_set(uint64_t start, uint64_t count) const noexcept {
+    return detail::visit_word_range(
+        start, count,
+        [this](uint64_t w, uint64_t mask) {
+          return (word(static_cast<size_t>(w)) & mask) == mask;
+        },
+        [this](uint64_t first, uint64_t last) {
+          return find_word_not_equal(static_cast<size_t>(first),
+                                     static_cast<size_t>(last),
+                                     std::numeric_limits<uint64_t>::max()) ==
+                 last;
+        });
+  }
 
-    /// Construct an iterator from a chunk bitmap
-    explicit iterator(const bitmap_scanner* bm)
-        : _bm{bm}, _find_set{_bm->_scan_set} {
-      next();
-    }
+  /// Returns true if any bit in the view is set
+  [[nodiscard]] bool any_set() const noexcept { return any_set(0, _num_bits); }
 
-    /// Equality operator
-    friend bool operator==(const iterator& lhs, const iterator& rhs) noexcept {
-      return (lhs._bm == rhs._bm) && (lhs._next_block == rhs._next_block);
-    }
+  /// Returns true if any bit in a range is set.  No bounds checking is
+  /// performed and accessing an invalid index is undefined behavior.
+  [[nodiscard]] bool any_set(uint64_t start, uint64_t count) const noexcept {
+    return !none_set(start, count);
+  }
 
-    /// Inequality operator
-    friend bool operator!=(const iterator& lhs, const iterator& rhs) noexcept {
-      return (lhs._bm != rhs._bm) || (lhs._next_block != rhs._next_block);
-    }
+  /// Returns true if no bit in the view is set
+  [[nodiscard]] bool none_set() const noexcept {
+    return none_set(0, _num_bits);
+  }
 
-    /// Sentinel equality
-    bool operator==(const yat::default_sentinel_t&) const noexcept {
-      return _bm == nullptr;
-    }
+  /// Returns true if no bit in a range is set.  No bounds checking is
+  /// performed and accessing an invalid index is undefined behavior.
+  [[nodiscard]] bool none_set(uint64_t start, uint64_t count) const noexcept {
+    return detail::visit_word_range(
+        start, count,
+        [this](uint64_t w, uint64_t mask) {
+          return (word(static_cast<size_t>(w)) & mask) == 0;
+        },
+        [this](uint64_t first, uint64_t last) {
+          return find_word_not_equal(static_cast<size_t>(first),
+                                     static_cast<size_t>(last), 0) == last;
+        });
+  }
 
-    /// Dereference operator
-    reference operator*() const noexcept { return _range; }
+  /// Returns the number of set bits in the view
+  [[nodiscard]] uint64_t count_set() const noexcept {
+    return count_set(0, _num_bits);
+  }
 
-    /// Pointer dereference operator
-    pointer operator->() const noexcept { return &_range; }
+  /// Returns the number of set bits in a range.  No bounds checking is
+  /// performed and accessing an invalid index is undefined behavior.
+  [[nodiscard]] uint64_t count_set(uint64_t start,
+                                   uint64_t count) const noexcept {
+    uint64_t total = 0;
+
+    detail::visit_word_range(
+        start, count,
+        [this, &total](uint64_t w, uint64_t mask) {
+          total += static_cast<uint64_t>(
+              popcount(word(static_cast<size_t>(w)) & mask));
+          return true;
+        },
+        [this, &total](uint64_t first, uint64_t last) {
+          total += detail::active_bitmap_kernels().popcount(raw_words(),
+                                                            first, last);
+          return true;
+        });
+
+    return total;
+  }
 
-    /// Prefix increment operator
-    iterator& operator++() { return next(); }
+  /// Returns the index of the first set bit at or after `first`, or
+  /// `no_bits_left` if there are none
+  [[nodiscard]] uint64_t find_next_set(uint64_t first) const noexcept {
+    return find_next<true>(first, _num_bits);
+  }
 
-    /// Postfix increment operator
-    iterator operator++(int) {
-      iterator copy{*this};
+  /// Returns the index of the first set bit in [first, last), or
+  /// `no_bits_left` if there are none
+  [[nodiscard]] uint64_t find_next_set(uint64_t first,
+                                       uint64_t last) const noexcept {
+    return find_next<true>(first, std::min(last, _num_bits));
+  }
 
-      operator++();
+  /// Returns the index of the first unset bit at or after `first`, or
+  /// `no_bits_left` if there are none
+  [[nodiscard]] uint64_t find_next_clear(uint64_t first) const noexcept {
+    return find_next<false>(first, _num_bits);
+  }
 
-      return copy;
-    }
+  /// Returns the index of the first unset bit in [first, last), or
+  /// `no_bits_left` if there are none
+  [[nodiscard]] uint64_t find_next_clear(uint64_t first,
+                                         uint64_t last) const noexcept {
+    return find_next<false>(first, std::min(last, _num_bits));
+  }
 
-   protected:
-    /// Cache the next set of bitmap data to read
-    void cache_next() noexcept {
-      // Fetch the next set of bits into the cache
-      _cache = _bm->_bits[_next_block / _bm->storage_bits];
+  /// Returns the index of the last set bit before `last`, or `no_bits_left` if
+  /// there are none
+  [[nodiscard]] uint64_t find_prev_set(uint64_t last) const noexcept {
+    return find_prev<true>(0, std::min(last, _num_bits));
+  }
 
-      // If we're scanning for unset bits then invert the bits since we actually
-      // only do logic to scan for ones
-      if (!_find_set) {
-        _cache = ~_cache;
-      }
-    }
+  /// Returns the index of the last set bit in [first, last), or
+  /// `no_bits_left` if there are none
+  [[nodiscard]] uint64_t find_prev_set(uint64_t first,
+                                       uint64_t last) const noexcept {
+    return find_prev<true>(first, std::min(last, _num_bits));
+  }
 
-    /// Toggles the scanning mode
-    void toggle_mode() noexcept {
-      _find_set = !_find_set;
-      _cache = ~_cache;
-    }
+  /// Returns the index of the last unset bit before `last`, or `no_bits_left`
+  /// if there are none
+  [[nodiscard]] uint64_t find_prev_clear(uint64_t last) const noexcept {
+    return find_prev<false>(0, std::min(last, _num_bits));
+  }
 
-    /// Scan for the next set bit
-    uint64_t scan() noexcept {
-      while (_next_block < _bm->_num_bits) {
-        // Calculate the bit we're starting our scan
-        const auto i = _next_block % _bm->storage_bits;
-
-        // If we're scanning the first bit, we need to cache the bits
-        if (i == 0) {
-          cache_next();
-
-          // If there are no bits set then there's nothing to scan for, so let's
-          // move on.
-          if (_cache == 0) {
-            _next_block += _bm->storage_bits;
-            continue;
-          }
-        }
+  /// Returns the index of the last unset bit in [first, last), or
+  /// `no_bits_left` if there are none
+  [[nodiscard]] uint64_t find_prev_clear(uint64_t first,
+                                         uint64_t last) const noexcept {
+    return find_prev<false>(first, std::min(last, _num_bits));
+  }
 
-        // Mask the already fetched baclues and count the number of trailing
-        // zero bits
-        const auto c = yat::countr_zero((_cache >> i) << i);
+  /// Returns the start of the first run of at least `length` set (or unset)
+  /// bits at or after `first`, or `no_bits_left` if there are none.  If the
+  /// run begins before `first`, `first` is returned.
+  [[nodiscard]] uint64_t find_first_run(uint64_t length, bool set,
+                                        uint64_t first = 0) const noexcept {
+    return find_first_run(length, set, first, _num_bits);
+  }
 
-        // If c is the number of bits, then there are no more set bits
-        // and we need to move on to scan the next set
-        if (c == _bm->storage_bits) {
-          _next_block += _bm->storage_bits - i;
-          continue;
-        }
+  /// Returns the start of the first run of at least `length` set (or unset)
+  /// bits that lies within [first, last), or `no_bits_left` if there are none.
+  [[nodiscard]] uint64_t find_first_run(uint64_t length, bool set,
+                                        uint64_t first,
+                                        uint64_t last) const noexcept {
+    last = std::min(last, _num_bits);
 
-        // Adjust the next block for the next scan
-        _next_block += static_cast<uint64_t>(c) + 1 - i;
+    if (length == 0) {
+      return (first <= last) ? first : no_bits_left;
+    }
 
-        // If the last black is within range then return it
-        if (const uint64_t next = _next_block - 1; next < _bm->_num_bits) {
-          return next;
-        }
+    while (first < last && last - first >= length) {
+      const auto start =
+          set ? find_next<true>(first, last) : find_next<false>(first, last);
 
+      if (start == no_bits_left || last - start < length) {
         return no_bits_left;
       }
 
+      auto end =
+          set ? find_next<false>(start, last) : find_next<true>(start, last);
+
+      if (end == no_bits_left) {
+        end = last;
+      }
+
+      if (end - start >= length) {
+        return start;
+      }
+
+      first = end;
+    }
+
+    return no_bits_left;
+  }
+
+  /// Writes the indices of the set (or unset) bits at or after `first` to
+  /// `out` in ascending order, stopping once it is full.  Returns the number of
+  /// indices that were written and the bit to resume from, which is `count()`
+  /// once every bit has been visited.  Entries of `out` past the number that
+  /// were written may be overwritten.  The indices must fit in 32 bits.
+  ///
+  /// This is much faster than expanding the ranges of a bitmap_scanner when
+  /// the bits are scattered.
+  [[nodiscard]] bitmap_scan_batch flatten(yat::span<uint32_t> out,
+                                          bool set = true,
+                                          uint64_t first = 0) const noexcept {
+    return flatten_bits(out, set, first);
+  }
+
+  /// Writes the indices of the set (or unset) bits at or after `first` to
+  /// `out` in ascending order, stopping once it is full.  Returns the number of
+  /// indices that were written and the bit to resume from, which is `count()`
+  /// once every bit has been visited.  Entries of `out` past the number that
+  /// were written may be overwritten.
+  [[nodiscard]] bitmap_scan_batch flatten(yat::span<uint64_t> out,
+                                          bool set = true,
+                                          uint64_t first = 0) const noexcept {
+    return flatten_bits(out, set, first);
+  }
+
+ protected:
+  /// Returns the index of the first set (or unset) bit in [first, last), or
+  /// `no_bits_left` if there are none.  `last` must not be larger than the
+  /// number of bits in the view.
+  template <bool Set>
+  [[nodiscard]] uint64_t find_next(uint64_t first,
+                                   uint64_t last) const noexcept {
+    if (first >= last) {
       return no_bits_left;
     }
 
+    // Words that are all zeros have no set bits and words that are all ones
+    // have no unset bits, so they can be skipped
+    constexpr uint64_t skip = Set ? 0 : std::numeric_limits<uint64_t>::max();
+    const auto last_word = static_cast<size_t>(si(last - 1));
+
+    auto w = static_cast<size_t>(si(first));
+    uint64_t bits = (word(w) ^ skip) & ~detail::word_mask(0, bi(first));
+
+    while (bits == 0) {
+      if (w == last_word) {
+        return no_bits_left;
+      }
+
+      w = find_word_not_equal(w + 1, last_word + 1, skip);
+
+      if (w > last_word) {
+        return no_bits_left;
+      }
+
+      bits = word(w) ^ skip;
+    }
+
+    const auto n = w * storage_bits + static_cast<uint64_t>(countr_zero(bits));
+    return (n < last) ? n : no_bits_left;
+  }
+
+  /// Returns the index of the last set (or unset) bit in [first, last), or
+  /// `no_bits_left` if there are none.  `last` must not be larger than the
+  /// number of bits in the view.
+  template <bool Set>
+  [[nodiscard]] uint64_t find_prev(uint64_t first,
+                                   uint64_t last) const noexcept {
+    if (first >= last) {
+      return no_bits_left;
+    }
+
+    constexpr uint64_t skip = Set ? 0 : std::numeric_limits<uint64_t>::max();
+    const auto first_word = static_cast<size_t>(si(first));
+
+    auto w = static_cast<size_t>(si(last - 1));
+    uint64_t bits = (word(w) ^ skip) & detail::word_mask(0, bi(last - 1) + 1);
+
+    while (bits == 0) {
+      if (w == first_word) {
+        return no_bits_left;
+      }
+
+      const auto prev = find_last_word_not_equal(first_word, w, skip);
+
+      if (prev == w) {
+        return no_bits_left;
+      }
+
+      w = prev;
+      bits = word(w) ^ skip;
+    }
+
+    const auto n = w * storage_bits + storage_bits - 1 -
+                   static_cast<uint64_t>(countl_zero(bits));
+    return (n >= first) ? n : no_bits_left;
+  }
+
+  /// Writes the indices of the set (or unset) bits at or after `first` to
+  /// `out` (see flatten)
+  template <typename T>
+  [[nodiscard]] bitmap_scan_batch flatten_bits(yat::span<T> out, bool set,
+                                               uint64_t first) const noexcept {
+    if (first >= _num_bits) {
+      return {0, _num_bits};
+    }
+
+    const uint64_t flip = set ? 0 : std::numeric_limits<uint64_t>::max();
+    const auto last_word = static_cast<size_t>(si(_num_bits - 1));
+
+    // Whole words that are read in place can be decoded by the vectorized
+    // kernels, but only if they're in the yat::bitmap layout
+    const size_t kernel_last =
+        std::is_same_v<storage_type, little_uint64_t>
+            ? std::min(static_cast<size_t>(si(_num_bits)), _bits.size())
+            : 0;
+
+    size_t n = 0;
+    auto w = static_cast<size_t>(si(first));
+    uint64_t bits = (word(w) ^ flip) & ~detail::word_mask(0, bi(first));
+
+    while (true) {
+      if (w == last_word) {
+        bits &= detail::word_mask(0, bi(_num_bits - 1) + 1);
+      }
+
+      // Decode one bit at a time so that we can stop when `out` is full
+      for (; bits != 0; bits &= bits - 1) {
+        const auto bit =
+            w * storage_bits + static_cast<uint64_t>(countr_zero(bits));
+
+        if (n == out.size()) {
+          return {n, bit};
+        }
+
+        out[n++] = static_cast<T>(bit);
+      }
+
+      if (w++ == last_word) {
+        return {n, _num_bits};
+      }
+
+      // The kernel stops before a word that doesn't fit, which is then
+      // partially decoded above
+      if (w < kernel_last) {
+        const auto& kernels = detail::active_bitmap_kernels();
+
+        if constexpr (sizeof(T) == sizeof(uint32_t)) {
+          n += kernels.flatten32(raw_words(), w, kernel_last, flip,
+                                 out.data() + n, out.size() - n);
+        } else {
+          n += kernels.flatten64(raw_words(), w, kernel_last, flip,
+                                 out.data() + n, out.size() - n);
+        }
+
+        if (w > last_word) {
+          return {n, _num_bits};
+        }
+      }
+
+      bits = word(w) ^ flip;
+    }
+  }
+
+  /// Returns the index of the first word in [first, last) that is not equal
+  /// to `pattern`, or `last` if there are none.  The whole words are searched
+  /// in place with the vectorized kernels.
+  [[nodiscard]] size_t find_word_not_equal(size_t first, size_t last,
+                                           uint64_t pattern) const noexcept {
+    if (const auto n = std::min(last, _bits.size()); first < n) {
+      first = detail::active_bitmap_kernels().find_word_not_equal(
+          raw_words(), first, n, pattern);
+
+      if (first < n) {
+        return first;
+      }
+    }
+
+    // Check a partial last word that was copied
+    if (first < last && word(first) != pattern) {
+      return first;
+    }
+
+    return last;
+  }
+
+  /// Returns the index of the last word in [first, last) that is not equal
+  /// to `pattern`, or `last` if there are none
+  [[nodiscard]] size_t find_last_word_not_equal(
+      size_t first, size_t last, uint64_t pattern) const noexcept {
+    // Check a partial last word that was copied
+    if (first < last && last > _bits.size()) {
+      if (word(last - 1) != pattern) {
+        return last - 1;
+      }
+
+      const auto prev =
+          detail::active_bitmap_kernels().find_last_word_not_equal(
+              raw_words(), first, last - 1, pattern);
+      return (prev == last - 1) ? last : prev;
+    }
+
+    return detail::active_bitmap_kernels().find_last_word_not_equal(
+        raw_words(), first, last, pattern);
+  }
+
+  uint64_t _num_bits{};  ///< The number of bits that we're scanning for
+  yat::span<const storage_type> _bits{};  ///< The view into the data
+  uint64_t _tail{};  ///< A copy of a partial last word that isn't in `_bits`
+
+  template <typename, size_t>
+  friend class basic_bitmap;
+};
+
+template <typename Allocator, size_t Alignment>
+inline basic_bitmap<Allocator, Alignment>::basic_bitmap(
+    const bitmap_view& view, const Allocator& alloc)
+    : basic_bitmap{view._num_bits, alloc} {
+  if (!view._bits.empty()) {
+    std::memcpy(static_cast<void*>(_storage.data()), view._bits.data(),
+                view._bits.size_bytes());
+  }
+
+  // Views over byte buffers keep a partial last word separately
+  if (const auto n = view._bits.size(); n < cas(_count)) {
+    _storage[n] = view._tail;
+  }
+
+  // The view might have data in its last word beyond its last bit, which we
+  // don't want to copy
+  if (const auto n = bi(_count); n != 0) {
+    auto& val = _storage[si(_count)];
+    val = val & detail::word_mask(0, n);
+  }
+}
+
+template <typename Allocator, size_t Alignment>
+inline basic_bitmap<Allocator, Alignment>&
+basic_bitmap<Allocator, Alignment>::apply(bitwise_op op,
+                                          const bitmap_view& rhs) noexcept {
+  const auto n = std::min(_count, rhs._num_bits);
+
+  // Apply the operation to all the words that are fully covered by both
+  detail::active_bitmap_kernels().bitwise(_storage.data(), rhs.raw_words(),
+                                          si(n), op);
+
+  // Apply the operation to the partially covered word, making sure that bits
+  // beyond the end of rhs are treated as unset
+  if (const auto tail = bi(n); tail != 0) {
+    auto& val = _storage[si(n)];
+    val = detail::apply_bitwise_op(
+        op, val, rhs.word(si(n)) & detail::word_mask(0, tail));
+  }
+
+  // The only operation that can change bits beyond the end of rhs is AND
+  if (op == bitwise_op::bit_and && n < _count) {
+    clear(n, _count - n);
+  }
+
+  return *this;
+}
+
+template <typename Allocator, size_t Alignment>
+inline basic_bitmap<Allocator, Alignment>&
+basic_bitmap<Allocator, Alignment>::copy_bits(uint64_t dst_offset,
+                                              const bitmap_view& src,
+                                              uint64_t src_offset,
+                                              uint64_t n) noexcept {
+  // Overlapping ranges of the same storage are copied from the end when the
+  // destination comes after the source.  The view is captured by value so
+  // that stores to the destination can't alias it.
+  const bool backward =
+      src.raw_words() == _storage.data() && dst_offset > src_offset;
+
+  detail::copy_bits(
+      _storage.data(), dst_offset,
+      [view = src](uint64_t w) { return view.word(static_cast<size_t>(w)); },
+      src_offset, n, backward);
+
+  return *this;
+}
+
+template <typename Allocator, size_t Alignment>
+inline basic_bitmap<Allocator, Alignment>
+basic_bitmap<Allocator, Alignment>::slice(uint64_t first, uint64_t n) const {
+  basic_bitmap result{n, get_allocator()};
+  result.copy_bits(0, bitmap_view{*this}, first, n);
+  return result;
+}
+
+template <typename Allocator, size_t Alignment>
+inline basic_bitmap<Allocator, Alignment>&
+basic_bitmap<Allocator, Alignment>::shift_left(uint64_t n) noexcept {
+  if (n >= _count) {
+    clear(0, _count);
+    return *this;
+  }
+
+  copy_bits(n, bitmap_view{*this}, 0, _count - n);
+  clear(0, n);
+  return *this;
+}
+
+template <typename Allocator, size_t Alignment>
+inline basic_bitmap<Allocator, Alignment>&
+basic_bitmap<Allocator, Alignment>::shift_right(uint64_t n) noexcept {
+  if (n >= _count) {
+    clear(0, _count);
+    return *this;
+  }
+
+  copy_bits(0, bitmap_view{*this}, n, _count - n);
+  clear(_count - n, n);
+  return *this;
+}
+
+template <typename Allocator, size_t Alignment>
+inline basic_bitmap<Allocator, Alignment>&
+basic_bitmap<Allocator, Alignment>::append(const bitmap_view& bits) {
+  // Growing might move our storage, so a view of this bitmap is copied first
+  if (bits.count() != 0 && bits.raw_words() == _storage.data()) {
+    const basic_bitmap copy{bits, get_allocator()};
+    return append(bitmap_view{copy});
+  }
+
+  const auto first = _count;
+  resize(_count + bits.count());
+  return copy_bits(first, bits, 0, bits.count());
+}
+
+/// Returns the result of applying a bitwise operation between two bitmaps.
+/// The result has the same number of bits as `lhs` (see bitmap::apply).
+[[nodiscard]] inline bitmap apply(bitwise_op op, const bitmap_view& lhs,
+                                  const bitmap_view& rhs) {
+  bitmap result{lhs};
+  result.apply(op, rhs);
+  return result;
+}
+
+/// Bitwise AND of two bitmaps (see apply)
+[[nodiscard]] inline bitmap operator&(const bitmap_view& lhs,
+                                      const bitmap_view& rhs) {
+  return apply(bitwise_op::bit_and, lhs, rhs);
+}
+
+/// Bitwise OR of two bitmaps (see apply)
+[[nodiscard]] inline bitmap operator|(const bitmap_view& lhs,
+                                      const bitmap_view& rhs) {
+  return apply(bitwise_op::bit_or, lhs, rhs);
+}
+
+/// Bitwise XOR of two bitmaps (see apply)
+[[nodiscard]] inline bitmap operator^(const bitmap_view& lhs,
+                                      const bitmap_view& rhs) {
+  return apply(bitwise_op::bit_xor, lhs, rhs);
+}
+
+/// Bitwise AND NOT of two bitmaps (see apply)
+[[nodiscard]] inline bitmap and_not(const bitmap_view& lhs,
+                                    const bitmap_view& rhs) {
+  return apply(bitwise_op::bit_and_not, lhs, rhs);
+}
+
+namespace detail {
+
+/// Copies the rows of the columns of `in` whose bits are set in `selection`
+/// to the front of the columns of `out` (see yat::compact)
+template <typename... Ts, size_t... I>
+size_t compact_columns(const bitmap_view& selection,
+                       const std::tuple<yat::span<const Ts>...>& in,
+                       const std::tuple<yat::span<Ts>...>& out,
+                       std::index_sequence<I...>) {
+  constexpr uint64_t word_bits = std::numeric_limits<uint64_t>::digits;
+
+  const auto count =
+      std::min({selection.count(), uint64_t{std::get<I>(in).size()}...});
+  const auto capacity = std::min({std::get<I>(out).size()...});
+  const std::tuple<compact_word_fn<Ts>...> kernels{
+      compact_word_kernel<Ts>()...};
+
+  size_t n = 0;
+
+  for (uint64_t first = 0; first < count; first += word_bits) {
+    const auto i = static_cast<size_t>(first);
+    const auto num = std::min(word_bits, count - first);
+    uint64_t bits = selection.word(static_cast<size_t>(first / word_bits)) &
+                    word_mask(0, num);
+
+    if (bits == 0) {
+      continue;
+    }
+
+    // Whole words are handed to the kernels as long as there's room for
+    // everything that they might write
+    if (num == word_bits && capacity - n >= word_bits) {
+      if (bits == std::numeric_limits<uint64_t>::max()) {
+        (std::copy_n(std::get<I>(in).data() + i, word_bits,
+                     std::get<I>(out).data() + n),
+         ...);
+      } else {
+        (std::get<I>(kernels)(bits, std::get<I>(in).data() + i,
+                              std::get<I>(out).data() + n),
+         ...);
+      }
+
+      n += static_cast<size_t>(popcount(bits));
+      continue;
+    }
+
+    // Near the edges the values are copied one at a time
+    for (; bits != 0; bits &= bits - 1) {
+      if (n == capacity) {
+        return n;
+      }
+
+      const auto j = i + static_cast<size_t>(countr_zero(bits));
+      ((std::get<I>(out)[n] = std::get<I>(in)[j]), ...);
+      n++;
+    }
+  }
+
+  return n;
+}
+
+}  // namespace detail
+
+/// Copies the values of `in` whose bits are set in `selection` to the front
+/// of `out`, in order, and returns the number of values that were copied.
+/// Values beyond the end of `selection` aren't selected and copying stops
+/// once `out` is full.  Values of 4 or 8 bytes that are trivially copyable
+/// are gathered with vectorized compress instructions or shuffle tables.
+/// Entries of `out` past the number that were copied may be overwritten.
+template <typename T>
+size_t compact(const bitmap_view& selection,
+               yat::span<const yat::type_identity_t<T>> in,
+               yat::span<T> out) {
+  return detail::compact_columns(selection, std::tuple{in}, std::tuple{out},
+                                 std::index_sequence<0>{});
+}
+
+/// Copies the rows of several columns whose bits are set in `selection` (see
+/// compact).  Each column of `in` is compacted into the column of `out` at
+/// the same position, so the columns stay aligned.  Only the rows that are in
+/// every column are considered and copying stops once any column of `out` is
+/// full.  Returns the number of rows that were copied.
+template <typename... Ts>
+size_t compact(const bitmap_view& selection,
+               const std::tuple<yat::span<const Ts>...>& in,
+               const std::tuple<yat::span<Ts>...>& out) {
+  static_assert(sizeof...(Ts) != 0, "at least one column is required");
+
+  return detail::compact_columns(selection, in, out,
+                                 std::index_sequence_for<Ts...>{});
+}
+
+template <typename Allocator, size_t Alignment>
+inline bool basic_bitmap<Allocator, Alignment>::all_set() const noexcept {
+  return bitmap_view{*this}.all_set();
+}
+
+template <typename Allocator, size_t Alignment>
+inline bool basic_bitmap<Allocator, Alignment>::all_set(
+    uint64_t start, uint64_t count) const noexcept {
+  return bitmap_view{*this}.all_set(start, count);
+}
+
+template <typename Allocator, size_t Alignment>
+inline bool basic_bitmap<Allocator, Alignment>::any_set() const noexcept {
+  return bitmap_view{*this}.any_set();
+}
+
+template <typename Allocator, size_t Alignment>
+inline bool basic_bitmap<Allocator, Alignment>::any_set(
+    uint64_t start, uint64_t count) const noexcept {
+  return bitmap_view{*this}.any_set(start, count);
+}
+
+template <typename Allocator, size_t Alignment>
+inline bool basic_bitmap<Allocator, Alignment>::none_set() const noexcept {
+  return bitmap_view{*this}.none_set();
+}
+
+template <typename Allocator, size_t Alignment>
+inline bool basic_bitmap<Allocator, Alignment>::none_set(
+    uint64_t start, uint64_t count) const noexcept {
+  return bitmap_view{*this}.none_set(start, count);
+}
+
+template <typename Allocator, size_t Alignment>
+inline uint64_t basic_bitmap<Allocator, Alignment>::count_set() const noexcept {
+  return bitmap_view{*this}.count_set();
+}
+
+template <typename Allocator, size_t Alignment>
+inline uint64_t basic_bitmap<Allocator, Alignment>::count_set(
+    uint64_t start, uint64_t count) const noexcept {
+  return bitmap_view{*this}.count_set(start, count);
+}
+
+template <typename Allocator, size_t Alignment>
+inline uint64_t basic_bitmap<Allocator, Alignment>::find_next_set(
+    uint64_t first) const noexcept {
+  return bitmap_view{*this}.find_next_set(first);
+}
+
+template <typename Allocator, size_t Alignment>
+inline uint64_t basic_bitmap<Allocator, Alignment>::find_next_set(
+    uint64_t first, uint64_t last) const noexcept {
+  return bitmap_view{*this}.find_next_set(first, last);
+}
+
+template <typename Allocator, size_t Alignment>
+inline uint64_t basic_bitmap<Allocator, Alignment>::find_next_clear(
+    uint64_t first) const noexcept {
+  return bitmap_view{*this}.find_next_clear(first);
+}
+
+template <typename Allocator, size_t Alignment>
+inline uint64_t basic_bitmap<Allocator, Alignment>::find_next_clear(
+    uint64_t first, uint64_t last) const noexcept {
+  return bitmap_view{*this}.find_next_clear(first, last);
+}
+
+template <typename Allocator, size_t Alignment>
+inline uint64_t basic_bitmap<Allocator, Alignment>::find_prev_set(
+    uint64_t last) const noexcept {
+  return bitmap_view{*this}.find_prev_set(last);
+}
+
+template <typename Allocator, size_t Alignment>
+inline uint64_t basic_bitmap<Allocator, Alignment>::find_prev_set(
+    uint64_t first, uint64_t last) const noexcept {
+  return bitmap_view{*this}.find_prev_set(first, last);
+}
+
+template <typename Allocator, size_t Alignment>
+inline uint64_t basic_bitmap<Allocator, Alignment>::find_prev_clear(
+    uint64_t last) const noexcept {
+  return bitmap_view{*this}.find_prev_clear(last);
+}
+
+template <typename Allocator, size_t Alignment>
+inline uint64_t basic_bitmap<Allocator, Alignment>::find_prev_clear(
+    uint64_t first, uint64_t last) const noexcept {
+  return bitmap_view{*this}.find_prev_clear(first, last);
+}
+
+template <typename Allocator, size_t Alignment>
+inline uint64_t basic_bitmap<Allocator, Alignment>::find_first_run(
+    uint64_t length, bool set, uint64_t first) const noexcept {
+  return bitmap_view{*this}.find_first_run(length, set, first);
+}
+
+template <typename Allocator, size_t Alignment>
+inline uint64_t basic_bitmap<Allocator, Alignment>::find_first_run(
+    uint64_t length, bool set, uint64_t first, uint64_t last) const noexcept {
+  return bitmap_view{*this}.find_first_run(length, set, first, last);
+}
+
+template <typename Allocator, size_t Alignment>
+inline bitmap_scan_batch basic_bitmap<Allocator, Alignment>::flatten(
+    yat::span<uint32_t> out, bool set, uint64_t first) const noexcept {
+  return bitmap_view{*this}.flatten(out, set, first);
+}
+
+template <typename Allocator, size_t Alignment>
+inline bitmap_scan_batch basic_bitmap<Allocator, Alignment>::flatten(
+    yat::span<uint64_t> out, bool set, uint64_t first) const noexcept {
+  return bitmap_view{*this}.flatten(out, set, first);
+}
+
+/// A range of bits found by scanning a bitmap
+struct bitmap_range {
+  uint64_t start;  ///< start of the range
+  uint64_t count;  ///< number of elements in the range
+
+  /// Equality operator
+  friend constexpr bool operator==(const bitmap_range& lhs,
+                                   const bitmap_range& rhs) noexcept {
+    return lhs.start == rhs.start && lhs.count == rhs.count;
+  }
+
+  /// Inequality operator
+  friend constexpr bool operator!=(const bitmap_range& lhs,
+                                   const bitmap_range& rhs) noexcept {
+    return !(lhs == rhs);
+  }
+};
+
+/// Options that filter the ranges found by a bitmap_scanner
+struct bitmap_scan_options {
+  /// Ranges with fewer bits than this are skipped
+  uint64_t min_run_length{};
+
+  /// Ranges that are separated by gaps of at most this many bits are merged
+  /// into a single range, which includes the bits of the gaps
+  uint64_t max_gap_to_merge{};
+};
+
+/// A bitmap scanner is used to scan bitmaps for ranges of set or unset bits.
+///
+/// By default it assumes that bitmaps are stored as an array of bytes that
+/// count bits from LSB->MSB.  Other layouts can be scanned in place by choosing
+/// the `Word` and `Order` of the view (see basic_bitmap_view).
+template <typename Word = little_uint64_t,
+          bit_order Order = bit_order::lsb_first>
+class basic_bitmap_scanner : public basic_bitmap_view<Word, Order> {
+  using view_type = basic_bitmap_view<Word, Order>;
+  using typename view_type::storage_type;
+  using view_type::_bits;
+  using view_type::_num_bits;
+  using view_type::bi;
+  using view_type::cas;
+  using view_type::load;
+  using view_type::no_bits_left;
+  using view_type::raw;
+  using view_type::raw_words;
+  using view_type::si;
+  using view_type::storage_bits;
+
+  /// The state of a forward scan
+  struct scan_state {
+    uint64_t pos;          ///< The bit to continue scanning from
+    size_t word;           ///< The index of the cached word
+    uint64_t cache;        ///< The cached word, flipped to look for ones
+    bitmap_range pending;  ///< A range that was found but not returned
+    bool has_pending;      ///< There is a pending range
+  };
+
+  /// An iterator for bitmap_scanner that iterates through the scanned ranges
+  class iterator {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = bitmap_range;
+    using difference_type = void;  // No meaningful way of taking difference
+    using pointer = const value_type*;
+    using reference = const value_type&;
+
+    /// Construct an empty iterator (this will compare with end())
+    constexpr iterator() noexcept {};  // clang 5 had a bug when using
+                                       // "= default" here
+
+    /// Construct an iterator from a chunk bitmap that starts scanning at a
+    /// given bit
+    iterator(const basic_bitmap_scanner* bm, uint64_t first)
+        : _bm{bm}, _state{bm->start_scan(first)} {
+      next();
+    }
+
+    /// Equality operator
+    friend bool operator==(const iterator& lhs, const iterator& rhs) noexcept {
+      return (lhs._bm == rhs._bm) && (lhs._range == rhs._range);
+    }
+
+    /// Inequality operator
+    friend bool operator!=(const iterator& lhs, const iterator& rhs) noexcept {
+      return !(lhs == rhs);
+    }
+
+    /// Sentinel equality
+    bool operator==(const yat::default_sentinel_t&) const noexcept {
+      return _bm == nullptr;
+    }
+
+    /// Dereference operator
+    reference operator*() const noexcept { return _range; }
+
+    /// Pointer dereference operator
+    pointer operator->() const noexcept { return &_range; }
+
+    /// Prefix increment operator
+    iterator& operator++() { return next(); }
+
+    /// Postfix increment operator
+    iterator operator++(int) {
+      iterator copy{*this};
+
+      operator++();
+
+      return copy;
+    }
+
+   private:
     /// Get the next range
     iterator& next() noexcept {
-      // Get the start of the next range
-      const uint64_t s = scan();
-
-      // If there's no start then there are no more ranges and we need to set
-      // ourself as the end interator
-      if (s == no_bits_left) {
+      // If there are no more ranges then we need to set ourself as the end
+      // interator
+      if (!_bm->next_range(_state, _range)) {
         *this = {};
-        return (*this);
       }
 
-      // Toggle the scan mode to look for the next type of bit
-      toggle_mode();
+      return (*this);
+    }
+
+    const basic_bitmap_scanner* _bm{};  ///< Unowned pointer to bitmap
+    scan_state _state{};          ///< The state of the scan
+    value_type _range{};          ///< The current range
+  };
+
+  /// An iterator for bitmap_scanner that iterates through the scanned ranges
+  /// from the end of the window to the start
+  class reverse_iterator {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = bitmap_range;
+    using difference_type = void;  // No meaningful way of taking difference
+    using pointer = const value_type*;
+    using reference = const value_type&;
+
+    /// Construct an empty iterator (this will compare with rend())
+    constexpr reverse_iterator() noexcept {};  // clang 5 had a bug when using
+                                               // "= default" here
+
+    /// Construct an iterator from a chunk bitmap
+    explicit reverse_iterator(const basic_bitmap_scanner* bm)
+        : _bm{bm}, _prev_block{_bm->_last}, _find_set{_bm->_scan_set} {
+      next();
+    }
+
+    /// Equality operator
+    friend bool operator==(const reverse_iterator& lhs,
+                           const reverse_iterator& rhs) noexcept {
+      return (lhs._bm == rhs._bm) && (lhs._range == rhs._range);
+    }
 
-      // Get the end of the range
-      uint64_t e = scan();
+    /// Inequality operator
+    friend bool operator!=(const reverse_iterator& lhs,
+                           const reverse_iterator& rhs) noexcept {
+      return !(lhs == rhs);
+    }
 
-      // Toggle the scan mode to look for the next type of bit
-      toggle_mode();
+    /// Sentinel equality
+    bool operator==(const yat::default_sentinel_t&) const noexcept {
+      return _bm == nullptr;
+    }
+
+    /// Dereference operator
+    reference operator*() const noexcept { return _range; }
+
+    /// Pointer dereference operator
+    pointer operator->() const noexcept { return &_range; }
+
+    /// Prefix increment operator
+    reverse_iterator& operator++() { return next(); }
+
+    /// Postfix increment operator
+    reverse_iterator operator++(int) {
+      reverse_iterator copy{*this};
+
+      operator++();
+
+      return copy;
+    }
+
+   private:
+    /// Scan backwards for the last bit before `_prev_block` that we're
+    /// scanning for
+    uint64_t scan() noexcept {
+      const auto first = _bm->_first;
+      const auto first_word = static_cast<size_t>(si(first));
+
+      while (_prev_block > first) {
+        const auto w = static_cast<size_t>(si(_prev_block - 1));
+
+        // Only look at the bits of the word that are below the previous block
+        uint64_t bits = _bm->word(w);
+
+        if (!_find_set) {
+          bits = ~bits;
+        }
+
+        bits &= detail::word_mask(0, bi(_prev_block - 1) + 1);
+
+        // If there's nothing to find in this word then use the vectorized
+        // kernel to skip back past every preceding word that has nothing to
+        // find either
+        if (bits == 0) {
+          const uint64_t pattern =
+              _find_set ? 0 : std::numeric_limits<uint64_t>::max();
+          const auto prev =
+              _bm->find_last_word_not_equal(first_word, w, pattern);
+
+          _prev_block = (prev == w) ? first : (prev + 1) * storage_bits;
+          continue;
+        }
+
+        const auto n = w * storage_bits + storage_bits - 1 -
+                       static_cast<uint64_t>(countl_zero(bits));
+
+        if (n < first) {
+          break;
+        }
+
+        _prev_block = n;
+        return n;
+      }
+
+      _prev_block = first;
+      return no_bits_left;
+    }
+
+    /// Get the previous unfiltered range
+    bool next_raw(bitmap_range& range) noexcept {
+      // Get the last bit of the next range
+      const uint64_t e = scan();
 
-      // If there's no end then we set the end of the range to the end of the
-      // bitmap
       if (e == no_bits_left) {
-        e = _bm->_num_bits;
+        return false;
       }
 
-      _range = {s, e - s};
+      // Look for the bit just before the start of the range
+      _find_set = !_find_set;
+      const uint64_t s = scan();
+      _find_set = !_find_set;
 
-      return (*this);
+      // If there's no such bit then the range starts at the start of the
+      // scanned window
+      const uint64_t start = (s == no_bits_left) ? _bm->_first : s + 1;
+
+      range = {start, e + 1 - start};
+
+      return true;
     }
 
-   private:
-    const bitmap_scanner* _bm{};  ///< Unowned pointer to bitmap
-    uint64_t _next_block{};       ///< The next block number to be scanned
+    /// Get the next range
+    reverse_iterator& next() noexcept {
+      const auto& options = _bm->_options;
+
+      while (true) {
+        if (_has_pending) {
+          _range = _pending;
+          _has_pending = false;
+        } else if (!next_raw(_range)) {
+          // If there are no more ranges then we need to set ourself as the
+          // end interator
+          *this = {};
+          return (*this);
+        }
+
+        // Merge in the preceding ranges for as long as the gaps are small
+        if (options.max_gap_to_merge != 0) {
+          while (next_raw(_pending)) {
+            const auto gap = _range.start - (_pending.start + _pending.count);
+
+            if (gap > options.max_gap_to_merge) {
+              _has_pending = true;
+              break;
+            }
+
+            _range = {_pending.start,
+                      _range.start + _range.count - _pending.start};
+          }
+        }
+
+        if (_range.count >= options.min_run_length) {
+          return (*this);
+        }
+      }
+    }
+
+    const basic_bitmap_scanner* _bm{};  ///< Unowned pointer to bitmap
+    uint64_t _prev_block{};       ///< One past the next block to be scanned
     bool _find_set{};             ///< The current scanning mode
-    bitmap_scanner::storage_type _cache{};  ///< Cached data
-    value_type _range{};                    ///< The current range
+    value_type _range{};          ///< The current range
+    value_type _pending{};        ///< A range that was found but not returned
+    bool _has_pending{};          ///< There is a pending range
   };
 
  public:
@@ -351,20 +2050,116 @@ class bitmap_scanner : public bitmap_view {
   /// \param data The bitmap data to scan
   /// \param num_bits The number of bits to scan in the bitmap
   /// \param scan_set Indicates that we're scanning for ranges of set bits
-  bitmap_scanner(const void* data, uint64_t num_bits,
-                 bool scan_set = true) noexcept
-      : bitmap_view(data, num_bits), _scan_set{scan_set} {}
-
-  /// Creates a bitmap scanner for a given bitmap
-  bitmap_scanner(const bitmap& bitmap, bool scan_set = true) noexcept
-      : bitmap_view(bitmap), _scan_set{scan_set} {}
+  /// \param options Filters the ranges that are found
+  basic_bitmap_scanner(const void* data, uint64_t num_bits,
+                       bool scan_set = true,
+                       const bitmap_scan_options& options = {}) noexcept
+      : view_type(data, num_bits), _options{options}, _scan_set{scan_set} {}
+
+  /// Creates a bitmap scanner for a given bitmap or view
+  basic_bitmap_scanner(const view_type& view, bool scan_set = true,
+                       const bitmap_scan_options& options = {}) noexcept
+      : view_type(view), _options{options}, _scan_set{scan_set} {}
+
+  /// Creates a bitmap scanner that only scans the bits [first, last) of a
+  /// given bitmap or view.  Ranges that cross the edges of the window are
+  /// clipped to it.
+  ///
+  /// \param view The bitmap to scan
+  /// \param first The first bit to scan
+  /// \param last One past the last bit to scan
+  /// \param scan_set Indicates that we're scanning for ranges of set bits
+  /// \param options Filters the ranges that are found
+  basic_bitmap_scanner(const view_type& view, uint64_t first, uint64_t last,
+                       bool scan_set = true,
+                       const bitmap_scan_options& options = {}) noexcept
+      : view_type(view),
+        _first{std::min({first, last, view.count()})},
+        _last{std::min(last, view.count())},
+        _options{options},
+        _scan_set{scan_set} {}
+
+  /// Creates a bitmap scanner that scans the result of a bitwise operation
+  /// between two bitmaps without materializing it.  The scanned bits are the
+  /// same as those of `yat::apply(op, lhs, rhs)`.  Both bitmaps must have the
+  /// same layout.
+  basic_bitmap_scanner(const view_type& lhs, bitwise_op op,
+                       const view_type& rhs, bool scan_set = true,
+                       const bitmap_scan_options& options = {}) noexcept
+      : view_type(lhs),
+        _rhs{rhs.words().data()},
+        _rhs_words{std::min<size_t>(si(rhs.count()), cas(_num_bits))},
+        _op{op},
+        _options{options},
+        _scan_set{scan_set},
+        _fused{true} {
+    // If rhs ends partway through one of our words we need to mask off its
+    // bits beyond its end
+    if (_rhs_words < cas(_num_bits)) {
+      _rhs_tail_mask = detail::word_mask(0, bi(rhs.count()));
+      _rhs_tail = rhs.word(_rhs_words) & _rhs_tail_mask;
+    }
+  }
 
   /// Returns an iterator to the start of the ranges
-  [[nodiscard]] iterator begin() const noexcept { return iterator{this}; }
+  [[nodiscard]] iterator begin() const noexcept {
+    return iterator{this, _first};
+  }
 
   /// Returns an iterator to the end of the ranges
   [[nodiscard]] iterator end() const noexcept { return {}; }
 
+  /// Returns an iterator to the ranges that contain bits at or after `first`.
+  /// A range that contains `first` is clipped to start at it.
+  [[nodiscard]] iterator seek(uint64_t first) const noexcept {
+    return iterator{this, std::clamp(first, _first, _last)};
+  }
+
+  /// Returns an iterator that visits the ranges from last to first
+  [[nodiscard]] reverse_iterator rbegin() const noexcept {
+    return reverse_iterator{this};
+  }
+
+  /// Returns an iterator to the end of the reversed ranges
+  [[nodiscard]] reverse_iterator rend() const noexcept { return {}; }
+
+  /// Scans for ranges starting at the beginning of the window and writes as
+  /// many as will fit into `out` (see the overload below)
+  [[nodiscard]] bitmap_scan_batch scan_batch(
+      yat::span<bitmap_range> out) const noexcept {
+    return scan_batch(out, _first);
+  }
+
+  /// Scans for ranges starting at bit `cursor` and writes as many as will fit
+  /// into `out`.
+  ///
+  /// This produces the same ranges as iterating the scanner, but without the
+  /// per-range overhead of the iterator.  Only complete ranges are written.
+  /// Passing the returned cursor to the next call resumes the scan, which is
+  /// finished once the returned cursor is `window_last()`.
+  [[nodiscard]] bitmap_scan_batch scan_batch(yat::span<bitmap_range> out,
+                                             uint64_t cursor) const noexcept {
+    auto state = start_scan(cursor);
+    size_t n = 0;
+
+    while (n < out.size() && next_range(state, out[n])) {
+      n++;
+    }
+
+    // A pending range hasn't been written yet, so resume from its start
+    return {n, state.has_pending ? state.pending.start : state.pos};
+  }
+
+  /// Returns the first bit of the scanned window
+  [[nodiscard]] constexpr uint64_t window_first() const noexcept {
+    return _first;
+  }
+
+  /// Returns one past the last bit of the scanned window
+  [[nodiscard]] constexpr uint64_t window_last() const noexcept {
+    return _last;
+  }
+
   /// Returns true if the scanner has enough data to do scanning
   [[nodiscard]] bool is_valid() const noexcept { return !_bits.empty(); }
 
@@ -372,7 +2167,520 @@ class bitmap_scanner : public bitmap_view {
   [[nodiscard]] explicit operator bool() const noexcept { return is_valid(); }
 
  private:
-  bool _scan_set{};  ///< True if scanning for ranges of set bits
+  /// Returns the word of rhs at a given index, treating missing bits as unset
+  [[nodiscard]] uint64_t rhs_word(size_t i) const noexcept {
+    if (i < _rhs_words) {
+      return load(_rhs + i);
+    }
+
+    if (i == _rhs_words) {
+      return _rhs_tail;
+    }
+
+    return 0;
+  }
+
+  /// Returns the word being scanned at a given index
+  [[nodiscard]] uint64_t word(size_t i) const noexcept {
+    if (!_fused) {
+      return view_type::word(i);
+    }
+
+    return detail::apply_bitwise_op(_op, view_type::word(i), rhs_word(i));
+  }
+
+  /// Returns the state for a scan starting at a given bit
+  [[nodiscard]] scan_state start_scan(uint64_t first) const noexcept {
+    const auto pos = std::clamp(first, _first, _last);
+    const auto w = static_cast<size_t>(si(pos));
+
+    // Flipping the words when scanning for unset bits means that we always
+    // look for ones
+    const uint64_t cache = (pos < _last) ? word(w) ^ flip_mask() : 0;
+
+    return {pos, w, cache, {}, false};
+  }
+
+  /// Returns the mask that turns the bits we're scanning for into ones
+  [[nodiscard]] uint64_t flip_mask() const noexcept {
+    return _scan_set ? 0 : std::numeric_limits<uint64_t>::max();
+  }
+
+  /// Finds the next unfiltered range, returning false if there are none
+  bool next_raw_range(scan_state& state, bitmap_range& range) const noexcept {
+    const auto flip = flip_mask();
+    const auto words = last_word();
+
+    // The cached word is kept in the state so that runs that share a word
+    // only load it once
+    auto w = state.word;
+    auto cache = state.cache;
+
+    if (state.pos >= _last) {
+      return false;
+    }
+
+    // Find the start of the next range, skipping words with nothing in them
+    uint64_t bits = cache & ~detail::word_mask(0, state.pos - w * storage_bits);
+
+    while (bits == 0) {
+      w = find_word_not_equal(w + 1, words, flip);
+
+      if (w >= words) {
+        state.pos = _last;
+        return false;
+      }
+
+      cache = word(w) ^ flip;
+      bits = cache;
+    }
+
+    const auto start =
+        w * storage_bits + static_cast<uint64_t>(countr_zero(bits));
+
+    if (start >= _last) {
+      state.pos = _last;
+      return false;
+    }
+
+    // Find the end of the range, skipping words that are entirely in it
+    bits = ~cache & ~detail::word_mask(0, bi(start));
+
+    while (bits == 0) {
+      w = find_word_not_equal(w + 1, words, ~flip);
+
+      if (w >= words) {
+        range = {start, _last - start};
+        state.pos = _last;
+        return true;
+      }
+
+      cache = word(w) ^ flip;
+      bits = ~cache;
+    }
+
+    state.pos = std::min(
+        w * storage_bits + static_cast<uint64_t>(countr_zero(bits)), _last);
+    state.word = w;
+    state.cache = cache;
+    range = {start, state.pos - start};
+
+    return true;
+  }
+
+  /// Finds the next range that passes the filters, returning false if there
+  /// are none.  Short ranges and small gaps are handled here as they are
+  /// found, so they are never materialized.
+  bool next_range(scan_state& state, bitmap_range& range) const noexcept {
+    while (true) {
+      if (state.has_pending) {
+        range = state.pending;
+        state.has_pending = false;
+      } else if (!next_raw_range(state, range)) {
+        return false;
+      }
+
+      // Merge in the following ranges for as long as the gaps are small
+      if (_options.max_gap_to_merge != 0) {
+        while (next_raw_range(state, state.pending)) {
+          const auto end = range.start + range.count;
+
+          if (state.pending.start - end > _options.max_gap_to_merge) {
+            state.has_pending = true;
+            break;
+          }
+
+          range.count = state.pending.start + state.pending.count - range.start;
+        }
+      }
+
+      if (range.count >= _options.min_run_length) {
+        return true;
+      }
+    }
+  }
+
+  /// Returns one past the index of the last word in the scanned window
+  [[nodiscard]] size_t last_word() const noexcept {
+    return static_cast<size_t>(si(_last + storage_bits - 1));
+  }
+
+  /// Returns the index of the first scanned word in [first, last) that is not
+  /// equal to `pattern`, or `last` if there are none
+  [[nodiscard]] size_t find_word_not_equal(size_t first, size_t last,
+                                           uint64_t pattern) const noexcept {
+    if (!_fused) {
+      return view_type::find_word_not_equal(first, last, pattern);
+    }
+
+    // Scan the words that are fully covered by both bitmaps
+    if (const auto covered = std::min({_rhs_words, last, _bits.size()});
+        first < covered) {
+      first = detail::active_bitmap_kernels().find_op_word_not_equal(
+          raw_words(), raw(_rhs), _op, first, covered, pattern);
+
+      if (first < covered) {
+        return first;
+      }
+    }
+
+    // Check the word that is partially covered by rhs and a partial last word
+    // of our own that was copied
+    while (first < last && (first == _rhs_words || first >= _bits.size())) {
+      if (word(first) != pattern) {
+        return first;
+      }
+
+      first++;
+    }
+
+    // The remaining words are scanned against an unset rhs, so the result is
+    // either all zeros or lhs itself
+    if (_op == bitwise_op::bit_and) {
+      return (pattern == 0 || first >= last) ? last : first;
+    }
+
+    return view_type::find_word_not_equal(first, last, pattern);
+  }
+
+  /// Returns the index of the last scanned word in [first, last) that is not
+  /// equal to `pattern`, or `last` if there are none
+  [[nodiscard]] size_t find_last_word_not_equal(
+      size_t first, size_t last, uint64_t pattern) const noexcept {
+    if (!_fused) {
+      return view_type::find_last_word_not_equal(first, last, pattern);
+    }
+
+    // There's no reverse kernel for bitwise scanning, so compare the words one
+    // at a time
+    for (auto i = last; i > first; i--) {
+      if (word(i - 1) != pattern) {
+        return i - 1;
+      }
+    }
+
+    return last;
+  }
+
+  const storage_type* _rhs{};      ///< Unowned rhs data for bitwise scanning
+  size_t _rhs_words{};             ///< The number of words fully covered by rhs
+  uint64_t _rhs_tail_mask{};       ///< Mask of the bits of the partial rhs word
+  uint64_t _rhs_tail{};            ///< The masked partial rhs word
+  bitwise_op _op{};                ///< Bitwise operation for bitwise scanning
+  uint64_t _first{};               ///< The first bit of the scanned window
+  uint64_t _last{_num_bits};       ///< The end of the scanned window
+  bitmap_scan_options _options{};  ///< Filters the ranges that are found
+  bool _scan_set{};                ///< True if scanning for ranges of set bits
+  bool _fused{};                   ///< True if scanning the result of an op
+};
+
+/// A scanner for bitmaps that use the yat::bitmap layout
+using bitmap_scanner = basic_bitmap_scanner<>;
+
+/// A run of bits found by a bitmap_run_scanner
+struct bitmap_run {
+  uint64_t start;  ///< start of the run
+  uint64_t count;  ///< number of bits in the run
+  bool set;        ///< true if the bits in the run are set
+
+  /// Equality operator
+  friend constexpr bool operator==(const bitmap_run& lhs,
+                                   const bitmap_run& rhs) noexcept {
+    return lhs.start == rhs.start && lhs.count == rhs.count &&
+           lhs.set == rhs.set;
+  }
+
+  /// Inequality operator
+  friend constexpr bool operator!=(const bitmap_run& lhs,
+                                   const bitmap_run& rhs) noexcept {
+    return !(lhs == rhs);
+  }
+};
+
+/// A bitmap run scanner splits a bitmap into alternating runs of set and unset
+/// bits in a single pass.
+///
+/// Together the runs cover every bit of the scanned window, so this gives the
+/// same ranges as scanning for both set and unset bits with a bitmap_scanner
+/// without reading the bitmap twice.
+template <typename Word = little_uint64_t,
+          bit_order Order = bit_order::lsb_first>
+class basic_bitmap_run_scanner : public basic_bitmap_view<Word, Order> {
+  using view_type = basic_bitmap_view<Word, Order>;
+  using view_type::_num_bits;
+  using view_type::no_bits_left;
+
+  /// An iterator for bitmap_run_scanner that iterates through the runs
+  class iterator {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = bitmap_run;
+    using difference_type = void;  // No meaningful way of taking difference
+    using pointer = const value_type*;
+    using reference = const value_type&;
+
+    /// Construct an empty iterator (this will compare with end())
+    constexpr iterator() noexcept {};  // clang 5 had a bug when using
+                                       // "= default" here
+
+    /// Construct an iterator from a run scanner
+    explicit iterator(const basic_bitmap_run_scanner* bm)
+        : _bm{bm}, _next_block{bm->_first} {
+      next();
+    }
+
+    /// Equality operator
+    friend bool operator==(const iterator& lhs, const iterator& rhs) noexcept {
+      return (lhs._bm == rhs._bm) && (lhs._next_block == rhs._next_block);
+    }
+
+    /// Inequality operator
+    friend bool operator!=(const iterator& lhs, const iterator& rhs) noexcept {
+      return !(lhs == rhs);
+    }
+
+    /// Sentinel equality
+    bool operator==(const yat::default_sentinel_t&) const noexcept {
+      return _bm == nullptr;
+    }
+
+    /// Dereference operator
+    reference operator*() const noexcept { return _range; }
+
+    /// Pointer dereference operator
+    pointer operator->() const noexcept { return &_range; }
+
+    /// Prefix increment operator
+    iterator& operator++() { return next(); }
+
+    /// Postfix increment operator
+    iterator operator++(int) {
+      iterator copy{*this};
+
+      operator++();
+
+      return copy;
+    }
+
+   private:
+    /// Get the next run
+    iterator& next() noexcept {
+      const auto last = _bm->_last;
+
+      if (_next_block >= last) {
+        *this = {};
+        return (*this);
+      }
+
+      // The run continues until the first bit that doesn't match its first
+      // bit, so each word is only read once as we move along the bitmap
+      const bool set = (*_bm)[_next_block];
+      uint64_t e = set ? _bm->template find_next<false>(_next_block, last)
+                       : _bm->template find_next<true>(_next_block, last);
+
+      if (e == no_bits_left) {
+        e = last;
+      }
+
+      _range = {_next_block, e - _next_block, set};
+      _next_block = e;
+
+      return (*this);
+    }
+
+    const basic_bitmap_run_scanner* _bm{};  ///< Unowned pointer to bitmap
+    uint64_t _next_block{};           ///< The start of the next run
+    value_type _range{};              ///< The current run
+  };
+
+ public:
+  /// Creates a run scanner for a given bitmap or view
+  explicit basic_bitmap_run_scanner(const view_type& view) noexcept
+      : view_type(view) {}
+
+  /// Creates a run scanner that only scans the bits [first, last) of a given
+  /// bitmap or view.  Runs that cross the edges of the window are clipped to
+  /// it.
+  basic_bitmap_run_scanner(const view_type& view, uint64_t first,
+                           uint64_t last) noexcept
+      : view_type(view),
+        _first{std::min({first, last, view.count()})},
+        _last{std::min(last, view.count())} {}
+
+  /// Returns an iterator to the start of the runs
+  [[nodiscard]] iterator begin() const noexcept { return iterator{this}; }
+
+  /// Returns an iterator to the end of the runs
+  [[nodiscard]] iterator end() const noexcept { return {}; }
+
+ private:
+  uint64_t _first{};          ///< The first bit of the scanned window
+  uint64_t _last{_num_bits};  ///< One past the last bit of the scanned window
+};
+
+/// A run scanner for bitmaps that use the yat::bitmap layout
+using bitmap_run_scanner = basic_bitmap_run_scanner<>;
+
+/// A range of the indices of the set (or unset) bits of a bitmap in ascending
+/// order.  The indices are decoded a batch at a time with
+/// bitmap_view::flatten, so this can feed ranges pipelines without the cost of
+/// expanding the ranges of a bitmap_scanner.  The viewed bits must outlive the
+/// range.
+///
+/// This is a single pass range: the decoded batch is kept in the range so that
+/// iterators stay small, and calling begin() restarts decoding, which
+/// invalidates any other iterators.  A range can't be iterated by more than
+/// one thread at a time.
+template <typename Word = little_uint64_t,
+          bit_order Order = bit_order::lsb_first>
+class basic_set_bits_view
+    : public yat::ranges::view_interface<basic_set_bits_view<Word, Order>> {
+  using view_type = basic_bitmap_view<Word, Order>;
+
+  /// The number of indices that are decoded at a time
+  static constexpr size_t batch_size = 64;
+
+ public:
+  /// An iterator for basic_set_bits_view that iterates through the indices
+  class iterator {
+   public:
+    using iterator_concept = std::input_iterator_tag;
+    using iterator_category = std::input_iterator_tag;
+    using value_type = uint64_t;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const value_type*;
+    using reference = const value_type&;
+
+    /// Construct an empty iterator (this will compare with end())
+    constexpr iterator() noexcept {};  // clang 5 had a bug when using
+                                       // "= default" here
+
+    /// Construct an iterator to the current index of a view
+    explicit iterator(const basic_set_bits_view* view) noexcept
+        : _view{view}, _index{view->_batch[view->_pos]} {}
+
+    /// Equality operator.  The indices are strictly increasing, so an index
+    /// identifies a position in the range.
+    friend bool operator==(const iterator& lhs, const iterator& rhs) noexcept {
+      return (lhs._view == rhs._view) &&
+             (lhs._view == nullptr || lhs._index == rhs._index);
+    }
+
+    /// Inequality operator
+    friend bool operator!=(const iterator& lhs, const iterator& rhs) noexcept {
+      return !(lhs == rhs);
+    }
+
+    /// Dereference operator
+    reference operator*() const noexcept { return _index; }
+
+    /// Pointer dereference operator
+    pointer operator->() const noexcept { return &_index; }
+
+    /// Prefix increment operator
+    iterator& operator++() noexcept {
+      *this = _view->next();
+      return *this;
+    }
+
+    /// Postfix increment operator
+    iterator operator++(int) noexcept {
+      iterator copy{*this};
+
+      operator++();
+
+      return copy;
+    }
+
+   private:
+    const basic_set_bits_view* _view{};  ///< Unowned pointer to the view
+    value_type _index{};                 ///< The current index
+  };
+
+  /// Creates a range of the indices of the set (or unset) bits of a bitmap or
+  /// view
+  explicit basic_set_bits_view(const view_type& bits, bool set = true,
+                               uint64_t first = 0) noexcept
+      : _bits{bits}, _first{first}, _set{set} {}
+
+  /// Returns an iterator to the first index.  This restarts decoding.
+  [[nodiscard]] iterator begin() const noexcept {
+    _cursor = _first;
+    return fill();
+  }
+
+  /// Returns an iterator to the end of the indices
+  [[nodiscard]] iterator end() const noexcept { return {}; }
+
+ private:
+  /// Returns an iterator to the next decoded index
+  [[nodiscard]] iterator next() const noexcept {
+    return (++_pos == _size) ? fill() : iterator{this};
+  }
+
+  /// Decodes the next batch of indices and returns an iterator to the first
+  /// one, or end() if there are none
+  [[nodiscard]] iterator fill() const noexcept {
+    const auto batch =
+        _bits.flatten(yat::span<uint64_t>{_batch}, _set, _cursor);
+
+    if (batch.count == 0) {
+      return {};
+    }
+
+    _cursor = batch.cursor;
+    _size = batch.count;
+    _pos = 0;
+
+    return iterator{this};
+  }
+
+  view_type _bits;             ///< The bits that are decoded
+  uint64_t _first{};           ///< The first bit to decode
+  bool _set{true};             ///< Indicates that we're decoding the set bits
+  mutable uint64_t _cursor{};  ///< The bit to decode from next
+  mutable size_t _size{};      ///< The number of decoded indices
+  mutable size_t _pos{};       ///< The position of the current index
+  mutable std::array<uint64_t, batch_size> _batch{};  ///< Decoded indices
 };
 
-}  // namespace yat
\ No newline at end of file
+/// A range of the set (or unset) bits of a bitmap that uses the yat::bitmap
+/// layout
+using set_bits_view = basic_set_bits_view<>;
+
+namespace views {
+
+/// Returns a range of the indices of the set bits of a view, in ascending
+/// order
+template <typename Word, bit_order Order>
+[[nodiscard]] basic_set_bits_view<Word, Order> set_bits(
+    const basic_bitmap_view<Word, Order>& bits) noexcept {
+  return basic_set_bits_view<Word, Order>{bits};
+}
+
+/// Returns a range of the indices of the set bits of a bitmap, in ascending
+/// order
+[[nodiscard]] inline set_bits_view set_bits(const bitmap_view& bits) noexcept {
+  return set_bits_view{bits};
+}
+
+/// Returns a range of the indices of the unset bits of a view, in ascending
+/// order
+template <typename Word, bit_order Order>
+[[nodiscard]] basic_set_bits_view<Word, Order> unset_bits(
+    const basic_bitmap_view<Word, Order>& bits) noexcept {
+  return basic_set_bits_view<Word, Order>{bits, false};
+}
+
+/// Returns a range of the indices of the unset bits of a bitmap, in ascending
+/// order
+[[nodiscard]] inline set_bits_view unset_bits(
+    const bitmap_view& bits) noexcept {
+  return set_bits_view{bits, false};
+}
+
+}  // namespace views
+
+}  // namespace yat
+
+#undef YAT_INTERNAL_HAS_MEMORY_RESOURCE
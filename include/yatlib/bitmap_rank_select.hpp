@@ -0,0 +1,318 @@
+/*
+ * Copyright 2020 Joe T. Sylve, Ph.D.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "bit.hpp"
+#include "bitmap.hpp"
+
+namespace yat::detail {
+
+/// Returns the position of the `r`th (0-based) set bit in `w`.  `w` must have
+/// more than `r` bits set.
+[[nodiscard]] constexpr uint64_t select_in_word(uint64_t w,
+                                                uint64_t r) noexcept {
+  uint64_t pos = 0;
+
+  // Binary search for the bit by counting the bits in the lower half of what's
+  // left of the word
+  for (uint64_t width = 32; width > 0; width /= 2) {
+    const auto low = w & ((uint64_t{1} << width) - 1);
+    const auto c = static_cast<uint64_t>(popcount(low));
+
+    if (r >= c) {
+      r -= c;
+      w >>= width;
+      pos += width;
+    } else {
+      w = low;
+    }
+  }
+
+  return pos;
+}
+
+}  // namespace yat::detail
+
+namespace yat {
+
+/// A succinct index over a `bitmap_view` that answers rank and select queries
+/// in near-constant time.
+///
+/// The index stores the number of set bits before every 4096 bit superblock and
+/// before every 512 bit block within a superblock, except for the first block,
+/// plus the superblock of every 16384th set and unset bit.  This adds up to
+/// about 4.7% of the size of the bitmap.  The index does not own the bitmap data, which must outlive it and
+/// must not be modified.
+class bitmap_rank_select {
+  static constexpr uint64_t word_bits = std::numeric_limits<uint64_t>::digits;
+  static constexpr uint64_t block_words = 8;
+  static constexpr uint64_t block_bits = block_words * word_bits;
+  static constexpr uint64_t superblock_blocks = 8;
+  static constexpr uint64_t superblock_words = superblock_blocks * block_words;
+  static constexpr uint64_t superblock_bits = superblock_words * word_bits;
+  static constexpr uint64_t select_sample_rate = 16384;
+
+ public:
+  /// Special marker that is returned when there is no matching bit
+  static constexpr uint64_t no_bits_left = bitmap_view::no_bits_left;
+
+  /// Builds the index for a bitmap
+  explicit bitmap_rank_select(const bitmap_view& view)
+      : _view{view},
+        _superblocks(num_words() / superblock_words + 2),
+        _blocks((num_blocks() + superblock_blocks - 1) / superblock_blocks *
+                (superblock_blocks - 1)) {
+    uint64_t total = 0;
+    uint64_t super_total = 0;
+
+    for (size_t w = 0; w < num_words(); w++) {
+      if (w % superblock_words == 0) {
+        _superblocks[w / superblock_words] = total;
+        super_total = total;
+      }
+
+      if (w % block_words == 0 && w % superblock_words != 0) {
+        _blocks[block_index(w / block_words)] =
+            static_cast<uint16_t>(total - super_total);
+      }
+
+      total += static_cast<uint64_t>(popcount(word(w)));
+    }
+
+    _num_set = total;
+
+    // Add sentinels so that lookups for the bit at the very end of the bitmap
+    // don't need to be special-cased
+    const auto n = num_words();
+
+    if (n % superblock_words == 0) {
+      _superblocks[n / superblock_words] = total;
+      super_total = total;
+    }
+
+    if (n % block_words == 0 && n % superblock_words != 0) {
+      _blocks[block_index(n / block_words)] =
+          static_cast<uint16_t>(total - super_total);
+    }
+
+    _superblocks.resize(n / superblock_words + 1);
+    _superblocks.shrink_to_fit();
+
+    // Sample the superblocks that hold every nth set and unset bit
+    const auto num_superblocks = _superblocks.size();
+
+    for (size_t sb = 0; sb < num_superblocks; sb++) {
+      while (_select1_samples.size() * select_sample_rate <
+                 std::min(superblock_ones_end(sb), _num_set)) {
+        _select1_samples.push_back(sb);
+      }
+
+      while (_select0_samples.size() * select_sample_rate <
+                 std::min(superblock_zeros_end(sb), count_clear())) {
+        _select0_samples.push_back(sb);
+      }
+    }
+
+    _select1_samples.push_back(num_superblocks - 1);
+    _select0_samples.push_back(num_superblocks - 1);
+  }
+
+  /// Returns the view that the index was built from
+  [[nodiscard]] const bitmap_view& view() const noexcept { return _view; }
+
+  /// Returns the number of set bits in the bitmap
+  [[nodiscard]] uint64_t count_set() const noexcept { return _num_set; }
+
+  /// Returns the number of unset bits in the bitmap
+  [[nodiscard]] uint64_t count_clear() const noexcept {
+    return _view.count() - _num_set;
+  }
+
+  /// Returns the number of set bits in [0, n).  `n` must not be larger than
+  /// the number of bits in the bitmap.
+  [[nodiscard]] uint64_t rank1(uint64_t n) const noexcept {
+    const auto w = n / word_bits;
+    const auto b = w / block_words;
+
+    auto r = _superblocks[w / superblock_words] + block_ones(b);
+
+    for (auto i = b * block_words; i < w; i++) {
+      r += static_cast<uint64_t>(popcount(word(i)));
+    }
+
+    if (const auto bits = n % word_bits; bits != 0) {
+      r += static_cast<uint64_t>(
+          popcount(word(w) & detail::word_mask(0, bits)));
+    }
+
+    return r;
+  }
+
+  /// Returns the number of unset bits in [0, n).  `n` must not be larger than
+  /// the number of bits in the bitmap.
+  [[nodiscard]] uint64_t rank0(uint64_t n) const noexcept {
+    return n - rank1(n);
+  }
+
+  /// Returns the index of the `k`th (0-based) set bit, or `no_bits_left` if
+  /// there are not enough set bits.
+  [[nodiscard]] uint64_t select1(uint64_t k) const noexcept {
+    if (k >= _num_set) {
+      return no_bits_left;
+    }
+
+    return select<true>(k);
+  }
+
+  /// Returns the index of the `k`th (0-based) unset bit, or `no_bits_left` if
+  /// there are not enough unset bits.
+  [[nodiscard]] uint64_t select0(uint64_t k) const noexcept {
+    if (k >= count_clear()) {
+      return no_bits_left;
+    }
+
+    return select<false>(k);
+  }
+
+ private:
+  /// Returns the number of words in the bitmap
+  [[nodiscard]] size_t num_words() const noexcept {
+    return static_cast<size_t>((_view.count() + word_bits - 1) / word_bits);
+  }
+
+  /// Returns the number of blocks in the index, including a sentinel
+  [[nodiscard]] size_t num_blocks() const noexcept {
+    return num_words() / block_words + 1;
+  }
+
+  /// Returns the position in `_blocks` of a block that isn't the first block
+  /// of its superblock.  The first blocks always have a relative count of 0,
+  /// so they aren't stored.
+  [[nodiscard]] static size_t block_index(size_t b) noexcept {
+    return b / superblock_blocks * (superblock_blocks - 1) +
+           b % superblock_blocks - 1;
+  }
+
+  /// Returns the number of set bits before a block, relative to the start of
+  /// its superblock
+  [[nodiscard]] uint64_t block_ones(size_t b) const noexcept {
+    return (b % superblock_blocks == 0) ? 0 : _blocks[block_index(b)];
+  }
+
+  /// Returns a word of the bitmap with any bits beyond its end cleared
+  [[nodiscard]] uint64_t word(size_t i) const noexcept {
+    if (i + 1 == num_words()) {
+      if (const auto bits = _view.count() % word_bits; bits != 0) {
+        return _view.word(i) & detail::word_mask(0, bits);
+      }
+    }
+
+    return _view.word(i);
+  }
+
+  /// Returns the number of set bits before the end of a superblock
+  [[nodiscard]] uint64_t superblock_ones_end(size_t sb) const noexcept {
+    return (sb + 1 < _superblocks.size()) ? _superblocks[sb + 1] : _num_set;
+  }
+
+  /// Returns the number of unset bits before the end of a superblock
+  [[nodiscard]] uint64_t superblock_zeros_end(size_t sb) const noexcept {
+    const auto bits = std::min((sb + 1) * superblock_bits, _view.count());
+    return bits - superblock_ones_end(sb);
+  }
+
+  /// Returns the number of matching bits before the start of a superblock
+  template <bool Set>
+  [[nodiscard]] uint64_t superblock_rank(size_t sb) const noexcept {
+    if constexpr (Set) {
+      return _superblocks[sb];
+    } else {
+      return sb * superblock_bits - _superblocks[sb];
+    }
+  }
+
+  /// Returns the number of matching bits before the start of a block, relative
+  /// to the start of its superblock
+  template <bool Set>
+  [[nodiscard]] uint64_t block_rank(size_t b) const noexcept {
+    if constexpr (Set) {
+      return block_ones(b);
+    } else {
+      return (b % superblock_blocks) * block_bits - block_ones(b);
+    }
+  }
+
+  /// Finds the `k`th matching bit, which is known to exist
+  template <bool Set>
+  [[nodiscard]] uint64_t select(uint64_t k) const noexcept {
+    const auto& samples = Set ? _select1_samples : _select0_samples;
+
+    // Binary search for the last superblock that starts at or before the bit,
+    // within the range given by the samples
+    const auto s = k / select_sample_rate;
+    auto lo = samples[s];
+    auto hi = samples[s + 1] + 1;
+
+    while (hi - lo > 1) {
+      const auto mid = lo + (hi - lo) / 2;
+
+      if (superblock_rank<Set>(mid) <= k) {
+        lo = mid;
+      } else {
+        hi = mid;
+      }
+    }
+
+    k -= superblock_rank<Set>(lo);
+
+    // Find the block within the superblock
+    auto b = lo * superblock_blocks;
+    const auto last_block =
+        std::min(b + superblock_blocks, static_cast<uint64_t>(num_blocks()));
+
+    while (b + 1 < last_block && block_rank<Set>(b + 1) <= k) {
+      b++;
+    }
+
+    k -= block_rank<Set>(b);
+
+    // Find the word within the block
+    for (auto w = b * block_words;; w++) {
+      const auto bits = Set ? word(w) : ~word(w);
+      const auto c = static_cast<uint64_t>(popcount(bits));
+
+      if (k < c) {
+        return w * word_bits + detail::select_in_word(bits, k);
+      }
+
+      k -= c;
+    }
+  }
+
+  bitmap_view _view;                     ///< The indexed bitmap
+  std::vector<uint64_t> _superblocks{};  ///< Set bits before each superblock
+  std::vector<uint16_t> _blocks{};       ///< Set bits before most blocks
+  std::vector<uint64_t> _select1_samples{};  ///< Superblock of every nth set bit
+  std::vector<uint64_t> _select0_samples{};  ///< Superblock of every nth unset
+  uint64_t _num_set{};                       ///< Total number of set bits
+};
+
+}  // namespace yat
@@ -0,0 +1,1722 @@
+/*
+ * Copyright 2020 Joe T. Sylve, Ph.D.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#include "bit.hpp"
+#include "endian.hpp"
+#include "features.hpp"
+
+// The vectorized kernels are only built for x86-64, where SSE2 is part of the
+// baseline ISA and wider instruction sets can be selected at runtime.
+#if !defined(YAT_DISABLE_SIMD) && (defined(__x86_64__) || defined(_M_X64)) && \
+    (defined(YAT_IS_GCC_COMPATIBLE) || defined(YAT_IS_MSVC))
+#define YAT_INTERNAL_HAS_X86_SIMD
+#endif
+
+#ifdef YAT_INTERNAL_HAS_X86_SIMD
+#include <immintrin.h>
+
+#ifdef YAT_IS_MSVC
+#include <intrin.h>
+#endif
+#endif  // YAT_INTERNAL_HAS_X86_SIMD
+
+// gcc and clang require that functions using intrinsics beyond the baseline ISA
+// be explicitly marked with their target.  MSVC allows them anywhere.
+#if defined(YAT_INTERNAL_HAS_X86_SIMD) && defined(YAT_IS_GCC_COMPATIBLE)
+#define YAT_INTERNAL_TARGET(isa) [[gnu::target(isa)]]
+#else
+#define YAT_INTERNAL_TARGET(isa)
+#endif
+
+namespace yat {
+
+/// Bitwise operations that can be applied between bitmaps
+enum class bitwise_op {
+  bit_and,      ///< lhs & rhs
+  bit_or,       ///< lhs | rhs
+  bit_xor,      ///< lhs ^ rhs
+  bit_and_not,  ///< lhs & ~rhs
+};
+
+/// Comparisons that can be made between values and a constant
+enum class compare_op {
+  equal,          ///< lhs == rhs
+  not_equal,      ///< lhs != rhs
+  less,           ///< lhs < rhs
+  less_equal,     ///< lhs <= rhs
+  greater,        ///< lhs > rhs
+  greater_equal,  ///< lhs >= rhs
+};
+
+}  // namespace yat
+
+namespace yat::detail {
+
+/// Applies a bitwise operation to a pair of words
+[[nodiscard]] constexpr uint64_t apply_bitwise_op(bitwise_op op, uint64_t lhs,
+                                                  uint64_t rhs) noexcept {
+  switch (op) {
+    case bitwise_op::bit_and:
+      return lhs & rhs;
+    case bitwise_op::bit_or:
+      return lhs | rhs;
+    case bitwise_op::bit_xor:
+      return lhs ^ rhs;
+    case bitwise_op::bit_and_not:
+      return lhs & ~rhs;
+  }
+
+  YAT_UNREACHABLE();
+}
+
+/// Applies a comparison to a pair of values
+template <typename T>
+[[nodiscard]] constexpr bool compare_values(compare_op op, const T& lhs,
+                                            const T& rhs) {
+  switch (op) {
+    case compare_op::equal:
+      return lhs == rhs;
+    case compare_op::not_equal:
+      return lhs != rhs;
+    case compare_op::less:
+      return lhs < rhs;
+    case compare_op::less_equal:
+      return lhs <= rhs;
+    case compare_op::greater:
+      return lhs > rhs;
+    case compare_op::greater_equal:
+      return lhs >= rhs;
+  }
+
+  YAT_UNREACHABLE();
+}
+
+/// Indicates that values of type `T` can be compared by the vectorized
+/// kernels
+template <typename T>
+inline constexpr bool is_simd_comparable_v =
+    (std::is_integral_v<T> && !std::is_same_v<T, bool> && sizeof(T) <= 8) ||
+    std::is_same_v<T, float> || std::is_same_v<T, double>;
+
+/// The instruction sets that the bitmap kernels are specialized for, in order
+/// of preference
+enum class simd_isa {
+  scalar,  ///< Portable C++ implementation
+  sse2,    ///< x86-64 baseline (128-bit vectors)
+  avx2,    ///< 256-bit vectors
+  avx512,  ///< 512-bit vectors (requires AVX-512F and AVX-512BW)
+};
+
+/// Queries the CPU for the best instruction set that the kernels support
+[[nodiscard]] inline simd_isa detect_simd_isa() noexcept {
+#if !defined(YAT_INTERNAL_HAS_X86_SIMD)
+  return simd_isa::scalar;
+#elif defined(YAT_IS_MSVC)
+  int info[4]{};
+
+  __cpuid(info, 0);
+  const int max_leaf = info[0];
+
+  __cpuidex(info, 1, 0);
+  const bool has_osxsave = (info[2] & (1 << 27)) != 0;
+  const bool has_avx = (info[2] & (1 << 28)) != 0;
+
+  if (max_leaf < 7 || !has_osxsave || !has_avx) {
+    return simd_isa::sse2;
+  }
+
+  // Make sure that the OS saves the vector registers on context switches
+  const auto xcr0 = _xgetbv(0);
+  const bool has_ymm_state = (xcr0 & 0x06) == 0x06;
+  const bool has_zmm_state = (xcr0 & 0xE6) == 0xE6;
+
+  __cpuidex(info, 7, 0);
+  const bool has_avx2 = (info[1] & (1 << 5)) != 0;
+  const bool has_avx512f = (info[1] & (1 << 16)) != 0;
+  const bool has_avx512bw = (info[1] & (1 << 30)) != 0;
+
+  if (has_zmm_state && has_avx512f && has_avx512bw) {
+    return simd_isa::avx512;
+  }
+
+  if (has_ymm_state && has_avx2) {
+    return simd_isa::avx2;
+  }
+
+  return simd_isa::sse2;
+#else
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+    return simd_isa::avx512;
+  }
+
+  if (__builtin_cpu_supports("avx2")) {
+    return simd_isa::avx2;
+  }
+
+  return simd_isa::sse2;
+#endif
+}
+
+/// Returns true if the running CPU can execute kernels built for `isa`
+[[nodiscard]] inline bool simd_isa_supported(simd_isa isa) noexcept {
+  return isa <= detect_simd_isa();
+}
+
+/// Returns the best instruction set supported by the running CPU.  Detection
+/// only happens once.
+[[nodiscard]] inline simd_isa active_simd_isa() noexcept {
+  static const simd_isa isa = detect_simd_isa();
+  return isa;
+}
+
+/////////////////////
+// Scalar kernels  //
+/////////////////////
+
+//
+// The words that are read by the kernels don't need to be aligned.  The vector
+// kernels use unaligned loads and the scalar kernels read through memcpy,
+// which compiles to a plain load.
+//
+
+/// Reads a word that might not be aligned
+[[nodiscard]] inline uint64_t load_word(const little_uint64_t* p) noexcept {
+  little_uint64_t w{};
+  std::memcpy(static_cast<void*>(&w), p, sizeof(w));
+  return w;
+}
+
+/// Returns the index of the first word in [first, last) that is not equal to
+/// `pattern`, or `last` if there are none.
+[[nodiscard]] inline size_t find_word_not_equal_scalar(
+    const little_uint64_t* words, size_t first, size_t last,
+    uint64_t pattern) noexcept {
+  for (; first < last; ++first) {
+    if (load_word(words + first) != pattern) {
+      return first;
+    }
+  }
+
+  return last;
+}
+
+/// Returns the index of the last word in [first, last) that is not equal to
+/// `pattern`, or `last` if there are none.
+[[nodiscard]] inline size_t find_last_word_not_equal_scalar(
+    const little_uint64_t* words, size_t first, size_t last,
+    uint64_t pattern) noexcept {
+  for (auto i = last; i > first; --i) {
+    if (load_word(words + i - 1) != pattern) {
+      return i - 1;
+    }
+  }
+
+  return last;
+}
+
+/// Applies `dst[i] = dst[i] op src[i]` to `n` words
+template <bitwise_op Op>
+inline void bitwise_scalar_impl(little_uint64_t* dst, const little_uint64_t* src,
+                                size_t n) noexcept {
+  for (size_t i = 0; i < n; ++i) {
+    dst[i] = apply_bitwise_op(Op, dst[i], load_word(src + i));
+  }
+}
+
+/// Returns the index of the first word in [first, last) where `lhs[i] op
+/// rhs[i]` is not equal to `pattern`, or `last` if there are none.
+template <bitwise_op Op>
+[[nodiscard]] inline size_t find_op_word_not_equal_scalar_impl(
+    const little_uint64_t* lhs, const little_uint64_t* rhs, size_t first,
+    size_t last, uint64_t pattern) noexcept {
+  for (; first < last; ++first) {
+    if (apply_bitwise_op(Op, load_word(lhs + first), load_word(rhs + first)) !=
+        pattern) {
+      return first;
+    }
+  }
+
+  return last;
+}
+
+/// Returns the number of set bits in the words [first, last)
+[[nodiscard]] inline uint64_t popcount_scalar(const little_uint64_t* words,
+                                              size_t first,
+                                              size_t last) noexcept {
+  uint64_t total = 0;
+
+  for (; first < last; ++first) {
+    total += static_cast<uint64_t>(popcount(load_word(words + first)));
+  }
+
+  return total;
+}
+
+/// Writes the index of every set bit of the words [first, last), after they
+/// are XORed with `flip`, to `out`.  Stops before the first word whose bits
+/// don't all fit in the `capacity` entries that are left, and leaves `first`
+/// at that word.  Returns the number of indices that were written.  Entries of
+/// `out` past that number may be overwritten.
+template <typename T>
+[[nodiscard]] inline size_t flatten_scalar(const little_uint64_t* words,
+                                           size_t& first, size_t last,
+                                           uint64_t flip, T* out,
+                                           size_t capacity) noexcept {
+  size_t n = 0;
+
+  for (; first < last; ++first) {
+    uint64_t bits = load_word(words + first) ^ flip;
+    const auto c = static_cast<size_t>(popcount(bits));
+
+    if (c > capacity - n) {
+      break;
+    }
+
+    const auto base = static_cast<T>(first * 64);
+    T* p = out + n;
+
+    if (capacity - n >= ((c + 3) & ~size_t{3})) {
+      // Decode four bits per iteration without checking for the end of the
+      // word.  Once the bits run out the extra entries hold junk, which is
+      // either overwritten by the next word or past the returned count.
+      for (size_t i = 0; i < c; i += 4) {
+        p[i] = base + static_cast<T>(countr_zero(bits));
+        bits &= bits - 1;
+        p[i + 1] = base + static_cast<T>(countr_zero(bits));
+        bits &= bits - 1;
+        p[i + 2] = base + static_cast<T>(countr_zero(bits));
+        bits &= bits - 1;
+        p[i + 3] = base + static_cast<T>(countr_zero(bits));
+        bits &= bits - 1;
+      }
+    } else {
+      for (; bits != 0; bits &= bits - 1) {
+        *p++ = base + static_cast<T>(countr_zero(bits));
+      }
+    }
+
+    n += c;
+  }
+
+  return n;
+}
+
+/// Packs `pred(values[i])` for up to 64 values into the bits of a word,
+/// starting with the least significant bit
+template <typename T, typename Pred>
+[[nodiscard]] inline uint64_t pack_word(const T* values, size_t n,
+                                        Pred&& pred) {
+  uint64_t bits = 0;
+
+  for (size_t i = 0; i < n; ++i) {
+    const bool match = pred(values[i]);
+    bits |= static_cast<uint64_t>(match) << i;
+  }
+
+  return bits;
+}
+
+/// Packs `pred(values[i])` for `num_words` words of 64 values into `out`
+template <typename T, typename Pred>
+inline void pack_words(const T* values, size_t num_words, Pred&& pred,
+                       little_uint64_t* out) {
+  for (size_t w = 0; w < num_words; ++w) {
+    out[w] = pack_word(values + w * 64, 64, pred);
+  }
+}
+
+/// Packs `values[i] op value` for `num_words` words of 64 values into `out`
+template <typename T, compare_op Op>
+inline void compare_words_scalar_impl(const T* values, size_t num_words,
+                                      const T& value, little_uint64_t* out) {
+  pack_words(
+      values, num_words,
+      [&value](const T& v) { return compare_values(Op, v, value); }, out);
+}
+
+/// Copies `in[i]` for each set bit `i` of `bits` to the front of `out`, in
+/// order, and returns the number of values that were copied.  `in` must hold
+/// 64 values.  The vectorized versions may write up to 64 entries of `out`.
+template <typename T>
+inline size_t compact_word_scalar(uint64_t bits, const T* in, T* out) {
+  size_t n = 0;
+
+  for (; bits != 0; bits &= bits - 1) {
+    out[n++] = in[countr_zero(bits)];
+  }
+
+  return n;
+}
+
+//
+// The kernel tables hold plain function pointers, so each kernel that is
+// specialized on the operation gets a wrapper that selects the specialization
+// at runtime.
+//
+
+#define YAT_INTERNAL_BITWISE_OP_DISPATCH(name, ...)                    \
+  switch (op) {                                                       \
+    case bitwise_op::bit_and:                                         \
+      return name<bitwise_op::bit_and>(__VA_ARGS__);                  \
+    case bitwise_op::bit_or:                                          \
+      return name<bitwise_op::bit_or>(__VA_ARGS__);                   \
+    case bitwise_op::bit_xor:                                         \
+      return name<bitwise_op::bit_xor>(__VA_ARGS__);                  \
+    case bitwise_op::bit_and_not:                                     \
+      return name<bitwise_op::bit_and_not>(__VA_ARGS__);              \
+  }                                                                   \
+  YAT_UNREACHABLE();
+
+#define YAT_INTERNAL_COMPARE_OP_DISPATCH(name, ...)                 \
+  switch (op) {                                                    \
+    case compare_op::equal:                                        \
+      return name<T, compare_op::equal>(__VA_ARGS__);              \
+    case compare_op::not_equal:                                    \
+      return name<T, compare_op::not_equal>(__VA_ARGS__);          \
+    case compare_op::less:                                         \
+      return name<T, compare_op::less>(__VA_ARGS__);               \
+    case compare_op::less_equal:                                   \
+      return name<T, compare_op::less_equal>(__VA_ARGS__);         \
+    case compare_op::greater:                                      \
+      return name<T, compare_op::greater>(__VA_ARGS__);            \
+    case compare_op::greater_equal:                                \
+      return name<T, compare_op::greater_equal>(__VA_ARGS__);      \
+  }                                                                \
+  YAT_UNREACHABLE();
+
+/// Applies `dst[i] = dst[i] op src[i]` to `n` words
+inline void bitwise_scalar(little_uint64_t* dst, const little_uint64_t* src,
+                           size_t n, bitwise_op op) noexcept {
+  YAT_INTERNAL_BITWISE_OP_DISPATCH(bitwise_scalar_impl, dst, src, n)
+}
+
+/// Returns the index of the first word in [first, last) where `lhs[i] op
+/// rhs[i]` is not equal to `pattern`, or `last` if there are none.
+[[nodiscard]] inline size_t find_op_word_not_equal_scalar(
+    const little_uint64_t* lhs, const little_uint64_t* rhs, bitwise_op op,
+    size_t first, size_t last, uint64_t pattern) noexcept {
+  YAT_INTERNAL_BITWISE_OP_DISPATCH(find_op_word_not_equal_scalar_impl, lhs, rhs,
+                                   first, last, pattern)
+}
+
+#ifdef YAT_INTERNAL_HAS_X86_SIMD
+
+//
+// The x86 kernels load the little endian storage words directly.  This is
+// safe because every x86 target is little endian.
+//
+
+/// Returns true if a compare_op is computed as the inverse of a simpler
+/// integer comparison (see compare_lanes_avx2)
+[[nodiscard]] constexpr bool compare_inverts(compare_op op) noexcept {
+  return op == compare_op::not_equal || op == compare_op::less_equal ||
+         op == compare_op::greater_equal;
+}
+
+/// Returns the AVX predicate for a floating point comparison.  Like the C++
+/// operators, only not_equal is true when either value is NaN.
+[[nodiscard]] constexpr int float_compare_predicate(compare_op op) noexcept {
+  switch (op) {
+    case compare_op::equal:
+      return _CMP_EQ_OQ;
+    case compare_op::not_equal:
+      return _CMP_NEQ_UQ;
+    case compare_op::less:
+      return _CMP_LT_OQ;
+    case compare_op::less_equal:
+      return _CMP_LE_OQ;
+    case compare_op::greater:
+      return _CMP_GT_OQ;
+    case compare_op::greater_equal:
+      return _CMP_GE_OQ;
+  }
+
+  YAT_UNREACHABLE();
+}
+
+/////////////////////
+//  SSE2 kernels   //
+/////////////////////
+
+/// SSE2 implementation of find_word_not_equal_scalar
+[[nodiscard]] inline size_t find_word_not_equal_sse2(
+    const little_uint64_t* words, size_t first, size_t last,
+    uint64_t pattern) noexcept {
+  const __m128i pat = _mm_set1_epi64x(static_cast<long long>(pattern));
+
+  // Returns a 16 bit mask with a bit set for every byte that differs
+  const auto diff_mask = [&](size_t i) {
+    const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i));
+    return static_cast<unsigned>(~_mm_movemask_epi8(_mm_cmpeq_epi32(v, pat))) &
+           0xFFFFU;
+  };
+
+  // Skip 512 bits at a time while everything matches
+  for (; first + 8 <= last; first += 8) {
+    const auto* p = reinterpret_cast<const __m128i*>(words + first);
+    const __m128i acc = _mm_or_si128(
+        _mm_or_si128(_mm_xor_si128(_mm_loadu_si128(p), pat),
+                     _mm_xor_si128(_mm_loadu_si128(p + 1), pat)),
+        _mm_or_si128(_mm_xor_si128(_mm_loadu_si128(p + 2), pat),
+                     _mm_xor_si128(_mm_loadu_si128(p + 3), pat)));
+
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(acc, _mm_setzero_si128())) !=
+        0xFFFF) {
+      break;
+    }
+  }
+
+  for (; first + 2 <= last; first += 2) {
+    if (const auto m = diff_mask(first); m != 0) {
+      return first + static_cast<size_t>(countr_zero(m)) / 8;
+    }
+  }
+
+  return find_word_not_equal_scalar(words, first, last, pattern);
+}
+
+/// SSE2 implementation of find_last_word_not_equal_scalar
+[[nodiscard]] inline size_t find_last_word_not_equal_sse2(
+    const little_uint64_t* words, size_t first, size_t last,
+    uint64_t pattern) noexcept {
+  const __m128i pat = _mm_set1_epi64x(static_cast<long long>(pattern));
+  auto i = last;
+
+  // Skip 512 bits at a time while everything matches
+  for (; i >= first + 8; i -= 8) {
+    const auto* p = reinterpret_cast<const __m128i*>(words + i - 8);
+    const __m128i acc = _mm_or_si128(
+        _mm_or_si128(_mm_xor_si128(_mm_loadu_si128(p), pat),
+                     _mm_xor_si128(_mm_loadu_si128(p + 1), pat)),
+        _mm_or_si128(_mm_xor_si128(_mm_loadu_si128(p + 2), pat),
+                     _mm_xor_si128(_mm_loadu_si128(p + 3), pat)));
+
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(acc, _mm_setzero_si128())) !=
+        0xFFFF) {
+      break;
+    }
+  }
+
+  for (; i >= first + 2; i -= 2) {
+    const auto v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i - 2));
+    const auto m = static_cast<unsigned>(
+                       ~_mm_movemask_epi8(_mm_cmpeq_epi32(v, pat))) &
+                   0xFFFFU;
+
+    if (m != 0) {
+      return i - 2 + static_cast<size_t>(31 - countl_zero(m)) / 8;
+    }
+  }
+
+  const auto r = find_last_word_not_equal_scalar(words, first, i, pattern);
+  return (r == i) ? last : r;
+}
+
+/// Applies a bitwise operation to a pair of vectors
+template <bitwise_op Op>
+[[nodiscard]] inline __m128i apply_bitwise_op_sse2(__m128i lhs,
+                                                   __m128i rhs) noexcept {
+  if constexpr (Op == bitwise_op::bit_and) {
+    return _mm_and_si128(lhs, rhs);
+  } else if constexpr (Op == bitwise_op::bit_or) {
+    return _mm_or_si128(lhs, rhs);
+  } else if constexpr (Op == bitwise_op::bit_xor) {
+    return _mm_xor_si128(lhs, rhs);
+  } else {
+    return _mm_andnot_si128(rhs, lhs);
+  }
+}
+
+/// SSE2 implementation of bitwise_scalar_impl
+template <bitwise_op Op>
+inline void bitwise_sse2_impl(little_uint64_t* dst, const little_uint64_t* src,
+                              size_t n) noexcept {
+  size_t i = 0;
+
+  for (; i + 2 <= n; i += 2) {
+    auto* d = reinterpret_cast<__m128i*>(dst + i);
+    const auto v = apply_bitwise_op_sse2<Op>(
+        _mm_loadu_si128(d),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+    _mm_storeu_si128(d, v);
+  }
+
+  bitwise_scalar_impl<Op>(dst + i, src + i, n - i);
+}
+
+/// SSE2 implementation of find_op_word_not_equal_scalar_impl
+template <bitwise_op Op>
+[[nodiscard]] inline size_t find_op_word_not_equal_sse2_impl(
+    const little_uint64_t* lhs, const little_uint64_t* rhs, size_t first,
+    size_t last, uint64_t pattern) noexcept {
+  const __m128i pat = _mm_set1_epi64x(static_cast<long long>(pattern));
+
+  const auto load = [&](size_t i) {
+    return apply_bitwise_op_sse2<Op>(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs + i)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs + i)));
+  };
+
+  for (; first + 2 <= last; first += 2) {
+    const auto m = static_cast<unsigned>(~_mm_movemask_epi8(
+                       _mm_cmpeq_epi32(load(first), pat))) &
+                   0xFFFFU;
+
+    if (m != 0) {
+      return first + static_cast<size_t>(countr_zero(m)) / 8;
+    }
+  }
+
+  return find_op_word_not_equal_scalar_impl<Op>(lhs, rhs, first, last,
+                                                pattern);
+}
+
+/// SSE2 implementation of bitwise_scalar
+inline void bitwise_sse2(little_uint64_t* dst, const little_uint64_t* src,
+                         size_t n, bitwise_op op) noexcept {
+  YAT_INTERNAL_BITWISE_OP_DISPATCH(bitwise_sse2_impl, dst, src, n)
+}
+
+/// SSE2 implementation of find_op_word_not_equal_scalar
+[[nodiscard]] inline size_t find_op_word_not_equal_sse2(
+    const little_uint64_t* lhs, const little_uint64_t* rhs, bitwise_op op,
+    size_t first, size_t last, uint64_t pattern) noexcept {
+  YAT_INTERNAL_BITWISE_OP_DISPATCH(find_op_word_not_equal_sse2_impl, lhs, rhs,
+                                   first, last, pattern)
+}
+
+/// SSE2 implementation of popcount_scalar.  SSE2 has no population count
+/// instruction, so this counts the bits of two words at a time with the usual
+/// shift-and-mask reduction and sums the bytes with psadbw.
+[[nodiscard]] inline uint64_t popcount_sse2(const little_uint64_t* words,
+                                            size_t first,
+                                            size_t last) noexcept {
+  const __m128i m1 = _mm_set1_epi8(0x55);
+  const __m128i m2 = _mm_set1_epi8(0x33);
+  const __m128i m4 = _mm_set1_epi8(0x0F);
+  __m128i acc = _mm_setzero_si128();
+
+  for (; first + 2 <= last; first += 2) {
+    __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + first));
+    v = _mm_sub_epi8(v, _mm_and_si128(_mm_srli_epi16(v, 1), m1));
+    v = _mm_add_epi8(_mm_and_si128(v, m2),
+                     _mm_and_si128(_mm_srli_epi16(v, 2), m2));
+    v = _mm_and_si128(_mm_add_epi8(v, _mm_srli_epi16(v, 4)), m4);
+    acc = _mm_add_epi64(acc, _mm_sad_epu8(v, _mm_setzero_si128()));
+  }
+
+  const auto total =
+      static_cast<uint64_t>(_mm_cvtsi128_si64(acc)) +
+      static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(acc, acc)));
+
+  return total + popcount_scalar(words, first, last);
+}
+
+/////////////////////
+//  AVX2 kernels   //
+/////////////////////
+
+/// AVX2 implementation of find_word_not_equal_scalar
+YAT_INTERNAL_TARGET("avx2")
+[[nodiscard]] inline size_t find_word_not_equal_avx2(
+    const little_uint64_t* words, size_t first, size_t last,
+    uint64_t pattern) noexcept {
+  const __m256i pat = _mm256_set1_epi64x(static_cast<long long>(pattern));
+
+  // Skip 1024 bits at a time while everything matches
+  for (; first + 16 <= last; first += 16) {
+    const auto* p = reinterpret_cast<const __m256i*>(words + first);
+    const __m256i acc = _mm256_or_si256(
+        _mm256_or_si256(_mm256_xor_si256(_mm256_loadu_si256(p), pat),
+                        _mm256_xor_si256(_mm256_loadu_si256(p + 1), pat)),
+        _mm256_or_si256(_mm256_xor_si256(_mm256_loadu_si256(p + 2), pat),
+                        _mm256_xor_si256(_mm256_loadu_si256(p + 3), pat)));
+
+    if (_mm256_testz_si256(acc, acc) == 0) {
+      break;
+    }
+  }
+
+  for (; first + 4 <= last; first += 4) {
+    const auto v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + first));
+    const auto eq =
+        static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi64(v, pat)));
+
+    if (eq != 0xFFFF'FFFFU) {
+      return first + static_cast<size_t>(countr_zero(~eq)) / 8;
+    }
+  }
+
+  return find_word_not_equal_scalar(words, first, last, pattern);
+}
+
+/// AVX2 implementation of find_last_word_not_equal_scalar
+YAT_INTERNAL_TARGET("avx2")
+[[nodiscard]] inline size_t find_last_word_not_equal_avx2(
+    const little_uint64_t* words, size_t first, size_t last,
+    uint64_t pattern) noexcept {
+  const __m256i pat = _mm256_set1_epi64x(static_cast<long long>(pattern));
+  auto i = last;
+
+  // Skip 1024 bits at a time while everything matches
+  for (; i >= first + 16; i -= 16) {
+    const auto* p = reinterpret_cast<const __m256i*>(words + i - 16);
+    const __m256i acc = _mm256_or_si256(
+        _mm256_or_si256(_mm256_xor_si256(_mm256_loadu_si256(p), pat),
+                        _mm256_xor_si256(_mm256_loadu_si256(p + 1), pat)),
+        _mm256_or_si256(_mm256_xor_si256(_mm256_loadu_si256(p + 2), pat),
+                        _mm256_xor_si256(_mm256_loadu_si256(p + 3), pat)));
+
+    if (_mm256_testz_si256(acc, acc) == 0) {
+      break;
+    }
+  }
+
+  for (; i >= first + 4; i -= 4) {
+    const auto v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i - 4));
+    const auto eq =
+        static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi64(v, pat)));
+
+    if (eq != 0xFFFF'FFFFU) {
+      return i - 4 + static_cast<size_t>(31 - countl_zero(~eq)) / 8;
+    }
+  }
+
+  const auto r = find_last_word_not_equal_scalar(words, first, i, pattern);
+  return (r == i) ? last : r;
+}
+
+/// Applies a bitwise operation to a pair of vectors
+template <bitwise_op Op>
+YAT_INTERNAL_TARGET("avx2")
+[[nodiscard]] inline __m256i
+    apply_bitwise_op_avx2(__m256i lhs, __m256i rhs) noexcept {
+  if constexpr (Op == bitwise_op::bit_and) {
+    return _mm256_and_si256(lhs, rhs);
+  } else if constexpr (Op == bitwise_op::bit_or) {
+    return _mm256_or_si256(lhs, rhs);
+  } else if constexpr (Op == bitwise_op::bit_xor) {
+    return _mm256_xor_si256(lhs, rhs);
+  } else {
+    return _mm256_andnot_si256(rhs, lhs);
+  }
+}
+
+/// AVX2 implementation of bitwise_scalar_impl
+template <bitwise_op Op>
+YAT_INTERNAL_TARGET("avx2")
+inline void bitwise_avx2_impl(little_uint64_t* dst, const little_uint64_t* src,
+                              size_t n) noexcept {
+  size_t i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    auto* d = reinterpret_cast<__m256i*>(dst + i);
+    const auto v = apply_bitwise_op_avx2<Op>(
+        _mm256_loadu_si256(d),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)));
+    _mm256_storeu_si256(d, v);
+  }
+
+  bitwise_scalar_impl<Op>(dst + i, src + i, n - i);
+}
+
+/// AVX2 implementation of find_op_word_not_equal_scalar_impl
+template <bitwise_op Op>
+YAT_INTERNAL_TARGET("avx2")
+[[nodiscard]] inline size_t find_op_word_not_equal_avx2_impl(
+    const little_uint64_t* lhs, const little_uint64_t* rhs, size_t first,
+    size_t last, uint64_t pattern) noexcept {
+  const __m256i pat = _mm256_set1_epi64x(static_cast<long long>(pattern));
+
+  for (; first + 4 <= last; first += 4) {
+    const auto v = apply_bitwise_op_avx2<Op>(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lhs + first)),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rhs + first)));
+    const auto eq =
+        static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi64(v, pat)));
+
+    if (eq != 0xFFFF'FFFFU) {
+      return first + static_cast<size_t>(countr_zero(~eq)) / 8;
+    }
+  }
+
+  return find_op_word_not_equal_scalar_impl<Op>(lhs, rhs, first, last,
+                                                pattern);
+}
+
+/// AVX2 implementation of bitwise_scalar
+YAT_INTERNAL_TARGET("avx2")
+inline void bitwise_avx2(little_uint64_t* dst, const little_uint64_t* src,
+                         size_t n, bitwise_op op) noexcept {
+  YAT_INTERNAL_BITWISE_OP_DISPATCH(bitwise_avx2_impl, dst, src, n)
+}
+
+/// AVX2 implementation of find_op_word_not_equal_scalar
+YAT_INTERNAL_TARGET("avx2")
+[[nodiscard]] inline size_t find_op_word_not_equal_avx2(
+    const little_uint64_t* lhs, const little_uint64_t* rhs, bitwise_op op,
+    size_t first, size_t last, uint64_t pattern) noexcept {
+  YAT_INTERNAL_BITWISE_OP_DISPATCH(find_op_word_not_equal_avx2_impl, lhs, rhs,
+                                   first, last, pattern)
+}
+
+/// Returns the number of set bits in each 64-bit lane of a vector, using a
+/// nibble lookup table
+YAT_INTERNAL_TARGET("avx2")
+[[nodiscard]] inline __m256i popcount_lanes_avx2(__m256i v) noexcept {
+  const __m256i lookup =
+      _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,  //
+                       0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0F);
+
+  const __m256i lo = _mm256_and_si256(v, low_mask);
+  const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+  const __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                                         _mm256_shuffle_epi8(lookup, hi));
+
+  return _mm256_sad_epu8(counts, _mm256_setzero_si256());
+}
+
+/// A carry-save adder that adds three vectors bit by bit, producing the high
+/// (carry) and low (sum) bits of each result
+YAT_INTERNAL_TARGET("avx2")
+inline void carry_save_add_avx2(__m256i& high, __m256i& low, __m256i a,
+                                __m256i b, __m256i c) noexcept {
+  const __m256i u = _mm256_xor_si256(a, b);
+  high = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(u, c));
+  low = _mm256_xor_si256(u, c);
+}
+
+/// AVX2 implementation of popcount_scalar.
+///
+/// This uses the Harley-Seal algorithm, which feeds 16 vectors at a time
+/// through a tree of carry-save adders so that only one vector in every 16
+/// needs to have its bits counted.
+YAT_INTERNAL_TARGET("avx2")
+[[nodiscard]] inline uint64_t popcount_avx2(const little_uint64_t* words,
+                                            size_t first,
+                                            size_t last) noexcept {
+  __m256i total = _mm256_setzero_si256();
+  __m256i ones = _mm256_setzero_si256();
+  __m256i twos = _mm256_setzero_si256();
+  __m256i fours = _mm256_setzero_si256();
+  __m256i eights = _mm256_setzero_si256();
+  __m256i sixteens{};
+  __m256i twos_a{};
+  __m256i twos_b{};
+  __m256i fours_a{};
+  __m256i fours_b{};
+  __m256i eights_a{};
+  __m256i eights_b{};
+
+  for (; first + 64 <= last; first += 64) {
+    const auto* p = reinterpret_cast<const __m256i*>(words + first);
+
+    carry_save_add_avx2(twos_a, ones, ones, _mm256_loadu_si256(p),
+                        _mm256_loadu_si256(p + 1));
+    carry_save_add_avx2(twos_b, ones, ones, _mm256_loadu_si256(p + 2),
+                        _mm256_loadu_si256(p + 3));
+    carry_save_add_avx2(fours_a, twos, twos, twos_a, twos_b);
+    carry_save_add_avx2(twos_a, ones, ones, _mm256_loadu_si256(p + 4),
+                        _mm256_loadu_si256(p + 5));
+    carry_save_add_avx2(twos_b, ones, ones, _mm256_loadu_si256(p + 6),
+                        _mm256_loadu_si256(p + 7));
+    carry_save_add_avx2(fours_b, twos, twos, twos_a, twos_b);
+    carry_save_add_avx2(eights_a, fours, fours, fours_a, fours_b);
+    carry_save_add_avx2(twos_a, ones, ones, _mm256_loadu_si256(p + 8),
+                        _mm256_loadu_si256(p + 9));
+    carry_save_add_avx2(twos_b, ones, ones, _mm256_loadu_si256(p + 10),
+                        _mm256_loadu_si256(p + 11));
+    carry_save_add_avx2(fours_a, twos, twos, twos_a, twos_b);
+    carry_save_add_avx2(twos_a, ones, ones, _mm256_loadu_si256(p + 12),
+                        _mm256_loadu_si256(p + 13));
+    carry_save_add_avx2(twos_b, ones, ones, _mm256_loadu_si256(p + 14),
+                        _mm256_loadu_si256(p + 15));
+    carry_save_add_avx2(fours_b, twos, twos, twos_a, twos_b);
+    carry_save_add_avx2(eights_b, fours, fours, fours_a, fours_b);
+    carry_save_add_avx2(sixteens, eights, eights, eights_a, eights_b);
+
+    total = _mm256_add_epi64(total, popcount_lanes_avx2(sixteens));
+  }
+
+  total = _mm256_slli_epi64(total, 4);
+  total = _mm256_add_epi64(
+      total, _mm256_slli_epi64(popcount_lanes_avx2(eights), 3));
+  total =
+      _mm256_add_epi64(total, _mm256_slli_epi64(popcount_lanes_avx2(fours), 2));
+  total =
+      _mm256_add_epi64(total, _mm256_slli_epi64(popcount_lanes_avx2(twos), 1));
+  total = _mm256_add_epi64(total, popcount_lanes_avx2(ones));
+
+  // Count whole vectors that didn't make up a full block
+  for (; first + 4 <= last; first += 4) {
+    total = _mm256_add_epi64(
+        total, popcount_lanes_avx2(_mm256_loadu_si256(
+                   reinterpret_cast<const __m256i*>(words + first))));
+  }
+
+  const __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(total),
+                                    _mm256_extracti128_si256(total, 1));
+  const auto result =
+      static_cast<uint64_t>(_mm_cvtsi128_si64(sum)) +
+      static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(sum, sum)));
+
+  return result + popcount_scalar(words, first, last);
+}
+
+/// Returns a vector with every lane set to `value`
+template <typename T>
+YAT_INTERNAL_TARGET("avx2")
+[[nodiscard]] inline __m256i broadcast_avx2(T value) noexcept {
+  if constexpr (sizeof(T) == 1) {
+    return _mm256_set1_epi8(static_cast<char>(value));
+  } else if constexpr (sizeof(T) == 2) {
+    return _mm256_set1_epi16(static_cast<short>(value));
+  } else if constexpr (sizeof(T) == 4) {
+    return _mm256_set1_epi32(static_cast<int>(value));
+  } else {
+    return _mm256_set1_epi64x(static_cast<long long>(value));
+  }
+}
+
+/// Compares the signed integer lanes of two vectors for equality (or for
+/// `lhs > rhs` if `Greater`), setting every bit of the lanes that match
+template <size_t Size, bool Greater>
+YAT_INTERNAL_TARGET("avx2")
+[[nodiscard]] inline __m256i compare_signed_avx2(__m256i lhs,
+                                                 __m256i rhs) noexcept {
+  if constexpr (Size == 1) {
+    return Greater ? _mm256_cmpgt_epi8(lhs, rhs) : _mm256_cmpeq_epi8(lhs, rhs);
+  } else if constexpr (Size == 2) {
+    return Greater ? _mm256_cmpgt_epi16(lhs, rhs)
+                   : _mm256_cmpeq_epi16(lhs, rhs);
+  } else if constexpr (Size == 4) {
+    return Greater ? _mm256_cmpgt_epi32(lhs, rhs)
+                   : _mm256_cmpeq_epi32(lhs, rhs);
+  } else {
+    return Greater ? _mm256_cmpgt_epi64(lhs, rhs)
+                   : _mm256_cmpeq_epi64(lhs, rhs);
+  }
+}
+
+/// Compares the integer lanes of `lhs` with `rhs` using the comparison that
+/// `Op` is built from.  The result must be inverted if compare_inverts(Op).
+template <size_t Size, compare_op Op>
+YAT_INTERNAL_TARGET("avx2")
+[[nodiscard]] inline __m256i compare_lanes_avx2(__m256i lhs,
+                                                __m256i rhs) noexcept {
+  if constexpr (Op == compare_op::equal || Op == compare_op::not_equal) {
+    return compare_signed_avx2<Size, false>(lhs, rhs);
+  } else if constexpr (Op == compare_op::greater ||
+                       Op == compare_op::less_equal) {
+    return compare_signed_avx2<Size, true>(lhs, rhs);
+  } else {
+    return compare_signed_avx2<Size, true>(rhs, lhs);
+  }
+}
+
+/// Loads a vector of integers and compares them with `rhs` after flipping the
+/// bits in `bias` (see compare_lanes_avx2)
+template <typename T, compare_op Op>
+YAT_INTERNAL_TARGET("avx2")
+[[nodiscard]] inline __m256i compare_values_avx2(const T* p, __m256i bias,
+                                                 __m256i rhs) noexcept {
+  const __m256i v = _mm256_xor_si256(
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), bias);
+  return compare_lanes_avx2<sizeof(T), Op>(v, rhs);
+}
+
+/// AVX2 implementation of compare_words_scalar_impl.  The lanes of each vector
+/// are compared at once and packed into bits with movemask.
+template <typename T, compare_op Op>
+YAT_INTERNAL_TARGET("avx2")
+inline void compare_words_avx2_impl(const T* values, size_t num_words,
+                                    T value, little_uint64_t* out) noexcept {
+  constexpr size_t lanes = sizeof(__m256i) / sizeof(T);
+
+  for (size_t w = 0; w < num_words; ++w) {
+    const T* p = values + w * 64;
+    uint64_t bits = 0;
+
+    if constexpr (std::is_floating_point_v<T>) {
+      constexpr int predicate = float_compare_predicate(Op);
+
+      if constexpr (std::is_same_v<T, float>) {
+        const __m256 rhs = _mm256_set1_ps(value);
+
+        for (size_t i = 0; i < 64; i += lanes) {
+          const __m256 m =
+              _mm256_cmp_ps(_mm256_loadu_ps(p + i), rhs, predicate);
+          bits |= static_cast<uint64_t>(
+                      static_cast<uint32_t>(_mm256_movemask_ps(m)))
+                  << i;
+        }
+      } else {
+        const __m256d rhs = _mm256_set1_pd(value);
+
+        for (size_t i = 0; i < 64; i += lanes) {
+          const __m256d m =
+              _mm256_cmp_pd(_mm256_loadu_pd(p + i), rhs, predicate);
+          bits |= static_cast<uint64_t>(
+                      static_cast<uint32_t>(_mm256_movemask_pd(m)))
+                  << i;
+        }
+      }
+    } else {
+      // There are only signed integer comparisons, so unsigned values have
+      // their sign bits flipped to keep the same order
+      __m256i bias = _mm256_setzero_si256();
+
+      if constexpr (std::is_unsigned_v<T>) {
+        bias = broadcast_avx2(
+            static_cast<T>(std::numeric_limits<T>::max() / 2 + 1));
+      }
+
+      const __m256i rhs = _mm256_xor_si256(broadcast_avx2(value), bias);
+
+      for (size_t i = 0; i < 64;) {
+        int mask{};
+
+        if constexpr (sizeof(T) == 1) {
+          mask = _mm256_movemask_epi8(compare_values_avx2<T, Op>(p + i, bias,
+                                                                 rhs));
+        } else if constexpr (sizeof(T) == 2) {
+          // Each mask fills two bytes, so pairs of them are narrowed to bytes
+          // first.  Packing interleaves the 128-bit halves of the two
+          // vectors, which the permute puts back in order.
+          const __m256i lo = compare_values_avx2<T, Op>(p + i, bias, rhs);
+          const __m256i hi =
+              compare_values_avx2<T, Op>(p + i + lanes, bias, rhs);
+          mask = _mm256_movemask_epi8(
+              _mm256_permute4x64_epi64(_mm256_packs_epi16(lo, hi), 0xD8));
+        } else if constexpr (sizeof(T) == 4) {
+          mask = _mm256_movemask_ps(_mm256_castsi256_ps(
+              compare_values_avx2<T, Op>(p + i, bias, rhs)));
+        } else {
+          mask = _mm256_movemask_pd(_mm256_castsi256_pd(
+              compare_values_avx2<T, Op>(p + i, bias, rhs)));
+        }
+
+        bits |= static_cast<uint64_t>(static_cast<uint32_t>(mask)) << i;
+        i += (sizeof(T) == 2) ? 2 * lanes : lanes;
+      }
+
+      if constexpr (compare_inverts(Op)) {
+        bits = ~bits;
+      }
+    }
+
+    out[w] = bits;
+  }
+}
+
+/// Builds a table of permutations for compressing vectors of `Lanes` lanes
+/// with _mm256_permutevar8x32_epi32.  Entry `m` moves the lanes whose bits are
+/// set in `m` to the front.  Lanes wider than 32 bits are moved as several
+/// 32-bit lanes.
+template <size_t Lanes>
+[[nodiscard]] constexpr std::array<std::array<uint8_t, 8>, size_t{1} << Lanes>
+make_compress_table() noexcept {
+  constexpr size_t width = 8 / Lanes;
+  std::array<std::array<uint8_t, 8>, size_t{1} << Lanes> table{};
+
+  for (size_t m = 0; m < table.size(); ++m) {
+    size_t n = 0;
+
+    for (size_t lane = 0; lane < Lanes; ++lane) {
+      if (((m >> lane) & 1) != 0) {
+        for (size_t k = 0; k < width; ++k) {
+          table[m][n++] = static_cast<uint8_t>(lane * width + k);
+        }
+      }
+    }
+  }
+
+  return table;
+}
+
+/// Permutations for compressing vectors of 32-bit values
+inline constexpr auto compress_table_32 = make_compress_table<8>();
+
+/// Permutations for compressing vectors of 64-bit values
+inline constexpr auto compress_table_64 = make_compress_table<4>();
+
+/// AVX2 implementation of compact_word_scalar for 4 and 8 byte values.  Each
+/// vector of values is compressed with a permutation from a table.
+template <typename T>
+YAT_INTERNAL_TARGET("avx2")
+inline size_t compact_word_avx2(uint64_t bits, const T* in, T* out) noexcept {
+  constexpr size_t lanes = sizeof(__m256i) / sizeof(T);
+  constexpr uint64_t lane_mask = (uint64_t{1} << lanes) - 1;
+
+  size_t n = 0;
+
+  for (size_t i = 0; i < 64 && (bits >> i) != 0; i += lanes) {
+    const auto m = static_cast<size_t>((bits >> i) & lane_mask);
+    const uint8_t* control{};
+
+    if constexpr (sizeof(T) == 4) {
+      control = compress_table_32[m].data();
+    } else {
+      control = compress_table_64[m].data();
+    }
+
+    const __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+    const __m256i permutation = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(control)));
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + n),
+                        _mm256_permutevar8x32_epi32(v, permutation));
+    n += static_cast<size_t>(popcount(m));
+  }
+
+  return n;
+}
+
+/////////////////////
+// AVX-512 kernels //
+/////////////////////
+
+/// AVX-512 implementation of find_word_not_equal_scalar
+YAT_INTERNAL_TARGET("avx512f,avx512bw")
+[[nodiscard]] inline size_t find_word_not_equal_avx512(
+    const little_uint64_t* words, size_t first, size_t last,
+    uint64_t pattern) noexcept {
+  const __m512i pat = _mm512_set1_epi64(static_cast<long long>(pattern));
+
+  // Skip 2048 bits at a time while everything matches
+  for (; first + 32 <= last; first += 32) {
+    const auto* p = words + first;
+    const __m512i acc = _mm512_or_si512(
+        _mm512_or_si512(_mm512_xor_si512(_mm512_loadu_si512(p), pat),
+                        _mm512_xor_si512(_mm512_loadu_si512(p + 8), pat)),
+        _mm512_or_si512(_mm512_xor_si512(_mm512_loadu_si512(p + 16), pat),
+                        _mm512_xor_si512(_mm512_loadu_si512(p + 24), pat)));
+
+    if (_mm512_test_epi64_mask(acc, acc) != 0) {
+      break;
+    }
+  }
+
+  for (; first < last; first += 8) {
+    // Masked loads never touch memory beyond the last word
+    const auto n = last - first;
+    const auto k =
+        static_cast<__mmask8>(n >= 8 ? 0xFFU : (1U << n) - 1);
+    const __m512i v = _mm512_maskz_loadu_epi64(k, words + first);
+    const auto ne =
+        static_cast<unsigned>(_mm512_mask_cmpneq_epi64_mask(k, v, pat));
+
+    if (ne != 0) {
+      return first + static_cast<size_t>(countr_zero(ne));
+    }
+  }
+
+  return last;
+}
+
+/// AVX-512 implementation of find_last_word_not_equal_scalar
+YAT_INTERNAL_TARGET("avx512f,avx512bw")
+[[nodiscard]] inline size_t find_last_word_not_equal_avx512(
+    const little_uint64_t* words, size_t first, size_t last,
+    uint64_t pattern) noexcept {
+  const __m512i pat = _mm512_set1_epi64(static_cast<long long>(pattern));
+  auto i = last;
+
+  // Skip 2048 bits at a time while everything matches
+  for (; i >= first + 32; i -= 32) {
+    const auto* p = words + i - 32;
+    const __m512i acc = _mm512_or_si512(
+        _mm512_or_si512(_mm512_xor_si512(_mm512_loadu_si512(p), pat),
+                        _mm512_xor_si512(_mm512_loadu_si512(p + 8), pat)),
+        _mm512_or_si512(_mm512_xor_si512(_mm512_loadu_si512(p + 16), pat),
+                        _mm512_xor_si512(_mm512_loadu_si512(p + 24), pat)));
+
+    if (_mm512_test_epi64_mask(acc, acc) != 0) {
+      break;
+    }
+  }
+
+  while (i > first) {
+    // Masked loads never touch memory before the first word
+    const auto n = std::min<size_t>(i - first, 8);
+    const auto k = static_cast<__mmask8>((1U << n) - 1);
+    const __m512i v = _mm512_maskz_loadu_epi64(k, words + i - n);
+    const auto ne =
+        static_cast<unsigned>(_mm512_mask_cmpneq_epi64_mask(k, v, pat));
+
+    if (ne != 0) {
+      return i - n + static_cast<size_t>(31 - countl_zero(ne));
+    }
+
+    i -= n;
+  }
+
+  return last;
+}
+
+/// Applies a bitwise operation to a pair of vectors
+template <bitwise_op Op>
+YAT_INTERNAL_TARGET("avx512f,avx512bw")
+[[nodiscard]] inline __m512i
+    apply_bitwise_op_avx512(__m512i lhs, __m512i rhs) noexcept {
+  if constexpr (Op == bitwise_op::bit_and) {
+    return _mm512_and_si512(lhs, rhs);
+  } else if constexpr (Op == bitwise_op::bit_or) {
+    return _mm512_or_si512(lhs, rhs);
+  } else if constexpr (Op == bitwise_op::bit_xor) {
+    return _mm512_xor_si512(lhs, rhs);
+  } else {
+    // Same as _mm512_andnot_si512(rhs, lhs), which trips gcc's uninitialized
+    // variable warnings
+    return _mm512_ternarylogic_epi64(lhs, rhs, rhs, 0x10);
+  }
+}
+
+/// AVX-512 implementation of bitwise_scalar_impl
+template <bitwise_op Op>
+YAT_INTERNAL_TARGET("avx512f,avx512bw")
+inline void bitwise_avx512_impl(little_uint64_t* dst,
+                                const little_uint64_t* src, size_t n) noexcept {
+  for (size_t i = 0; i < n; i += 8) {
+    // Masked loads and stores never touch memory beyond the last word
+    const auto r = n - i;
+    const auto k = static_cast<__mmask8>(r >= 8 ? 0xFFU : (1U << r) - 1);
+    const auto v =
+        apply_bitwise_op_avx512<Op>(_mm512_maskz_loadu_epi64(k, dst + i),
+                                    _mm512_maskz_loadu_epi64(k, src + i));
+    _mm512_mask_storeu_epi64(dst + i, k, v);
+  }
+}
+
+/// AVX-512 implementation of find_op_word_not_equal_scalar_impl
+template <bitwise_op Op>
+YAT_INTERNAL_TARGET("avx512f,avx512bw")
+[[nodiscard]] inline size_t find_op_word_not_equal_avx512_impl(
+    const little_uint64_t* lhs, const little_uint64_t* rhs, size_t first,
+    size_t last, uint64_t pattern) noexcept {
+  const __m512i pat = _mm512_set1_epi64(static_cast<long long>(pattern));
+
+  for (; first < last; first += 8) {
+    const auto n = last - first;
+    const auto k = static_cast<__mmask8>(n >= 8 ? 0xFFU : (1U << n) - 1);
+    const auto v =
+        apply_bitwise_op_avx512<Op>(_mm512_maskz_loadu_epi64(k, lhs + first),
+                                    _mm512_maskz_loadu_epi64(k, rhs + first));
+    const auto ne =
+        static_cast<unsigned>(_mm512_mask_cmpneq_epi64_mask(k, v, pat));
+
+    if (ne != 0) {
+      return first + static_cast<size_t>(countr_zero(ne));
+    }
+  }
+
+  return last;
+}
+
+/// AVX-512 implementation of bitwise_scalar
+YAT_INTERNAL_TARGET("avx512f,avx512bw")
+inline void bitwise_avx512(little_uint64_t* dst, const little_uint64_t* src,
+                           size_t n, bitwise_op op) noexcept {
+  YAT_INTERNAL_BITWISE_OP_DISPATCH(bitwise_avx512_impl, dst, src, n)
+}
+
+/// AVX-512 implementation of find_op_word_not_equal_scalar
+YAT_INTERNAL_TARGET("avx512f,avx512bw")
+[[nodiscard]] inline size_t find_op_word_not_equal_avx512(
+    const little_uint64_t* lhs, const little_uint64_t* rhs, bitwise_op op,
+    size_t first, size_t last, uint64_t pattern) noexcept {
+  YAT_INTERNAL_BITWISE_OP_DISPATCH(find_op_word_not_equal_avx512_impl, lhs,
+                                   rhs, first, last, pattern)
+}
+
+/// Returns the number of set bits in each 64-bit lane of a vector, using a
+/// nibble lookup table
+YAT_INTERNAL_TARGET("avx512f,avx512bw")
+[[nodiscard]] inline __m512i popcount_lanes_avx512(__m512i v) noexcept {
+  // The bit counts of 0-7 and 8-15, repeated in each 128-bit lane
+  const __m512i lookup =
+      _mm512_set_epi64(0x0403030203020201, 0x0302020102010100,
+                       0x0403030203020201, 0x0302020102010100,
+                       0x0403030203020201, 0x0302020102010100,
+                       0x0403030203020201, 0x0302020102010100);
+  const __m512i low_mask = _mm512_set1_epi8(0x0F);
+
+  const __m512i lo = _mm512_and_si512(v, low_mask);
+  const __m512i hi = _mm512_and_si512(_mm512_srli_epi16(v, 4), low_mask);
+  const __m512i counts = _mm512_add_epi8(_mm512_shuffle_epi8(lookup, lo),
+                                         _mm512_shuffle_epi8(lookup, hi));
+
+  return _mm512_sad_epu8(counts, _mm512_setzero_si512());
+}
+
+/// Returns the sum of the 64-bit lanes of a vector
+YAT_INTERNAL_TARGET("avx512f,avx512bw")
+[[nodiscard]] inline uint64_t sum_lanes_avx512(__m512i v) noexcept {
+  // _mm512_reduce_add_epi64 trips -Wuninitialized in some GCC headers
+  uint64_t lanes[8];
+  _mm512_storeu_si512(lanes, v);
+
+  uint64_t total = 0;
+  for (const auto lane : lanes) {
+    total += lane;
+  }
+
+  return total;
+}
+
+/// A carry-save adder that adds three vectors bit by bit, producing the high
+/// (carry) and low (sum) bits of each result.  Each output is a single
+/// ternary logic instruction: 0xE8 is majority and 0x96 is three-way XOR.
+YAT_INTERNAL_TARGET("avx512f,avx512bw")
+inline void carry_save_add_avx512(__m512i& high, __m512i& low, __m512i a,
+                                  __m512i b, __m512i c) noexcept {
+  high = _mm512_ternarylogic_epi64(a, b, c, 0xE8);
+  low = _mm512_ternarylogic_epi64(a, b, c, 0x96);
+}
+
+/// AVX-512 implementation of popcount_scalar (see popcount_avx2)
+YAT_INTERNAL_TARGET("avx512f,avx512bw")
+[[nodiscard]] inline uint64_t popcount_avx512(const little_uint64_t* words,
+                                              size_t first,
+                                              size_t last) noexcept {
+  __m512i total = _mm512_setzero_si512();
+  __m512i ones = _mm512_setzero_si512();
+  __m512i twos = _mm512_setzero_si512();
+  __m512i fours = _mm512_setzero_si512();
+  __m512i eights = _mm512_setzero_si512();
+  __m512i sixteens = _mm512_setzero_si512();
+  __m512i twos_a = _mm512_setzero_si512();
+  __m512i twos_b = _mm512_setzero_si512();
+  __m512i fours_a = _mm512_setzero_si512();
+  __m512i fours_b = _mm512_setzero_si512();
+  __m512i eights_a = _mm512_setzero_si512();
+  __m512i eights_b = _mm512_setzero_si512();
+
+  for (; first + 128 <= last; first += 128) {
+    const auto* p = words + first;
+
+    carry_save_add_avx512(twos_a, ones, ones, _mm512_loadu_si512(p),
+                          _mm512_loadu_si512(p + 8));
+    carry_save_add_avx512(twos_b, ones, ones, _mm512_loadu_si512(p + 16),
+                          _mm512_loadu_si512(p + 24));
+    carry_save_add_avx512(fours_a, twos, twos, twos_a, twos_b);
+    carry_save_add_avx512(twos_a, ones, ones, _mm512_loadu_si512(p + 32),
+                          _mm512_loadu_si512(p + 40));
+    carry_save_add_avx512(twos_b, ones, ones, _mm512_loadu_si512(p + 48),
+                          _mm512_loadu_si512(p + 56));
+    carry_save_add_avx512(fours_b, twos, twos, twos_a, twos_b);
+    carry_save_add_avx512(eights_a, fours, fours, fours_a, fours_b);
+    carry_save_add_avx512(twos_a, ones, ones, _mm512_loadu_si512(p + 64),
+                          _mm512_loadu_si512(p + 72));
+    carry_save_add_avx512(twos_b, ones, ones, _mm512_loadu_si512(p + 80),
+                          _mm512_loadu_si512(p + 88));
+    carry_save_add_avx512(fours_a, twos, twos, twos_a, twos_b);
+    carry_save_add_avx512(twos_a, ones, ones, _mm512_loadu_si512(p + 96),
+                          _mm512_loadu_si512(p + 104));
+    carry_save_add_avx512(twos_b, ones, ones, _mm512_loadu_si512(p + 112),
+                          _mm512_loadu_si512(p + 120));
+    carry_save_add_avx512(fours_b, twos, twos, twos_a, twos_b);
+    carry_save_add_avx512(eights_b, fours, fours, fours_a, fours_b);
+    carry_save_add_avx512(sixteens, eights, eights, eights_a, eights_b);
+
+    total = _mm512_add_epi64(total, popcount_lanes_avx512(sixteens));
+  }
+
+  // Count the remaining words, using masked loads for the last partial vector
+  __m512i rest = popcount_lanes_avx512(ones);
+
+  for (; first < last; first += 8) {
+    const auto n = last - first;
+    const auto k = static_cast<__mmask8>(n >= 8 ? 0xFFU : (1U << n) - 1);
+    const __m512i v = _mm512_maskz_loadu_epi64(k, words + first);
+
+    rest = _mm512_add_epi64(rest, popcount_lanes_avx512(v));
+  }
+
+  return 16 * sum_lanes_avx512(total) +
+         8 * sum_lanes_avx512(popcount_lanes_avx512(eights)) +
+         4 * sum_lanes_avx512(popcount_lanes_avx512(fours)) +
+         2 * sum_lanes_avx512(popcount_lanes_avx512(twos)) +
+         sum_lanes_avx512(rest);
+}
+
+/// AVX-512 implementation of flatten_scalar.  The indices of a whole vector of
+/// bits are generated at once and the ones for set bits are compressed to the
+/// front of the vector.
+template <typename T>
+YAT_INTERNAL_TARGET("avx512f,avx512bw")
+[[nodiscard]] inline size_t flatten_avx512(const little_uint64_t* words,
+                                           size_t& first, size_t last,
+                                           uint64_t flip, T* out,
+                                           size_t capacity) noexcept {
+  static_assert(sizeof(T) == 4 || sizeof(T) == 8, "unsupported index size");
+
+  constexpr size_t lanes = sizeof(__m512i) / sizeof(T);
+  const __m512i offsets =
+      (sizeof(T) == 4)
+          ? _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+                              15)
+          : _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+
+  size_t n = 0;
+
+  for (; first < last; ++first) {
+    const uint64_t bits = load_word(words + first) ^ flip;
+
+    if (static_cast<size_t>(popcount(bits)) > capacity - n) {
+      break;
+    }
+
+    for (size_t k = 0; k < 64 && (bits >> k) != 0; k += lanes) {
+      const auto base = first * 64 + k;
+      __m512i v{};
+      size_t c{};
+
+      if constexpr (sizeof(T) == 4) {
+        const auto mask = static_cast<__mmask16>(bits >> k);
+        const __m512i indices = _mm512_add_epi32(
+            _mm512_set1_epi32(static_cast<int>(base)), offsets);
+
+        // Compressing to memory is slow on some CPUs, so only do it when
+        // there isn't room for a whole vector
+        if (capacity - n < lanes) {
+          _mm512_mask_compressstoreu_epi32(out + n, mask, indices);
+          n += static_cast<size_t>(popcount(static_cast<uint32_t>(mask)));
+          continue;
+        }
+
+        v = _mm512_maskz_compress_epi32(mask, indices);
+        c = static_cast<size_t>(popcount(static_cast<uint32_t>(mask)));
+      } else {
+        const auto mask = static_cast<__mmask8>(bits >> k);
+        const __m512i indices = _mm512_add_epi64(
+            _mm512_set1_epi64(static_cast<long long>(base)), offsets);
+
+        if (capacity - n < lanes) {
+          _mm512_mask_compressstoreu_epi64(out + n, mask, indices);
+          n += static_cast<size_t>(popcount(static_cast<uint32_t>(mask)));
+          continue;
+        }
+
+        v = _mm512_maskz_compress_epi64(mask, indices);
+        c = static_cast<size_t>(popcount(static_cast<uint32_t>(mask)));
+      }
+
+      _mm512_storeu_si512(out + n, v);
+      n += c;
+    }
+  }
+
+  return n;
+}
+
+/// Returns the AVX-512 predicate for an integer comparison
+[[nodiscard]] constexpr int int_compare_predicate(compare_op op) noexcept {
+  switch (op) {
+    case compare_op::equal:
+      return _MM_CMPINT_EQ;
+    case compare_op::not_equal:
+      return _MM_CMPINT_NE;
+    case compare_op::less:
+      return _MM_CMPINT_LT;
+    case compare_op::less_equal:
+      return _MM_CMPINT_LE;
+    case compare_op::greater:
+      return _MM_CMPINT_NLE;
+    case compare_op::greater_equal:
+      return _MM_CMPINT_NLT;
+  }
+
+  YAT_UNREACHABLE();
+}
+
+/// Compares a vector of values with `value`, returning a bit for each lane
+template <typename T, compare_op Op>
+YAT_INTERNAL_TARGET("avx512f,avx512bw")
+[[nodiscard]] inline uint64_t compare_mask_avx512(const T* p,
+                                                  T value) noexcept {
+  constexpr int predicate = std::is_floating_point_v<T>
+                                ? float_compare_predicate(Op)
+                                : int_compare_predicate(Op);
+
+  if constexpr (std::is_same_v<T, float>) {
+    return _mm512_cmp_ps_mask(_mm512_loadu_ps(p), _mm512_set1_ps(value),
+                              predicate);
+  } else if constexpr (std::is_same_v<T, double>) {
+    return _mm512_cmp_pd_mask(_mm512_loadu_pd(p), _mm512_set1_pd(value),
+                              predicate);
+  } else {
+    const __m512i v = _mm512_loadu_si512(p);
+
+    if constexpr (sizeof(T) == 1) {
+      const __m512i rhs = _mm512_set1_epi8(static_cast<char>(value));
+      return std::is_signed_v<T> ? _mm512_cmp_epi8_mask(v, rhs, predicate)
+                                 : _mm512_cmp_epu8_mask(v, rhs, predicate);
+    } else if constexpr (sizeof(T) == 2) {
+      const __m512i rhs = _mm512_set1_epi16(static_cast<short>(value));
+      return std::is_signed_v<T> ? _mm512_cmp_epi16_mask(v, rhs, predicate)
+                                 : _mm512_cmp_epu16_mask(v, rhs, predicate);
+    } else if constexpr (sizeof(T) == 4) {
+      const __m512i rhs = _mm512_set1_epi32(static_cast<int>(value));
+      return std::is_signed_v<T> ? _mm512_cmp_epi32_mask(v, rhs, predicate)
+                                 : _mm512_cmp_epu32_mask(v, rhs, predicate);
+    } else {
+      const __m512i rhs = _mm512_set1_epi64(static_cast<long long>(value));
+      return std::is_signed_v<T> ? _mm512_cmp_epi64_mask(v, rhs, predicate)
+                                 : _mm512_cmp_epu64_mask(v, rhs, predicate);
+    }
+  }
+}
+
+/// AVX-512 implementation of compare_words_scalar_impl.  The comparisons
+/// produce bit masks directly.
+template <typename T, compare_op Op>
+YAT_INTERNAL_TARGET("avx512f,avx512bw")
+inline void compare_words_avx512_impl(const T* values, size_t num_words,
+                                      T value, little_uint64_t* out) noexcept {
+  constexpr size_t lanes = sizeof(__m512i) / sizeof(T);
+
+  for (size_t w = 0; w < num_words; ++w) {
+    const T* p = values + w * 64;
+    uint64_t bits = 0;
+
+    for (size_t i = 0; i < 64; i += lanes) {
+      bits |= compare_mask_avx512<T, Op>(p + i, value) << i;
+    }
+
+    out[w] = bits;
+  }
+}
+
+/// AVX-512 implementation of compact_word_scalar for 4 and 8 byte values
+template <typename T>
+YAT_INTERNAL_TARGET("avx512f,avx512bw")
+inline size_t compact_word_avx512(uint64_t bits, const T* in,
+                                  T* out) noexcept {
+  constexpr size_t lanes = sizeof(__m512i) / sizeof(T);
+
+  size_t n = 0;
+
+  for (size_t i = 0; i < 64 && (bits >> i) != 0; i += lanes) {
+    const __m512i v = _mm512_loadu_si512(in + i);
+
+    if constexpr (sizeof(T) == 4) {
+      const auto m = static_cast<__mmask16>(bits >> i);
+      _mm512_storeu_si512(out + n, _mm512_maskz_compress_epi32(m, v));
+      n += static_cast<size_t>(popcount(static_cast<uint32_t>(m)));
+    } else {
+      const auto m = static_cast<__mmask8>(bits >> i);
+      _mm512_storeu_si512(out + n, _mm512_maskz_compress_epi64(m, v));
+      n += static_cast<size_t>(popcount(static_cast<uint32_t>(m)));
+    }
+  }
+
+  return n;
+}
+
+#endif  // YAT_INTERNAL_HAS_X86_SIMD
+
+/// A table of the kernels specialized for a given instruction set
+struct bitmap_kernels {
+  /// Returns the index of the first word in [first, last) that is not equal to
+  /// `pattern`, or `last` if there are none.
+  size_t (*find_word_not_equal)(const little_uint64_t* words, size_t first,
+                                size_t last, uint64_t pattern) noexcept;
+
+  /// Returns the index of the last word in [first, last) that is not equal to
+  /// `pattern`, or `last` if there are none.
+  size_t (*find_last_word_not_equal)(const little_uint64_t* words,
+                                     size_t first, size_t last,
+                                     uint64_t pattern) noexcept;
+
+  /// Applies `dst[i] = dst[i] op src[i]` to `n` words
+  void (*bitwise)(little_uint64_t* dst, const little_uint64_t* src, size_t n,
+                  bitwise_op op) noexcept;
+
+  /// Returns the index of the first word in [first, last) where `lhs[i] op
+  /// rhs[i]` is not equal to `pattern`, or `last` if there are none.
+  size_t (*find_op_word_not_equal)(const little_uint64_t* lhs,
+                                   const little_uint64_t* rhs, bitwise_op op,
+                                   size_t first, size_t last,
+                                   uint64_t pattern) noexcept;
+
+  /// Returns the number of set bits in the words [first, last)
+  uint64_t (*popcount)(const little_uint64_t* words, size_t first,
+                       size_t last) noexcept;
+
+  /// Writes the indices of the set bits of the words [first, last), after they
+  /// are XORed with `flip`, to `out` (see flatten_scalar)
+  size_t (*flatten32)(const little_uint64_t* words, size_t& first,
+                      size_t last, uint64_t flip, uint32_t* out,
+                      size_t capacity) noexcept;
+
+  /// 64-bit index version of flatten32
+  size_t (*flatten64)(const little_uint64_t* words, size_t& first,
+                      size_t last, uint64_t flip, uint64_t* out,
+                      size_t capacity) noexcept;
+};
+
+/// Returns the kernel table for an instruction set.  Callers are responsible
+/// for making sure the instruction set is supported by the running CPU.
+[[nodiscard]] inline const bitmap_kernels& bitmap_kernels_for(
+    simd_isa isa) noexcept {
+  static constexpr bitmap_kernels scalar_kernels{
+      find_word_not_equal_scalar,
+      find_last_word_not_equal_scalar,
+      bitwise_scalar,
+      find_op_word_not_equal_scalar,
+      popcount_scalar,
+      flatten_scalar<uint32_t>,
+      flatten_scalar<uint64_t>,
+  };
+
+#ifdef YAT_INTERNAL_HAS_X86_SIMD
+  static constexpr bitmap_kernels sse2_kernels{
+      find_word_not_equal_sse2,
+      find_last_word_not_equal_sse2,
+      bitwise_sse2,
+      find_op_word_not_equal_sse2,
+      popcount_sse2,
+      flatten_scalar<uint32_t>,
+      flatten_scalar<uint64_t>,
+  };
+
+  static constexpr bitmap_kernels avx2_kernels{
+      find_word_not_equal_avx2,
+      find_last_word_not_equal_avx2,
+      bitwise_avx2,
+      find_op_word_not_equal_avx2,
+      popcount_avx2,
+      flatten_scalar<uint32_t>,
+      flatten_scalar<uint64_t>,
+  };
+
+  static constexpr bitmap_kernels avx512_kernels{
+      find_word_not_equal_avx512,
+      find_last_word_not_equal_avx512,
+      bitwise_avx512,
+      find_op_word_not_equal_avx512,
+      popcount_avx512,
+      flatten_avx512<uint32_t>,
+      flatten_avx512<uint64_t>,
+  };
+
+  switch (isa) {
+    case simd_isa::scalar:
+      return scalar_kernels;
+    case simd_isa::sse2:
+      return sse2_kernels;
+    case simd_isa::avx2:
+      return avx2_kernels;
+    case simd_isa::avx512:
+      return avx512_kernels;
+  }
+#else
+  (void)isa;
+#endif  // YAT_INTERNAL_HAS_X86_SIMD
+
+  return scalar_kernels;
+}
+
+/// Returns the kernel table for the best instruction set supported by the
+/// running CPU.  Detection only happens once.
+[[nodiscard]] inline const bitmap_kernels& active_bitmap_kernels() noexcept {
+  static const bitmap_kernels& kernels = bitmap_kernels_for(active_simd_isa());
+  return kernels;
+}
+
+/// Packs `values[i] op value` for `num_words` words of 64 values into `out`.
+/// Integer and floating point values are compared with the kernels for `isa`,
+/// which must be supported by the running CPU.
+template <typename T>
+inline void compare_words(const T* values, size_t num_words, compare_op op,
+                          const T& value, little_uint64_t* out,
+                          simd_isa isa = active_simd_isa()) {
+#ifdef YAT_INTERNAL_HAS_X86_SIMD
+  if constexpr (is_simd_comparable_v<T>) {
+    if (isa == simd_isa::avx512) {
+      YAT_INTERNAL_COMPARE_OP_DISPATCH(compare_words_avx512_impl, values,
+                                       num_words, value, out)
+    }
+
+    if (isa == simd_isa::avx2) {
+      YAT_INTERNAL_COMPARE_OP_DISPATCH(compare_words_avx2_impl, values,
+                                       num_words, value, out)
+    }
+  }
+#endif  // YAT_INTERNAL_HAS_X86_SIMD
+
+  (void)isa;
+  YAT_INTERNAL_COMPARE_OP_DISPATCH(compare_words_scalar_impl, values, num_words,
+                                   value, out)
+}
+
+/// Indicates that values of type `T` can be compacted by the vectorized
+/// kernels
+template <typename T>
+inline constexpr bool is_simd_compactable_v =
+    std::is_trivially_copyable_v<T> && (sizeof(T) == 4 || sizeof(T) == 8);
+
+/// A kernel that compacts the values selected by a word (see
+/// compact_word_scalar)
+template <typename T>
+using compact_word_fn = size_t (*)(uint64_t bits, const T* in, T* out);
+
+/// Returns the kernel for `isa` that compacts the values selected by a word.
+/// `isa` must be supported by the running CPU.
+template <typename T>
+[[nodiscard]] inline compact_word_fn<T> compact_word_kernel(
+    simd_isa isa = active_simd_isa()) noexcept {
+#ifdef YAT_INTERNAL_HAS_X86_SIMD
+  if constexpr (is_simd_compactable_v<T>) {
+    if (isa == simd_isa::avx512) {
+      return compact_word_avx512<T>;
+    }
+
+    if (isa == simd_isa::avx2) {
+      return compact_word_avx2<T>;
+    }
+  }
+#endif  // YAT_INTERNAL_HAS_X86_SIMD
+
+  (void)isa;
+  return compact_word_scalar<T>;
+}
+
+}  // namespace yat::detail
+
+// Cleanup internal macros
+#undef YAT_INTERNAL_BITWISE_OP_DISPATCH
+#undef YAT_INTERNAL_COMPARE_OP_DISPATCH
+#undef YAT_INTERNAL_TARGET
+#undef YAT_INTERNAL_HAS_X86_SIMD
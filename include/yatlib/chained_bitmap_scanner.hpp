@@ -0,0 +1,211 @@
+/*
+ * Copyright 2020 Joe T. Sylve, Ph.D.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <utility>
+
+#include "bitmap.hpp"
+#include "iterator.hpp"
+#include "optional.hpp"
+
+namespace yat {
+
+/// A slice of a larger logical bitmap
+struct bitmap_chunk {
+  uint64_t bit_offset;  ///< The logical index of the first bit of the chunk
+  bitmap_view bits;     ///< The bits of the chunk
+};
+
+/// Scans a logical bitmap that is split into chunks for ranges of set or unset
+/// bits.
+///
+/// The chunks are fetched one at a time by calling `source()`, which returns a
+/// `yat::optional<bitmap_chunk>` and `yat::nullopt` once there are no chunks
+/// left.  Chunks must be returned in order and must not overlap, and each must
+/// stay valid until the next one is fetched.  The scanned ranges are numbered
+/// by their logical bit indices and ranges that continue from one chunk to the
+/// next are reported as a single range.  Any bits in gaps between chunks are
+/// treated as unset.
+///
+/// Since the chunks are fetched lazily, the scanner can only be iterated once.
+template <typename ChunkSource>
+class chained_bitmap_scanner {
+  using chunk_iterator =
+      decltype(std::declval<const bitmap_scanner&>().begin());
+
+  /// An iterator for chained_bitmap_scanner that iterates through the scanned
+  /// ranges
+  class iterator {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = bitmap_range;
+    using difference_type = void;  // No meaningful way of taking difference
+    using pointer = const value_type*;
+    using reference = const value_type&;
+
+    /// Construct an empty iterator (this will compare with end())
+    constexpr iterator() noexcept {};  // clang 5 had a bug when using
+                                       // "= default" here
+
+    /// Construct an iterator from a scanner
+    explicit iterator(chained_bitmap_scanner* scanner) : _scanner{scanner} {
+      next();
+    }
+
+    /// Equality operator
+    friend bool operator==(const iterator& lhs, const iterator& rhs) noexcept {
+      return lhs._scanner == rhs._scanner;
+    }
+
+    /// Inequality operator
+    friend bool operator!=(const iterator& lhs, const iterator& rhs) noexcept {
+      return lhs._scanner != rhs._scanner;
+    }
+
+    /// Sentinel equality
+    bool operator==(const yat::default_sentinel_t&) const noexcept {
+      return _scanner == nullptr;
+    }
+
+    /// Dereference operator
+    reference operator*() const noexcept { return _scanner->_range; }
+
+    /// Pointer dereference operator
+    pointer operator->() const noexcept { return &_scanner->_range; }
+
+    /// Prefix increment operator
+    iterator& operator++() { return next(); }
+
+    /// Postfix increment operator
+    void operator++(int) { next(); }
+
+   private:
+    /// Get the next range
+    iterator& next() {
+      if (!_scanner->next()) {
+        _scanner = nullptr;
+      }
+
+      return *this;
+    }
+
+    chained_bitmap_scanner* _scanner{};  ///< Unowned pointer to the scanner
+  };
+
+ public:
+  /// Creates a scanner that reads its chunks from `source`
+  ///
+  /// \param source Returns the next chunk each time that it is called
+  /// \param scan_set Indicates that we're scanning for ranges of set bits
+  explicit chained_bitmap_scanner(ChunkSource source, bool scan_set = true)
+      : _source{std::move(source)}, _scan_set{scan_set} {}
+
+  // The chunk scanner's iterator points back into the scanner
+  chained_bitmap_scanner(const chained_bitmap_scanner&) = delete;
+  chained_bitmap_scanner& operator=(const chained_bitmap_scanner&) = delete;
+
+  /// Returns an iterator to the start of the ranges.  This starts fetching
+  /// chunks and may only be called once.
+  [[nodiscard]] iterator begin() { return iterator{this}; }
+
+  /// Returns an iterator to the end of the ranges
+  [[nodiscard]] iterator end() const noexcept { return {}; }
+
+ private:
+  /// Gets the next range from the current chunk, fetching more chunks as
+  /// needed.  Ranges that are adjacent are not yet coalesced.
+  bool next_piece(bitmap_range& piece) {
+    while (!_exhausted) {
+      if (_gap.count != 0) {
+        piece = std::exchange(_gap, {});
+        return true;
+      }
+
+      if (_chunk_it != _chunk_scanner.end()) {
+        piece = {_chunk_offset + _chunk_it->start, _chunk_it->count};
+        ++_chunk_it;
+        return true;
+      }
+
+      optional<bitmap_chunk> chunk = _source();
+
+      if (!chunk) {
+        _exhausted = true;
+        return false;
+      }
+
+      // A gap between chunks is a range of unset bits
+      if (!_scan_set && _fetched && chunk->bit_offset > _chunk_end) {
+        _gap = {_chunk_end, chunk->bit_offset - _chunk_end};
+      }
+
+      _fetched = true;
+      _chunk_offset = chunk->bit_offset;
+      _chunk_end = chunk->bit_offset + chunk->bits.count();
+      _chunk_scanner = bitmap_scanner{chunk->bits, _scan_set};
+      _chunk_it = _chunk_scanner.begin();
+    }
+
+    return false;
+  }
+
+  /// Finds the next range, returning false if there are none
+  bool next() {
+    bitmap_range piece{};
+
+    if (!_has_pending) {
+      if (!next_piece(piece)) {
+        return false;
+      }
+
+      _pending = piece;
+      _has_pending = true;
+    }
+
+    // Keep extending the pending range until we find a piece that doesn't
+    // continue it
+    while (next_piece(piece)) {
+      if (piece.start == _pending.start + _pending.count) {
+        _pending.count += piece.count;
+        continue;
+      }
+
+      _range = std::exchange(_pending, piece);
+      return true;
+    }
+
+    _range = _pending;
+    _has_pending = false;
+    return true;
+  }
+
+  ChunkSource _source;  ///< Fetches the chunks
+  bool _scan_set;       ///< Scanning for ranges of set bits
+  bool _fetched{};      ///< At least one chunk has been fetched
+  bool _exhausted{};    ///< The source has run out of chunks
+  uint64_t _chunk_offset{};  ///< The logical index of the current chunk
+  uint64_t _chunk_end{};     ///< The logical end of the current chunk
+  bitmap_scanner _chunk_scanner{nullptr, 0};  ///< Scans the current chunk
+  chunk_iterator _chunk_it{};                 ///< The current chunk range
+  bitmap_range _gap{};      ///< Unset bits between chunks to report
+  bitmap_range _pending{};  ///< The range that's being extended
+  bool _has_pending{};      ///< There is a pending range
+  bitmap_range _range{};    ///< The current range
+};
+
+}  // namespace yat
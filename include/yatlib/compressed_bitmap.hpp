@@ -0,0 +1,769 @@
+/*
+ * Copyright 2020 Joe T. Sylve, Ph.D.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "bit.hpp"
+#include "bitmap.hpp"
+#include "bitmap_simd.hpp"
+#include "endian.hpp"
+#include "features.hpp"
+#include "iterator.hpp"
+
+namespace yat {
+
+/// A compressed bitmap in the style of Roaring bitmaps.
+///
+/// The bits are split into chunks of 65536 bits.  Chunks without any set bits
+/// are not stored at all, and every other chunk is stored in whichever of three
+/// containers is smallest: a sorted array of the positions of its set bits, a
+/// plain bitset, or a sorted list of runs of set bits.  Set operations are done
+/// chunk by chunk without decompressing the whole bitmap.
+class compressed_bitmap {
+ public:
+  /// Special marker that is returned when there are no bits left to scan
+  static constexpr uint64_t no_bits_left = bitmap_view::no_bits_left;
+
+  /// The number of bits in each chunk
+  static constexpr uint64_t chunk_bits = 65536;
+
+  /// The types of containers that hold the bits of a chunk
+  enum class container_type : uint8_t { array, bitset, runs };
+
+  /// Create an empty bitmap
+  compressed_bitmap() noexcept {};  // clang 5 had a bug when using
+                                    // "= default" here
+
+  /// Create a bitmap with `n` unset bits
+  explicit compressed_bitmap(uint64_t n) noexcept : _count{n} {}
+
+  /// Create a bitmap that holds a compressed copy of the bits in a view
+  explicit compressed_bitmap(const bitmap_view& view) : _count{view.count()} {
+    for (uint64_t start = 0; start < _count; start += chunk_bits) {
+      const auto n = std::min(chunk_bits, _count - start);
+
+      // Don't bother copying chunks that have nothing set
+      if (view.none_set(start, n)) {
+        continue;
+      }
+
+      const auto first = static_cast<size_t>(start / 64);
+      std::vector<little_uint64_t> bits(chunk_words);
+
+      for (size_t w = 0; w < (n + 63) / 64; w++) {
+        bits[w] = view.word(first + w);
+      }
+
+      // Clear any bits beyond the end of the view
+      if (n % 64 != 0) {
+        auto& tail = bits[n / 64];
+        tail = tail & detail::word_mask(0, n % 64);
+      }
+
+      _chunks.push_back(make_chunk(start / chunk_bits, std::move(bits)));
+    }
+  }
+
+  /// Returns an uncompressed copy of the bitmap
+  [[nodiscard]] bitmap to_bitmap() const {
+    bitmap bm{_count};
+
+    for (const auto& c : _chunks) {
+      for (const auto& r : chunk_runs(c)) {
+        bm.set(c.key * chunk_bits + r.first, uint64_t{r.last} - r.first + 1);
+      }
+    }
+
+    return bm;
+  }
+
+  /// Access a given bit.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  bool operator[](uint64_t n) const noexcept {
+    const auto it = find_chunk(n / chunk_bits);
+
+    return it != _chunks.end() && it->key == n / chunk_bits &&
+           chunk_contains(*it, static_cast<uint16_t>(n % chunk_bits));
+  }
+
+  /// Return the count of bits in the set
+  [[nodiscard]] uint64_t count() const noexcept { return _count; }
+
+  /// Returns the number of set bits
+  [[nodiscard]] uint64_t count_set() const noexcept {
+    uint64_t total = 0;
+
+    for (const auto& c : _chunks) {
+      total += c.cardinality;
+    }
+
+    return total;
+  }
+
+  /// Returns the number of chunks that have bits set
+  [[nodiscard]] size_t num_chunks() const noexcept { return _chunks.size(); }
+
+  /// Returns the type of container used by the nth stored chunk
+  [[nodiscard]] container_type chunk_type(size_t n) const noexcept {
+    return _chunks[n].type;
+  }
+
+  /// Returns the approximate number of bytes used to store the bitmap
+  [[nodiscard]] size_t memory_usage() const noexcept {
+    size_t total = sizeof(*this) + _chunks.capacity() * sizeof(chunk);
+
+    for (const auto& c : _chunks) {
+      total += c.values.capacity() * sizeof(uint16_t) +
+               c.words.capacity() * sizeof(little_uint64_t) +
+               c.runs.capacity() * sizeof(run);
+    }
+
+    return total;
+  }
+
+  /// Returns the index of the first set bit at or after `first`, or
+  /// `no_bits_left` if there are none
+  [[nodiscard]] uint64_t find_next_set(uint64_t first) const noexcept {
+    if (first >= _count) {
+      return no_bits_left;
+    }
+
+    auto it = find_chunk(first / chunk_bits);
+
+    if (it != _chunks.end() && it->key == first / chunk_bits) {
+      const auto low = static_cast<uint16_t>(first % chunk_bits);
+
+      if (const auto p = chunk_find_next<true>(*it, low); p != no_bits_left) {
+        return it->key * chunk_bits + p;
+      }
+
+      ++it;
+    }
+
+    if (it == _chunks.end()) {
+      return no_bits_left;
+    }
+
+    // Stored chunks always have a bit set
+    return it->key * chunk_bits + chunk_find_next<true>(*it, 0);
+  }
+
+  /// Returns the index of the first unset bit at or after `first`, or
+  /// `no_bits_left` if there are none
+  [[nodiscard]] uint64_t find_next_clear(uint64_t first) const noexcept {
+    auto it = find_chunk(first / chunk_bits);
+
+    while (first < _count) {
+      // Chunks that aren't stored have no bits set
+      if (it == _chunks.end() || it->key != first / chunk_bits) {
+        return first;
+      }
+
+      const auto low = static_cast<uint16_t>(first % chunk_bits);
+
+      if (const auto p = chunk_find_next<false>(*it, low); p != no_bits_left) {
+        first = it->key * chunk_bits + p;
+        return (first < _count) ? first : no_bits_left;
+      }
+
+      // The rest of the chunk is set, so move on to the next one
+      first = (it->key + 1) * chunk_bits;
+      ++it;
+    }
+
+    return no_bits_left;
+  }
+
+  /// Applies a bitwise operation with another bitmap in place.  The bitmap
+  /// keeps its size; `rhs` is treated as zero-extended or truncated to match.
+  compressed_bitmap& apply(bitwise_op op, const compressed_bitmap& rhs) {
+    std::vector<chunk> result{};
+
+    const bool keep_lhs = (op != bitwise_op::bit_and);
+    const bool keep_rhs =
+        (op == bitwise_op::bit_or || op == bitwise_op::bit_xor);
+
+    auto lit = _chunks.begin();
+    auto rit = rhs._chunks.begin();
+
+    while (lit != _chunks.end() || rit != rhs._chunks.end()) {
+      if (rit == rhs._chunks.end() ||
+          (lit != _chunks.end() && lit->key < rit->key)) {
+        if (keep_lhs) {
+          result.push_back(std::move(*lit));
+        }
+        ++lit;
+      } else if (lit == _chunks.end() || rit->key < lit->key) {
+        if (keep_rhs && rit->key * chunk_bits < _count) {
+          result.push_back(*rit);
+        }
+        ++rit;
+      } else {
+        if (auto c = combine(*lit, *rit, op); c.cardinality != 0) {
+          result.push_back(std::move(c));
+        }
+        ++lit;
+        ++rit;
+      }
+    }
+
+    // Trim off any bits from rhs that are past our end
+    if (rhs._count > _count && !result.empty() &&
+        result.back().key == (_count - 1) / chunk_bits &&
+        _count % chunk_bits != 0) {
+      const auto last = static_cast<uint16_t>(_count % chunk_bits - 1);
+      auto runs = chunk_runs(result.back());
+
+      while (!runs.empty() && runs.back().first > last) {
+        runs.pop_back();
+      }
+
+      if (!runs.empty()) {
+        runs.back().last = std::min(runs.back().last, last);
+      }
+
+      result.back() = make_chunk(result.back().key, runs);
+
+      if (result.back().cardinality == 0) {
+        result.pop_back();
+      }
+    }
+
+    _chunks = std::move(result);
+
+    return *this;
+  }
+
+  /// Bitwise AND with another bitmap in place
+  compressed_bitmap& operator&=(const compressed_bitmap& rhs) {
+    return apply(bitwise_op::bit_and, rhs);
+  }
+
+  /// Bitwise OR with another bitmap in place
+  compressed_bitmap& operator|=(const compressed_bitmap& rhs) {
+    return apply(bitwise_op::bit_or, rhs);
+  }
+
+  /// Bitwise XOR with another bitmap in place
+  compressed_bitmap& operator^=(const compressed_bitmap& rhs) {
+    return apply(bitwise_op::bit_xor, rhs);
+  }
+
+  /// Clears every bit that is set in another bitmap in place
+  compressed_bitmap& and_not(const compressed_bitmap& rhs) {
+    return apply(bitwise_op::bit_and_not, rhs);
+  }
+
+ private:
+  static constexpr uint64_t chunk_words = chunk_bits / 64;
+
+  /// The most set bits that we'll store in an array container.  Any more would
+  /// take up more space than a bitset.
+  static constexpr uint64_t max_array_size = chunk_bits / 16;
+
+  /// An inclusive run of set bits within a chunk
+  struct run {
+    uint16_t first;  ///< The first set bit
+    uint16_t last;   ///< The last set bit
+  };
+
+  /// The set bits of a single chunk
+  struct chunk {
+    uint64_t key{};                  ///< The index of the chunk
+    container_type type{};           ///< The container holding the bits
+    uint32_t cardinality{};          ///< The number of set bits
+    std::vector<uint16_t> values{};  ///< Sorted positions of set bits (array)
+    std::vector<little_uint64_t> words{};  ///< Bits (bitset)
+    std::vector<run> runs{};               ///< Sorted runs of set bits (runs)
+  };
+
+  /// Returns the first stored chunk with a key that's not less than `key`
+  [[nodiscard]] std::vector<chunk>::const_iterator find_chunk(
+      uint64_t key) const noexcept {
+    return std::lower_bound(
+        _chunks.begin(), _chunks.end(), key,
+        [](const chunk& c, uint64_t k) noexcept { return c.key < k; });
+  }
+
+  /// Returns true if a bit is set in a chunk
+  [[nodiscard]] static bool chunk_contains(const chunk& c,
+                                           uint16_t low) noexcept {
+    switch (c.type) {
+      case container_type::array:
+        return std::binary_search(c.values.begin(), c.values.end(), low);
+      case container_type::bitset:
+        return (uint64_t{c.words[low / 64U]} >> (low % 64U)) & 1;
+      case container_type::runs: {
+        const auto it = std::lower_bound(
+            c.runs.begin(), c.runs.end(), low,
+            [](const run& r, uint16_t v) noexcept { return r.last < v; });
+        return it != c.runs.end() && it->first <= low;
+      }
+    }
+
+    YAT_UNREACHABLE();
+  }
+
+  /// Returns the position of the first set (or unset) bit in a chunk at or
+  /// after `low`, or `no_bits_left` if there are none
+  template <bool Set>
+  [[nodiscard]] static uint64_t chunk_find_next(const chunk& c,
+                                                uint16_t low) noexcept {
+    switch (c.type) {
+      case container_type::array: {
+        auto it = std::lower_bound(c.values.begin(), c.values.end(), low);
+
+        if constexpr (Set) {
+          return (it != c.values.end()) ? *it : no_bits_left;
+        } else {
+          uint64_t pos = low;
+
+          for (; it != c.values.end() && *it == pos; ++it) {
+            pos++;
+          }
+
+          return (pos < chunk_bits) ? pos : no_bits_left;
+        }
+      }
+      case container_type::bitset: {
+        const bitmap_view view{c.words.data(), chunk_bits};
+        return Set ? view.find_next_set(low) : view.find_next_clear(low);
+      }
+      case container_type::runs: {
+        const auto it = std::lower_bound(
+            c.runs.begin(), c.runs.end(), low,
+            [](const run& r, uint16_t v) noexcept { return r.last < v; });
+
+        if constexpr (Set) {
+          return (it != c.runs.end()) ? std::max(it->first, low)
+                                      : no_bits_left;
+        } else {
+          if (it == c.runs.end() || it->first > low) {
+            return low;
+          }
+
+          // Runs are never adjacent, so the bit after a run is always unset
+          return (uint64_t{it->last} + 1 < chunk_bits) ? uint64_t{it->last} + 1
+                                                       : no_bits_left;
+        }
+      }
+    }
+
+    YAT_UNREACHABLE();
+  }
+
+  /// Returns the runs of set bits in a chunk
+  [[nodiscard]] static std::vector<run> chunk_runs(const chunk& c) {
+    std::vector<run> runs{};
+
+    switch (c.type) {
+      case container_type::array:
+        for (const auto v : c.values) {
+          if (!runs.empty() && uint64_t{runs.back().last} + 1 == v) {
+            runs.back().last = v;
+          } else {
+            runs.push_back({v, v});
+          }
+        }
+        break;
+      case container_type::bitset: {
+        const bitmap_view view{c.words.data(), chunk_bits};
+
+        for (auto s = view.find_next_set(0); s != no_bits_left;) {
+          auto e = view.find_next_clear(s);
+
+          if (e == no_bits_left) {
+            e = chunk_bits;
+          }
+
+          runs.push_back({static_cast<uint16_t>(s),
+                          static_cast<uint16_t>(e - 1)});
+          s = view.find_next_set(e);
+        }
+        break;
+      }
+      case container_type::runs:
+        runs = c.runs;
+        break;
+    }
+
+    return runs;
+  }
+
+  /// Returns runs of set bits as a bitset
+  [[nodiscard]] static std::vector<little_uint64_t> runs_bitset(
+      const std::vector<run>& runs) {
+    std::vector<little_uint64_t> words(chunk_words);
+
+    for (const auto& r : runs) {
+      detail::visit_word_range(
+          r.first, uint64_t{r.last} - r.first + 1,
+          [&words](uint64_t w, uint64_t mask) {
+            words[w] = words[w] | mask;
+            return true;
+          },
+          [&words](uint64_t first, uint64_t last) {
+            std::fill(words.begin() + static_cast<ptrdiff_t>(first),
+                      words.begin() + static_cast<ptrdiff_t>(last),
+                      std::numeric_limits<uint64_t>::max());
+            return true;
+          });
+    }
+
+    return words;
+  }
+
+  /// Returns the bits of a chunk as a bitset
+  [[nodiscard]] static std::vector<little_uint64_t> chunk_bitset(
+      const chunk& c) {
+    return (c.type == container_type::bitset) ? c.words
+                                              : runs_bitset(chunk_runs(c));
+  }
+
+  /// Builds a chunk from runs of set bits, choosing the smallest container
+  [[nodiscard]] static chunk make_chunk(uint64_t key,
+                                        const std::vector<run>& runs) {
+    chunk c{};
+    c.key = key;
+
+    for (const auto& r : runs) {
+      c.cardinality += uint32_t{r.last} - r.first + 1;
+    }
+
+    const auto array_bytes = c.cardinality * sizeof(uint16_t);
+    const auto run_bytes = runs.size() * sizeof(run);
+    constexpr auto bitset_bytes = chunk_bits / 8;
+
+    if (run_bytes < std::min<uint64_t>(array_bytes, bitset_bytes)) {
+      c.type = container_type::runs;
+      c.runs = runs;
+    } else if (c.cardinality <= max_array_size) {
+      c.type = container_type::array;
+      c.values.reserve(c.cardinality);
+
+      for (const auto& r : runs) {
+        for (uint32_t v = r.first; v <= r.last; v++) {
+          c.values.push_back(static_cast<uint16_t>(v));
+        }
+      }
+    } else {
+      c.type = container_type::bitset;
+      c.words = runs_bitset(runs);
+    }
+
+    return c;
+  }
+
+  /// Builds a chunk from a bitset, choosing the smallest container
+  [[nodiscard]] static chunk make_chunk(uint64_t key,
+                                        std::vector<little_uint64_t>&& words) {
+    uint64_t cardinality = 0;
+    uint64_t num_runs = 0;
+    uint64_t carry = 0;
+
+    // Count the set bits and the number of runs that they form.  Each run
+    // starts with a set bit whose previous bit is unset.
+    for (const uint64_t w : words) {
+      cardinality += static_cast<uint64_t>(popcount(w));
+      num_runs += static_cast<uint64_t>(popcount(w & ~((w << 1) | carry)));
+      carry = w >> 63;
+    }
+
+    if (cardinality > max_array_size &&
+        num_runs * sizeof(run) >= chunk_bits / 8) {
+      chunk c{};
+      c.key = key;
+      c.type = container_type::bitset;
+      c.cardinality = static_cast<uint32_t>(cardinality);
+      c.words = std::move(words);
+      return c;
+    }
+
+    chunk tmp{};
+    tmp.type = container_type::bitset;
+    tmp.words = std::move(words);
+
+    return make_chunk(key, chunk_runs(tmp));
+  }
+
+  /// Builds a chunk from sorted positions of set bits
+  [[nodiscard]] static chunk make_chunk(uint64_t key,
+                                        const std::vector<uint16_t>& values) {
+    chunk tmp{};
+    tmp.type = container_type::array;
+    tmp.values = values;
+
+    return make_chunk(key, chunk_runs(tmp));
+  }
+
+  /// Applies a bitwise operation between two chunks with the same key
+  [[nodiscard]] static chunk combine(const chunk& lhs, const chunk& rhs,
+                                     bitwise_op op) {
+    using ct = container_type;
+
+    // Two arrays can be combined with the standard set algorithms
+    if (lhs.type == ct::array && rhs.type == ct::array) {
+      std::vector<uint16_t> values{};
+      const auto out = std::back_inserter(values);
+      const auto l = lhs.values.begin();
+      const auto le = lhs.values.end();
+      const auto r = rhs.values.begin();
+      const auto re = rhs.values.end();
+
+      switch (op) {
+        case bitwise_op::bit_and:
+          std::set_intersection(l, le, r, re, out);
+          break;
+        case bitwise_op::bit_or:
+          std::set_union(l, le, r, re, out);
+          break;
+        case bitwise_op::bit_xor:
+          std::set_symmetric_difference(l, le, r, re, out);
+          break;
+        case bitwise_op::bit_and_not:
+          std::set_difference(l, le, r, re, out);
+          break;
+      }
+
+      return make_chunk(lhs.key, values);
+    }
+
+    // Intersections and differences with an array can only contain values
+    // from that array, so we just need to probe the other container
+    if (lhs.type == ct::array &&
+        (op == bitwise_op::bit_and || op == bitwise_op::bit_and_not)) {
+      const bool keep = (op == bitwise_op::bit_and);
+      std::vector<uint16_t> values{};
+
+      for (const auto v : lhs.values) {
+        if (chunk_contains(rhs, v) == keep) {
+          values.push_back(v);
+        }
+      }
+
+      return make_chunk(lhs.key, values);
+    }
+
+    if (rhs.type == ct::array && op == bitwise_op::bit_and) {
+      return combine(rhs, lhs, op);
+    }
+
+    // If either side is a bitset then do the operation on bitsets
+    if (lhs.type == ct::bitset || rhs.type == ct::bitset) {
+      auto words = chunk_bitset(lhs);
+      const auto other = chunk_bitset(rhs);
+
+      detail::active_bitmap_kernels().bitwise(words.data(), other.data(),
+                                              chunk_words, op);
+
+      return make_chunk(lhs.key, std::move(words));
+    }
+
+    // Otherwise merge the runs of each chunk
+    const auto a = chunk_runs(lhs);
+    const auto b = chunk_runs(rhs);
+    std::vector<run> runs{};
+
+    size_t i = 0;
+    size_t j = 0;
+
+    for (uint64_t pos = 0; pos < chunk_bits;) {
+      while (i < a.size() && a[i].last < pos) {
+        i++;
+      }
+
+      while (j < b.size() && b[j].last < pos) {
+        j++;
+      }
+
+      const bool in_a = i < a.size() && a[i].first <= pos;
+      const bool in_b = j < b.size() && b[j].first <= pos;
+
+      // Find where the next run in either list starts or ends
+      const uint64_t next_a =
+          (i == a.size()) ? chunk_bits : (in_a ? a[i].last + 1U : a[i].first);
+      const uint64_t next_b =
+          (j == b.size()) ? chunk_bits : (in_b ? b[j].last + 1U : b[j].first);
+      const auto next = std::min(next_a, next_b);
+
+      if (detail::apply_bitwise_op(op, in_a, in_b) & 1) {
+        if (!runs.empty() && uint64_t{runs.back().last} + 1 == pos) {
+          runs.back().last = static_cast<uint16_t>(next - 1);
+        } else {
+          runs.push_back(
+              {static_cast<uint16_t>(pos), static_cast<uint16_t>(next - 1)});
+        }
+      }
+
+      pos = next;
+    }
+
+    return make_chunk(lhs.key, runs);
+  }
+
+  std::vector<chunk> _chunks{};  ///< Chunks that have bits set, sorted by key
+  uint64_t _count{};             ///< The number of bits in the bitmap
+};
+
+/// Returns the result of a bitwise operation between two compressed bitmaps.
+/// The result has the size of `lhs`.
+[[nodiscard]] inline compressed_bitmap apply(bitwise_op op,
+                                             const compressed_bitmap& lhs,
+                                             const compressed_bitmap& rhs) {
+  compressed_bitmap result{lhs};
+  result.apply(op, rhs);
+  return result;
+}
+
+/// Returns the bitwise AND of two compressed bitmaps
+[[nodiscard]] inline compressed_bitmap operator&(const compressed_bitmap& lhs,
+                                                 const compressed_bitmap& rhs) {
+  return apply(bitwise_op::bit_and, lhs, rhs);
+}
+
+/// Returns the bitwise OR of two compressed bitmaps
+[[nodiscard]] inline compressed_bitmap operator|(const compressed_bitmap& lhs,
+                                                 const compressed_bitmap& rhs) {
+  return apply(bitwise_op::bit_or, lhs, rhs);
+}
+
+/// Returns the bitwise XOR of two compressed bitmaps
+[[nodiscard]] inline compressed_bitmap operator^(const compressed_bitmap& lhs,
+                                                 const compressed_bitmap& rhs) {
+  return apply(bitwise_op::bit_xor, lhs, rhs);
+}
+
+/// Returns the bits of `lhs` that are not set in `rhs`
+[[nodiscard]] inline compressed_bitmap and_not(const compressed_bitmap& lhs,
+                                               const compressed_bitmap& rhs) {
+  return apply(bitwise_op::bit_and_not, lhs, rhs);
+}
+
+/// Scans a compressed bitmap for ranges of set (or unset) bits.  The ranges
+/// are the same as those that `bitmap_scanner` finds in the uncompressed
+/// bitmap, and runs that cross chunks are reported as a single range.
+class compressed_bitmap_scanner {
+  /// An iterator for compressed_bitmap_scanner that iterates through the
+  /// scanned ranges
+  class iterator {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = bitmap_range;
+    using difference_type = void;  // No meaningful way of taking difference
+    using pointer = const value_type*;
+    using reference = const value_type&;
+
+    /// Construct an empty iterator (this will compare with end())
+    constexpr iterator() noexcept {};  // clang 5 had a bug when using
+                                       // "= default" here
+
+    /// Construct an iterator from a scanner
+    explicit iterator(const compressed_bitmap_scanner* scanner)
+        : _scanner{scanner} {
+      next();
+    }
+
+    /// Equality operator
+    friend bool operator==(const iterator& lhs, const iterator& rhs) noexcept {
+      return (lhs._scanner == rhs._scanner) && (lhs._next == rhs._next);
+    }
+
+    /// Inequality operator
+    friend bool operator!=(const iterator& lhs, const iterator& rhs) noexcept {
+      return !(lhs == rhs);
+    }
+
+    /// Sentinel equality
+    bool operator==(const yat::default_sentinel_t&) const noexcept {
+      return _scanner == nullptr;
+    }
+
+    /// Dereference operator
+    reference operator*() const noexcept { return _range; }
+
+    /// Pointer dereference operator
+    pointer operator->() const noexcept { return &_range; }
+
+    /// Prefix increment operator
+    iterator& operator++() { return next(); }
+
+    /// Postfix increment operator
+    iterator operator++(int) {
+      iterator copy{*this};
+
+      operator++();
+
+      return copy;
+    }
+
+   private:
+    /// Get the next range
+    iterator& next() noexcept {
+      const auto& bm = *_scanner->_bm;
+      const bool scan_set = _scanner->_scan_set;
+
+      const auto s =
+          scan_set ? bm.find_next_set(_next) : bm.find_next_clear(_next);
+
+      if (s == compressed_bitmap::no_bits_left) {
+        *this = {};
+        return (*this);
+      }
+
+      auto e = scan_set ? bm.find_next_clear(s) : bm.find_next_set(s);
+
+      if (e == compressed_bitmap::no_bits_left) {
+        e = bm.count();
+      }
+
+      _range = {s, e - s};
+      _next = e;
+
+      return (*this);
+    }
+
+    const compressed_bitmap_scanner* _scanner{};  ///< Unowned scanner
+    uint64_t _next{};                             ///< The next bit to scan
+    value_type _range{};                          ///< The current range
+  };
+
+ public:
+  /// Creates a scanner for a compressed bitmap
+  ///
+  /// \param bm The bitmap to scan.  It must outlive the scanner.
+  /// \param scan_set Indicates that we're scanning for ranges of set bits
+  explicit compressed_bitmap_scanner(const compressed_bitmap& bm,
+                                     bool scan_set = true) noexcept
+      : _bm{&bm}, _scan_set{scan_set} {}
+
+  /// Returns an iterator to the start of the ranges
+  [[nodiscard]] iterator begin() const noexcept { return iterator{this}; }
+
+  /// Returns an iterator to the end of the ranges
+  [[nodiscard]] iterator end() const noexcept { return {}; }
+
+ private:
+  const compressed_bitmap* _bm;  ///< Unowned pointer to the bitmap
+  bool _scan_set;                ///< Scanning for ranges of set bits
+};
+
+}  // namespace yat
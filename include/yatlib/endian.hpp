@@ -59,14 +59,15 @@ class basic_endian_scalar {
   constexpr basic_endian_scalar() noexcept = default;
 
   // cppcheck-suppress noExplicitConstructor
-  basic_endian_scalar(const T& value) noexcept : _value{to_native(value)} {}
+  constexpr basic_endian_scalar(const T& value) noexcept
+      : _value{to_native(value)} {}
 
-  inline operator T() const noexcept { return to_native(_value); }
+  constexpr operator T() const noexcept { return to_native(_value); }
 
-  [[nodiscard]] inline T value() const noexcept { return to_native(_value); }
+  [[nodiscard]] constexpr T value() const noexcept { return to_native(_value); }
 
  private:
-  [[nodiscard]] YAT_PURE_FUNCTION static inline T to_native(
+  [[nodiscard]] YAT_PURE_FUNCTION static constexpr T to_native(
       const T& value) noexcept {
     if constexpr (Endianess == endian::native) {
       return value;
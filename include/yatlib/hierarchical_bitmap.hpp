@@ -0,0 +1,374 @@
+/*
+ * Copyright 2020 Joe T. Sylve, Ph.D.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "bit.hpp"
+#include "bitmap.hpp"
+
+namespace yat {
+
+/// A bitmap with a hierarchy of summaries that makes searching for set and
+/// unset bits O(log n).
+///
+/// The bits themselves are held in a `yat::bitmap`.  Each summary level has
+/// one "any set" and one "all set" bit for every word of the level below it,
+/// so each level is 64 times smaller than the last.  The summaries are kept up
+/// to date by every modification, and searches descend through them rather
+/// than scanning fully allocated or fully free stretches of words.
+class hierarchical_bitmap {
+  static constexpr uint64_t word_bits = std::numeric_limits<uint64_t>::digits;
+  static constexpr uint64_t all_ones = std::numeric_limits<uint64_t>::max();
+
+  /// Calculate the number of words we need to store n bits
+  static constexpr uint64_t cas(uint64_t n) noexcept {
+    return (n + word_bits - 1) / word_bits;
+  }
+
+ public:
+  /// Special marker that is returned when there are no bits left to scan
+  static constexpr uint64_t no_bits_left = bitmap_view::no_bits_left;
+
+  /// Create an empty bitmap
+  hierarchical_bitmap() noexcept {};  // clang 5 had a bug when using
+                                      // "= default" here
+
+  /// Create a bitmap with `n` unset bits
+  explicit hierarchical_bitmap(uint64_t n) : _bits{n} { build(); }
+
+  /// Create a bitmap that holds a copy of the bits in a view
+  explicit hierarchical_bitmap(const bitmap_view& view) : _bits{view} {
+    build();
+  }
+
+  /// Access a given bit.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  bool operator[](uint64_t n) const noexcept { return _bits[n]; }
+
+  /// Return the count of bits in the set
+  [[nodiscard]] uint64_t count() const noexcept { return _bits.count(); }
+
+  /// Returns the underlying bitmap, which can be viewed or scanned
+  [[nodiscard]] const bitmap& bits() const noexcept { return _bits; }
+
+  /// Set a given bit.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  void set(uint64_t n) {
+    _bits.set(n);
+    refresh(n / word_bits, n / word_bits);
+  }
+
+  /// Set a range of bits.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  void set(uint64_t start, uint64_t count) {
+    if (count != 0) {
+      _bits.set(start, count);
+      refresh(start / word_bits, (start + count - 1) / word_bits);
+    }
+  }
+
+  /// Clear a given bit.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  void clear(uint64_t n) {
+    _bits.clear(n);
+    refresh(n / word_bits, n / word_bits);
+  }
+
+  /// Clear a range of bits.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  void clear(uint64_t start, uint64_t count) {
+    if (count != 0) {
+      _bits.clear(start, count);
+      refresh(start / word_bits, (start + count - 1) / word_bits);
+    }
+  }
+
+  /// Flip a given bit.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  void flip(uint64_t n) {
+    _bits.flip(n);
+    refresh(n / word_bits, n / word_bits);
+  }
+
+  /// Flip a range of bits.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  void flip(uint64_t start, uint64_t count) {
+    if (count != 0) {
+      _bits.flip(start, count);
+      refresh(start / word_bits, (start + count - 1) / word_bits);
+    }
+  }
+
+  /// Returns true if every bit in the bitmap is set
+  [[nodiscard]] bool all_set() const noexcept {
+    return _all.empty() || _all.back()[0] == all_ones;
+  }
+
+  /// Returns true if any bit in the bitmap is set
+  [[nodiscard]] bool any_set() const noexcept {
+    return !_any.empty() && _any.back()[0] != 0;
+  }
+
+  /// Returns true if no bit in the bitmap is set
+  [[nodiscard]] bool none_set() const noexcept { return !any_set(); }
+
+  /// Returns the index of the first set bit at or after `first`, or
+  /// `no_bits_left` if there are none
+  [[nodiscard]] uint64_t find_next_set(uint64_t first) const noexcept {
+    return find_next<true>(first);
+  }
+
+  /// Returns the index of the first unset bit at or after `first`, or
+  /// `no_bits_left` if there are none
+  [[nodiscard]] uint64_t find_next_clear(uint64_t first) const noexcept {
+    return find_next<false>(first);
+  }
+
+  /// Returns the start of the first run of at least `length` set (or unset)
+  /// bits at or after `first`, or `no_bits_left` if there are none.  If the
+  /// run begins before `first`, `first` is returned.
+  [[nodiscard]] uint64_t find_first_run(uint64_t length, bool set,
+                                        uint64_t first = 0) const noexcept {
+    return set ? find_run<true>(length, first) : find_run<false>(length, first);
+  }
+
+  /// Returns the start of the first region of `length` bits at or after
+  /// `first` that has no more than `max_set` set bits, or `no_bits_left` if
+  /// there are none.
+  [[nodiscard]] uint64_t find_sparse_region(
+      uint64_t length, uint64_t max_set, uint64_t first = 0) const noexcept {
+    const auto last = count();
+
+    while (first <= last && last - first >= length) {
+      const auto end = first + length;
+      const auto head = find_next<true>(first);
+
+      if (head == no_bits_left || head >= end) {
+        return first;
+      }
+
+      // Count the set bits in the region a run at a time, stopping as soon as
+      // there are too many
+      const auto head_end = end_of_run<true>(head);
+      auto n = std::min(head_end, end) - head;
+
+      for (auto p = head_end; n <= max_set;) {
+        p = find_next<true>(p);
+
+        if (p == no_bits_left || p >= end) {
+          break;
+        }
+
+        const auto run_end = end_of_run<true>(p);
+        n += std::min(run_end, end) - p;
+        p = run_end;
+      }
+
+      if (n <= max_set) {
+        return first;
+      }
+
+      // Every region that starts at or before `head` has at least as many set
+      // bits as this one, and every region that starts inside the run at
+      // `head` with more than `max_set` bits of it left is too dense as well
+      first = std::max(head + 1, (head_end > max_set) ? head_end - max_set : 0);
+    }
+
+    return no_bits_left;
+  }
+
+ private:
+  /// Returns a word of the bitmap.  If `Set` is false the word is inverted so
+  /// that we can always search for set bits.  Bits beyond the end of the
+  /// bitmap are cleared.
+  template <bool Set>
+  [[nodiscard]] uint64_t leaf(uint64_t w) const noexcept {
+    const auto words = bitmap_view{_bits}.words();
+    uint64_t v = Set ? uint64_t{words[w]} : ~uint64_t{words[w]};
+
+    if (w + 1 == words.size()) {
+      if (const auto n = count() % word_bits; n != 0) {
+        v &= detail::word_mask(0, n);
+      }
+    }
+
+    return v;
+  }
+
+  /// Returns the number of children that are summarized by a level
+  [[nodiscard]] uint64_t children(size_t level) const noexcept {
+    return (level == 0) ? bitmap_view{_bits}.words().size()
+                        : _any[level - 1].size();
+  }
+
+  /// Allocates and computes all of the summary levels
+  void build() {
+    _any.clear();
+    _all.clear();
+
+    for (auto n = cas(count()); n != 0; n = (n == 1) ? 0 : cas(n)) {
+      const auto size = cas(n);
+
+      _any.emplace_back(size);
+      _all.emplace_back(size);
+
+      // Children that don't exist are treated as being completely set so that
+      // they never show up as having unset bits
+      if (const auto tail = n % word_bits; tail != 0) {
+        _all.back().back() = ~detail::word_mask(0, tail);
+      }
+    }
+
+    if (!_any.empty()) {
+      refresh(0, children(0) - 1);
+    }
+  }
+
+  /// Recomputes the summaries for the words [first, last] of the bitmap
+  void refresh(uint64_t first, uint64_t last) noexcept {
+    for (size_t level = 0; level < _any.size(); level++) {
+      auto& any = _any[level];
+      auto& all = _all[level];
+
+      for (auto c = first; c <= last; c++) {
+        bool child_any{};
+        bool child_all{};
+
+        if (level == 0) {
+          child_any = leaf<true>(c) != 0;
+          child_all = leaf<false>(c) == 0;
+        } else {
+          child_any = _any[level - 1][c] != 0;
+          child_all = _all[level - 1][c] == all_ones;
+        }
+
+        const auto w = c / word_bits;
+        const auto bit = uint64_t{1} << (c % word_bits);
+
+        any[w] = child_any ? (any[w] | bit) : (any[w] & ~bit);
+        all[w] = child_all ? (all[w] | bit) : (all[w] & ~bit);
+      }
+
+      first /= word_bits;
+      last /= word_bits;
+    }
+  }
+
+  /// Returns the first child at or after `i` in a level that has any set (or
+  /// any unset) bits, or `no_bits_left` if there are none
+  template <bool Set>
+  [[nodiscard]] uint64_t next_marked(size_t level, uint64_t i) const noexcept {
+    while (i < children(level)) {
+      const auto w = i / word_bits;
+      const auto marked = Set ? _any[level][w] : ~_all[level][w];
+
+      if (const auto bits = marked & ~detail::word_mask(0, i % word_bits);
+          bits != 0) {
+        return w * word_bits + static_cast<uint64_t>(countr_zero(bits));
+      }
+
+      // Nothing is marked in the rest of this word, so ask the level above for
+      // the next word that has something marked
+      if (level + 1 == _any.size()) {
+        return no_bits_left;
+      }
+
+      const auto next = next_marked<Set>(level + 1, w + 1);
+
+      if (next == no_bits_left) {
+        return no_bits_left;
+      }
+
+      i = next * word_bits;
+    }
+
+    return no_bits_left;
+  }
+
+  /// Returns the index of the first set (or unset) bit at or after `first`, or
+  /// `no_bits_left` if there are none
+  template <bool Set>
+  [[nodiscard]] uint64_t find_next(uint64_t first) const noexcept {
+    if (first >= count()) {
+      return no_bits_left;
+    }
+
+    auto w = first / word_bits;
+    const auto head = leaf<Set>(w) & ~detail::word_mask(0, first % word_bits);
+
+    if (head != 0) {
+      return w * word_bits + static_cast<uint64_t>(countr_zero(head));
+    }
+
+    w = next_marked<Set>(0, w + 1);
+
+    if (w == no_bits_left) {
+      return no_bits_left;
+    }
+
+    return w * word_bits + static_cast<uint64_t>(countr_zero(leaf<Set>(w)));
+  }
+
+  /// Returns the index of the first bit after `first` that differs from the
+  /// set (or unset) bit at `first`, or the size of the bitmap if there is none
+  template <bool Set>
+  [[nodiscard]] uint64_t end_of_run(uint64_t first) const noexcept {
+    const auto end = find_next<!Set>(first);
+    return (end == no_bits_left) ? count() : end;
+  }
+
+  /// Returns the start of the first run of at least `length` set (or unset)
+  /// bits at or after `first`, or `no_bits_left` if there are none
+  template <bool Set>
+  [[nodiscard]] uint64_t find_run(uint64_t length,
+                                  uint64_t first) const noexcept {
+    const auto last = count();
+
+    if (length == 0) {
+      return (first <= last) ? first : no_bits_left;
+    }
+
+    while (first < last && last - first >= length) {
+      const auto start = find_next<Set>(first);
+
+      if (start == no_bits_left || last - start < length) {
+        return no_bits_left;
+      }
+
+      // Finding the end of the run descends through the summaries, so long
+      // runs and long gaps between candidates are both skipped in O(log n)
+      const auto end = end_of_run<Set>(start);
+
+      if (end - start >= length) {
+        return start;
+      }
+
+      first = end;
+    }
+
+    return no_bits_left;
+  }
+
+  bitmap _bits{};                           ///< The summarized bits
+  std::vector<std::vector<uint64_t>> _any{};  ///< "any set" summary levels
+  std::vector<std::vector<uint64_t>> _all{};  ///< "all set" summary levels
+};
+
+}  // namespace yat
@@ -0,0 +1,430 @@
+/*
+ * Copyright 2020 Joe T. Sylve, Ph.D.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <limits>
+#include <system_error>
+#include <utility>
+
+#include "bitmap.hpp"
+#include "filesystem.hpp"
+
+#if __has_include(<sys/mman.h>) && __has_include(<unistd.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define YAT_INTERNAL_HAS_MMAP
+#endif
+
+namespace yat {
+
+/// Options that control how the pages of a mapped bitmap are accessed
+struct mapped_bitmap_options {
+  /// Advise the kernel that the bitmap will be read sequentially, so that it
+  /// reads ahead aggressively and drops pages once they've been read
+  bool sequential{true};
+
+  /// Advise the kernel to back the mapping with huge pages where it can
+  bool huge_pages{true};
+};
+
+namespace detail {
+
+/// An owned memory mapping of a region of a file
+class file_mapping {
+ public:
+  /// Create an empty mapping
+  file_mapping() noexcept {};  // clang 5 had a bug when using "= default" here
+
+  /// Maps `length` bytes of a file starting at `offset`.  Writable mappings
+  /// are shared with the file and extend it if it is too short.  Read-only
+  /// mappings require the file to hold at least `required` bytes past
+  /// `offset`.
+  file_mapping(const filesystem::path& path, uint64_t offset, uint64_t length,
+               uint64_t required, bool writable,
+               const mapped_bitmap_options& options,
+               std::error_code& ec) noexcept {
+    ec.clear();
+
+#ifdef YAT_INTERNAL_HAS_MMAP
+    const int flags = writable ? (O_RDWR | O_CREAT) : O_RDONLY;
+    const int fd = ::open(path.c_str(), flags | O_CLOEXEC, 0644);
+
+    if (fd < 0) {
+      ec.assign(errno, std::system_category());
+      return;
+    }
+
+    struct stat st {};
+
+    if (::fstat(fd, &st) != 0) {
+      ec.assign(errno, std::system_category());
+      ::close(fd);
+      return;
+    }
+
+    const auto file_size = static_cast<uint64_t>(st.st_size);
+
+    if (file_size < offset + required) {
+      if (!writable ||
+          ::ftruncate(fd, static_cast<off_t>(offset + required)) != 0) {
+        ec = writable ? std::error_code{errno, std::system_category()}
+                      : std::make_error_code(std::errc::invalid_argument);
+        ::close(fd);
+        return;
+      }
+    }
+
+    if (length == 0) {
+      ::close(fd);
+      return;
+    }
+
+    // Mappings have to start on a page boundary
+    const auto page_size = static_cast<uint64_t>(::sysconf(_SC_PAGESIZE));
+    const auto aligned = offset / page_size * page_size;
+
+    _length = offset - aligned + length;
+
+    const int prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    void* base = ::mmap(nullptr, _length, prot, MAP_SHARED, fd,
+                        static_cast<off_t>(aligned));
+
+    if (base == MAP_FAILED) {
+      ec.assign(errno, std::system_category());
+      ::close(fd);
+      _length = 0;
+      return;
+    }
+
+    // The mapping keeps its own reference to the file
+    ::close(fd);
+
+    _base = base;
+    _data = static_cast<char*>(base) + (offset - aligned);
+
+    // Advice is only a hint, so failing to apply it isn't an error
+    if (options.sequential) {
+      ::madvise(_base, _length, MADV_SEQUENTIAL);
+    }
+
+#ifdef MADV_HUGEPAGE
+    if (options.huge_pages) {
+      ::madvise(_base, _length, MADV_HUGEPAGE);
+    }
+#endif
+#else
+    (void)path;
+    (void)offset;
+    (void)length;
+    (void)required;
+    (void)writable;
+    (void)options;
+
+    ec = std::make_error_code(std::errc::not_supported);
+#endif  // YAT_INTERNAL_HAS_MMAP
+  }
+
+  file_mapping(const file_mapping&) = delete;
+  file_mapping& operator=(const file_mapping&) = delete;
+
+  /// Move constructor
+  file_mapping(file_mapping&& other) noexcept
+      : _base{std::exchange(other._base, nullptr)},
+        _data{std::exchange(other._data, nullptr)},
+        _length{std::exchange(other._length, 0)} {}
+
+  /// Move assignment operator
+  file_mapping& operator=(file_mapping&& other) noexcept {
+    if (this != &other) {
+      unmap();
+      _base = std::exchange(other._base, nullptr);
+      _data = std::exchange(other._data, nullptr);
+      _length = std::exchange(other._length, 0);
+    }
+
+    return *this;
+  }
+
+  /// Unmaps the region
+  ~file_mapping() noexcept { unmap(); }
+
+  /// Returns a pointer to the start of the mapped region
+  [[nodiscard]] void* data() const noexcept { return _data; }
+
+  /// Writes any changes back to the file
+  void sync(std::error_code& ec) noexcept {
+    ec.clear();
+
+#ifdef YAT_INTERNAL_HAS_MMAP
+    if (_base != nullptr && ::msync(_base, _length, MS_SYNC) != 0) {
+      ec.assign(errno, std::system_category());
+    }
+#endif
+  }
+
+ private:
+  void unmap() noexcept {
+#ifdef YAT_INTERNAL_HAS_MMAP
+    if (_base != nullptr) {
+      ::munmap(_base, _length);
+    }
+#endif
+  }
+
+  void* _base{};     ///< The start of the mapping
+  void* _data{};     ///< The start of the requested region
+  size_t _length{};  ///< The length of the mapping
+};
+
+/// Checks the arguments to a mapped bitmap
+inline bool check_mapped_bitmap_offset(uint64_t byte_offset,
+                                       std::error_code& ec) noexcept {
+  // The bitmap is read one 64-bit word at a time
+  if (byte_offset % sizeof(little_uint64_t) != 0) {
+    ec = std::make_error_code(std::errc::invalid_argument);
+    return false;
+  }
+
+  return true;
+}
+
+/// Throws a filesystem error if there is an error
+inline void throw_if_mapping_failed(const char* what,
+                                    const filesystem::path& path,
+                                    const std::error_code& ec) {
+  if (ec) {
+    throw filesystem::filesystem_error(what, path, ec);
+  }
+}
+
+}  // namespace detail
+
+/// A read-only view of a bitmap that is stored in a file.
+///
+/// Rather than reading the file into memory, the bitmap is mapped directly
+/// from the page cache, so it can be viewed and scanned without making a copy.
+class mapped_bitmap_view : public bitmap_view {
+ public:
+  /// Create an empty view
+  mapped_bitmap_view() noexcept : bitmap_view{nullptr, 0} {}
+
+  /// Maps `num_bits` bits of a file starting at `byte_offset`, which must be a
+  /// multiple of 8.  Throws `filesystem::filesystem_error` on failure.
+  mapped_bitmap_view(const filesystem::path& path, uint64_t byte_offset,
+                     uint64_t num_bits,
+                     const mapped_bitmap_options& options = {})
+      : mapped_bitmap_view{} {
+    std::error_code ec{};
+    *this = mapped_bitmap_view{path, byte_offset, num_bits, options, ec};
+    detail::throw_if_mapping_failed("yat::mapped_bitmap_view", path, ec);
+  }
+
+  /// Maps `num_bits` bits of a file starting at `byte_offset`, which must be a
+  /// multiple of 8.  On failure `ec` is set and the view is empty.
+  mapped_bitmap_view(const filesystem::path& path, uint64_t byte_offset,
+                     uint64_t num_bits, const mapped_bitmap_options& options,
+                     std::error_code& ec) noexcept
+      : mapped_bitmap_view{} {
+    ec.clear();
+
+    if (!detail::check_mapped_bitmap_offset(byte_offset, ec)) {
+      return;
+    }
+
+    _mapping = detail::file_mapping{path,
+                                    byte_offset,
+                                    cas(num_bits) * sizeof(storage_type),
+                                    (num_bits + 7) / 8,
+                                    false,
+                                    options,
+                                    ec};
+
+    if (!ec) {
+      static_cast<bitmap_view&>(*this) = bitmap_view{_mapping.data(), num_bits};
+    }
+  }
+
+  mapped_bitmap_view(const mapped_bitmap_view&) = delete;
+  mapped_bitmap_view& operator=(const mapped_bitmap_view&) = delete;
+
+  /// Move constructor.  `other` is left empty, since the mapping that it
+  /// viewed now belongs to this view.
+  mapped_bitmap_view(mapped_bitmap_view&& other) noexcept
+      : bitmap_view{std::exchange(static_cast<bitmap_view&>(other),
+                                  bitmap_view{nullptr, 0})},
+        _mapping{std::move(other._mapping)} {}
+
+  /// Move assignment operator.  `other` is left empty.
+  mapped_bitmap_view& operator=(mapped_bitmap_view&& other) noexcept {
+    if (this != &other) {
+      static_cast<bitmap_view&>(*this) = std::exchange(
+          static_cast<bitmap_view&>(other), bitmap_view{nullptr, 0});
+      _mapping = std::move(other._mapping);
+    }
+
+    return *this;
+  }
+
+ private:
+  detail::file_mapping _mapping{};  ///< The mapped file
+};
+
+/// A bitmap that is stored in a file that is mapped into memory.
+///
+/// Changes are written to the shared mapping, so they make their way back to
+/// the file without any explicit I/O.  Call `sync()` to wait until they have
+/// been written.
+class mapped_bitmap {
+  using storage_type = yat::little_uint64_t;
+  static constexpr uint64_t storage_bits =
+      std::numeric_limits<storage_type::value_type>::digits;
+
+ public:
+  /// Create an empty bitmap
+  mapped_bitmap() noexcept {};  // clang 5 had a bug when using "= default"
+                                // here
+
+  /// Maps `num_bits` bits of a file starting at `byte_offset`, which must be a
+  /// multiple of 8.  The file is created or extended with unset bits if it is
+  /// too short.  Throws `filesystem::filesystem_error` on failure.
+  mapped_bitmap(const filesystem::path& path, uint64_t byte_offset,
+                uint64_t num_bits, const mapped_bitmap_options& options = {}) {
+    std::error_code ec{};
+    *this = mapped_bitmap{path, byte_offset, num_bits, options, ec};
+    detail::throw_if_mapping_failed("yat::mapped_bitmap", path, ec);
+  }
+
+  /// Maps `num_bits` bits of a file starting at `byte_offset`, which must be a
+  /// multiple of 8.  The file is created or extended with unset bits if it is
+  /// too short.  On failure `ec` is set and the bitmap is empty.
+  mapped_bitmap(const filesystem::path& path, uint64_t byte_offset,
+                uint64_t num_bits, const mapped_bitmap_options& options,
+                std::error_code& ec) noexcept {
+    ec.clear();
+
+    if (!detail::check_mapped_bitmap_offset(byte_offset, ec)) {
+      return;
+    }
+
+    const auto length = (num_bits + storage_bits - 1) / storage_bits *
+                        sizeof(storage_type);
+
+    _mapping = detail::file_mapping{
+        path, byte_offset, length, length, true, options, ec};
+
+    if (!ec) {
+      _storage = static_cast<storage_type*>(_mapping.data());
+      _count = num_bits;
+    }
+  }
+
+  mapped_bitmap(const mapped_bitmap&) = delete;
+  mapped_bitmap& operator=(const mapped_bitmap&) = delete;
+
+  /// Move constructor.  `other` is left empty, since the mapping that it
+  /// pointed into now belongs to this bitmap.
+  mapped_bitmap(mapped_bitmap&& other) noexcept
+      : _mapping{std::move(other._mapping)},
+        _storage{std::exchange(other._storage, nullptr)},
+        _count{std::exchange(other._count, 0)} {}
+
+  /// Move assignment operator.  `other` is left empty.
+  mapped_bitmap& operator=(mapped_bitmap&& other) noexcept {
+    if (this != &other) {
+      _mapping = std::move(other._mapping);
+      _storage = std::exchange(other._storage, nullptr);
+      _count = std::exchange(other._count, 0);
+    }
+
+    return *this;
+  }
+
+  /// Returns a view of the bitmap
+  [[nodiscard]] bitmap_view view() const noexcept {
+    return bitmap_view{_storage, _count};
+  }
+
+  /// Converts the bitmap to a view
+  operator bitmap_view() const noexcept { return view(); }
+
+  /// Access a given bit.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  bool operator[](uint64_t n) const noexcept {
+    return (_storage[n / storage_bits] & (uint64_t{1} << (n % storage_bits))) !=
+           0;
+  }
+
+  /// Return the count of bits in the set
+  [[nodiscard]] uint64_t count() const noexcept { return _count; }
+
+  /// Set a given bit.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  void set(uint64_t n) noexcept { detail::set_bits(_storage, n, 1); }
+
+  /// Set a range of bits.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  void set(uint64_t start, uint64_t count) noexcept {
+    detail::set_bits(_storage, start, count);
+  }
+
+  /// Clear a given bit.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  void clear(uint64_t n) noexcept { detail::clear_bits(_storage, n, 1); }
+
+  /// Clear a range of bits.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  void clear(uint64_t start, uint64_t count) noexcept {
+    detail::clear_bits(_storage, start, count);
+  }
+
+  /// Flip a given bit.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  void flip(uint64_t n) noexcept { detail::flip_bits(_storage, n, 1); }
+
+  /// Flip a range of bits.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  void flip(uint64_t start, uint64_t count) noexcept {
+    detail::flip_bits(_storage, start, count);
+  }
+
+  /// Waits for all changes to be written to the file.  Throws
+  /// `std::system_error` on failure.
+  void sync() {
+    std::error_code ec{};
+    sync(ec);
+
+    if (ec) {
+      throw std::system_error(ec, "yat::mapped_bitmap::sync");
+    }
+  }
+
+  /// Waits for all changes to be written to the file
+  void sync(std::error_code& ec) noexcept { _mapping.sync(ec); }
+
+ private:
+  detail::file_mapping _mapping{};  ///< The mapped file
+  storage_type* _storage{};         ///< The mapped bits
+  uint64_t _count{};                ///< Number of bits in the bitmap
+};
+
+}  // namespace yat
+
+#undef YAT_INTERNAL_HAS_MMAP
@@ -0,0 +1,242 @@
+/*
+ * Copyright 2020 Joe T. Sylve, Ph.D.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "bitmap.hpp"
+#include "span.hpp"
+#include "type_traits.hpp"
+
+namespace yat {
+
+/// Options that control how a bitmap is scanned in parallel
+struct parallel_scan_options {
+  /// Indicates that we're scanning for ranges of set bits
+  bool scan_set{true};
+
+  /// The number of threads to scan with, including the calling thread.  Zero
+  /// uses `std::thread::hardware_concurrency()`.
+  size_t num_threads{};
+
+  /// The number of bits in each chunk of work.  This is rounded up to a
+  /// multiple of 512 so that chunks never share a cache line.
+  uint64_t chunk_bits{uint64_t{1} << 22};
+};
+
+namespace detail {
+
+/// Scans the ranges that start within the bits [first, last) of a view.
+///
+/// A range that continues from the previous chunk belongs to that chunk, so it
+/// is skipped, and a range that runs past `last` is followed to its real end.
+/// This lets every chunk be scanned independently while still producing
+/// exactly the same ranges as a serial scan.
+inline void scan_bitmap_chunk(const bitmap_view& view, uint64_t first,
+                              uint64_t last, bool scan_set,
+                              std::vector<bitmap_range>& ranges) {
+  const bitmap_scanner scanner{view, first, last, scan_set};
+
+  for (auto range : scanner) {
+    if (range.start == first && first != 0 && view[first - 1] == scan_set) {
+      continue;
+    }
+
+    if (range.start + range.count == last && last != view.count()) {
+      const auto end = scan_set ? view.find_next_clear(last)
+                                : view.find_next_set(last);
+
+      range.count =
+          ((end == bitmap_view::no_bits_left) ? view.count() : end) -
+          range.start;
+    }
+
+    ranges.push_back(range);
+  }
+}
+
+/// Returns the number of bits in each chunk of a parallel scan
+[[nodiscard]] constexpr uint64_t parallel_scan_chunk_bits(
+    const parallel_scan_options& options) noexcept {
+  return std::max<uint64_t>((options.chunk_bits + 511) / 512 * 512, 512);
+}
+
+/// Runs `fn(chunk, first, last)` for every chunk of a bitmap with `num_bits`
+/// bits on a pool of threads.  If any call throws, the remaining chunks are
+/// skipped and the first exception is rethrown on the calling thread.
+template <typename Fn>
+void for_each_bitmap_chunk(uint64_t num_bits,
+                           const parallel_scan_options& options, Fn&& fn) {
+  const auto chunk_bits = parallel_scan_chunk_bits(options);
+  const auto num_chunks = (num_bits + chunk_bits - 1) / chunk_bits;
+
+  size_t num_threads = options.num_threads;
+
+  if (num_threads == 0) {
+    num_threads = std::max(std::thread::hardware_concurrency(), 1U);
+  }
+
+  if (num_threads > num_chunks) {
+    num_threads = num_chunks;
+  }
+
+  std::atomic<uint64_t> next_chunk{0};
+  std::atomic<bool> failed{false};
+  std::exception_ptr error{};
+  std::mutex error_mutex{};
+
+  // Chunks are handed out one at a time so that threads that get chunks that
+  // are quick to scan move on to the next one
+  const auto worker = [&]() {
+    for (auto chunk = next_chunk++; chunk < num_chunks && !failed;
+         chunk = next_chunk++) {
+      const auto first = chunk * chunk_bits;
+      const auto last = std::min(first + chunk_bits, num_bits);
+
+      try {
+        fn(chunk, first, last);
+      } catch (...) {
+        const std::lock_guard<std::mutex> lock{error_mutex};
+
+        if (!failed.exchange(true)) {
+          error = std::current_exception();
+        }
+      }
+    }
+  };
+
+  std::vector<std::thread> threads{};
+
+  for (size_t i = 1; i < num_threads; i++) {
+    threads.emplace_back(worker);
+  }
+
+  worker();
+
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+}  // namespace detail
+
+/// Scans a bitmap for ranges of set (or unset) bits on multiple threads and
+/// returns them in order.  The ranges are exactly those that a
+/// `bitmap_scanner` would find, including ranges that span chunks.
+[[nodiscard]] inline std::vector<bitmap_range> parallel_scan(
+    const bitmap_view& view, const parallel_scan_options& options = {}) {
+  const auto chunk_bits = detail::parallel_scan_chunk_bits(options);
+  std::vector<std::vector<bitmap_range>> chunks(
+      (view.count() + chunk_bits - 1) / chunk_bits);
+
+  detail::for_each_bitmap_chunk(
+      view.count(), options,
+      [&](uint64_t chunk, uint64_t first, uint64_t last) {
+        detail::scan_bitmap_chunk(view, first, last, options.scan_set,
+                                  chunks[chunk]);
+      });
+
+  size_t total = 0;
+  for (const auto& c : chunks) {
+    total += c.size();
+  }
+
+  std::vector<bitmap_range> ranges{};
+  ranges.reserve(total);
+
+  for (const auto& c : chunks) {
+    ranges.insert(ranges.end(), c.begin(), c.end());
+  }
+
+  return ranges;
+}
+
+/// Scans a bitmap for ranges of set (or unset) bits on multiple threads,
+/// calling `fn(chunk, ranges)` with the ranges that start in each chunk.
+///
+/// A range that spans chunks is reported whole by the chunk that it starts
+/// in, so the ranges of all of the chunks in chunk order are exactly those
+/// that a `bitmap_scanner` would find.  `fn` is called concurrently from
+/// several threads and in no particular order.  `ranges` is only valid for
+/// the duration of the call.
+template <typename Fn>
+void parallel_scan(const bitmap_view& view, Fn&& fn,
+                   const parallel_scan_options& options = {}) {
+  detail::for_each_bitmap_chunk(
+      view.count(), options,
+      [&](uint64_t chunk, uint64_t first, uint64_t last) {
+        std::vector<bitmap_range> ranges{};
+
+        detail::scan_bitmap_chunk(view, first, last, options.scan_set, ranges);
+        fn(chunk, span<const bitmap_range>{ranges.data(), ranges.size()});
+      });
+}
+
+/// Builds a bitmap with a bit for each value that is set if `pred(value)` is
+/// true on multiple threads.  Each thread packs whole words of a separate
+/// chunk, so `pred` is called concurrently and in no particular order.  Only
+/// `num_threads` and `chunk_bits` of the options are used.
+template <typename T, typename Pred>
+[[nodiscard]] bitmap parallel_from_predicate(
+    yat::span<T> values, Pred&& pred,
+    const parallel_scan_options& options = {}) {
+  bitmap bm{values.size()};
+
+  detail::for_each_bitmap_chunk(
+      values.size(), options, [&](uint64_t, uint64_t first, uint64_t last) {
+        bm.assign_predicate(
+            first,
+            values.subspan(static_cast<size_t>(first),
+                           static_cast<size_t>(last - first)),
+            pred);
+      });
+
+  return bm;
+}
+
+/// Builds a bitmap with a bit for each value that is set if `value op rhs` is
+/// true on multiple threads (see parallel_from_predicate)
+template <typename T>
+[[nodiscard]] bitmap parallel_from_compare(
+    yat::span<T> values, compare_op op,
+    const yat::type_identity_t<std::remove_const_t<T>>& rhs,
+    const parallel_scan_options& options = {}) {
+  bitmap bm{values.size()};
+
+  detail::for_each_bitmap_chunk(
+      values.size(), options, [&](uint64_t, uint64_t first, uint64_t last) {
+        bm.assign_compare(first,
+                          values.subspan(static_cast<size_t>(first),
+                                         static_cast<size_t>(last - first)),
+                          op, rhs);
+      });
+
+  return bm;
+}
+
+}  // namespace yat
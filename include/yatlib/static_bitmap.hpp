@@ -0,0 +1,404 @@
+/*
+ * Copyright 2020 Joe T. Sylve, Ph.D.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+
+#include "bit.hpp"
+#include "bitmap.hpp"
+#include "endian.hpp"
+#include "span.hpp"
+
+namespace yat {
+
+/// A bitmap with a fixed number of bits that are stored inline.
+///
+/// This has the same bit layout as `yat::bitmap`, so it converts to a
+/// `yat::bitmap_view` without copying, but never allocates and can be used in
+/// constant expressions.  It supports the same range operations and queries as
+/// `yat::bitmap`, which work a word at a time.
+template <uint64_t N>
+class static_bitmap {
+  using storage_type = yat::little_uint64_t;
+  static constexpr uint64_t storage_bits =
+      std::numeric_limits<storage_type::value_type>::digits;
+
+  /// The number of storage words
+  static constexpr size_t num_words =
+      static_cast<size_t>((N + storage_bits - 1) / storage_bits);
+
+  /// Calculate the storage index
+  static constexpr size_t si(uint64_t n) noexcept {
+    return static_cast<size_t>(n / storage_bits);
+  }
+
+  /// Calculate the bit index into the storage
+  static constexpr uint64_t bi(uint64_t n) noexcept { return n % storage_bits; }
+
+  /// Calculate the bitmask for an index
+  static constexpr uint64_t bm(uint64_t n) noexcept {
+    return uint64_t{1} << bi(n);
+  }
+
+ public:
+  /// Special marker that is returned when there are no bits left to scan
+  static constexpr uint64_t no_bits_left = bitmap_view::no_bits_left;
+
+  /// Create a bitmap with every bit unset
+  constexpr static_bitmap() noexcept {};  // clang 5 had a bug when using
+                                          // "= default" here
+
+  /// Create a bitmap that holds a copy of the first N bits of a view.  If the
+  /// view has fewer bits, the rest are unset.
+  explicit static_bitmap(const bitmap_view& view) noexcept {
+    const auto n = std::min<size_t>(
+        (view.count() + storage_bits - 1) / storage_bits, num_words);
+
+    for (size_t w = 0; w < n; w++) {
+      _words[w] = view.word(w);
+    }
+
+    // Clear the bits beyond the end of the view, including any in the last
+    // word beyond the end of this bitmap
+    const auto count = std::min(view.count(), N);
+    clear(count, num_words * storage_bits - count);
+  }
+
+  /// Access a given bit.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  constexpr bool operator[](uint64_t n) const noexcept {
+    return (_words[si(n)] & bm(n)) != 0;
+  }
+
+  /// Returns the number of bits in the bitmap
+  [[nodiscard]] static constexpr uint64_t count() noexcept { return N; }
+
+  /// Returns the underlying storage words
+  [[nodiscard]] constexpr yat::span<const storage_type> words() const noexcept {
+    return _words;
+  }
+
+  /// Returns a view of the bits
+  [[nodiscard]] bitmap_view view() const noexcept {
+    return {_words.data(), N};
+  }
+
+  /// Returns a view of the bits
+  operator bitmap_view() const noexcept { return view(); }
+
+  /// Set a given bit.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  constexpr void set(uint64_t n) noexcept {
+    auto& val = _words[si(n)];
+    val = val | bm(n);
+  }
+
+  /// Set a range of bits.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  constexpr void set(uint64_t start, uint64_t count) noexcept {
+    modify(start, count, [](uint64_t w, uint64_t mask) { return w | mask; });
+  }
+
+  /// Clear a given bit.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  constexpr void clear(uint64_t n) noexcept {
+    auto& val = _words[si(n)];
+    val = val & ~bm(n);
+  }
+
+  /// Clear a range of bits.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  constexpr void clear(uint64_t start, uint64_t count) noexcept {
+    modify(start, count, [](uint64_t w, uint64_t mask) { return w & ~mask; });
+  }
+
+  /// Flip a given bit.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  constexpr void flip(uint64_t n) noexcept {
+    auto& val = _words[si(n)];
+    val = val ^ bm(n);
+  }
+
+  /// Flip a range of bits.  No bounds checking is performed and accessing an
+  /// invalid index is undefined behavior.
+  constexpr void flip(uint64_t start, uint64_t count) noexcept {
+    modify(start, count, [](uint64_t w, uint64_t mask) { return w ^ mask; });
+  }
+
+  /// Returns true if every bit in the bitmap is set
+  [[nodiscard]] constexpr bool all_set() const noexcept {
+    return all_set(0, N);
+  }
+
+  /// Returns true if every bit in a range is set.  No bounds checking is
+  /// performed and accessing an invalid index is undefined behavior.
+  [[nodiscard]] constexpr bool all_set(uint64_t start,
+                                       uint64_t count) const noexcept {
+    return query(start, count, [](uint64_t w, uint64_t mask) {
+      return (w & mask) == mask;
+    });
+  }
+
+  /// Returns true if any bit in the bitmap is set
+  [[nodiscard]] constexpr bool any_set() const noexcept {
+    return !none_set(0, N);
+  }
+
+  /// Returns true if any bit in a range is set.  No bounds checking is
+  /// performed and accessing an invalid index is undefined behavior.
+  [[nodiscard]] constexpr bool any_set(uint64_t start,
+                                       uint64_t count) const noexcept {
+    return !none_set(start, count);
+  }
+
+  /// Returns true if no bit in the bitmap is set
+  [[nodiscard]] constexpr bool none_set() const noexcept {
+    return none_set(0, N);
+  }
+
+  /// Returns true if no bit in a range is set.  No bounds checking is
+  /// performed and accessing an invalid index is undefined behavior.
+  [[nodiscard]] constexpr bool none_set(uint64_t start,
+                                        uint64_t count) const noexcept {
+    return query(start, count,
+                 [](uint64_t w, uint64_t mask) { return (w & mask) == 0; });
+  }
+
+  /// Returns the number of set bits in the bitmap
+  [[nodiscard]] constexpr uint64_t count_set() const noexcept {
+    return count_set(0, N);
+  }
+
+  /// Returns the number of set bits in a range.  No bounds checking is
+  /// performed and accessing an invalid index is undefined behavior.
+  [[nodiscard]] constexpr uint64_t count_set(uint64_t start,
+                                             uint64_t count) const noexcept {
+    uint64_t total = 0;
+
+    query(start, count, [&total](uint64_t w, uint64_t mask) {
+      total += static_cast<uint64_t>(popcount(w & mask));
+      return true;
+    });
+
+    return total;
+  }
+
+  /// Returns the index of the first set bit at or after `first`, or
+  /// `no_bits_left` if there are none
+  [[nodiscard]] constexpr uint64_t find_next_set(
+      uint64_t first) const noexcept {
+    return find_next<true>(first, N);
+  }
+
+  /// Returns the index of the first set bit in [first, last), or
+  /// `no_bits_left` if there are none
+  [[nodiscard]] constexpr uint64_t find_next_set(
+      uint64_t first, uint64_t last) const noexcept {
+    return find_next<true>(first, std::min(last, N));
+  }
+
+  /// Returns the index of the first unset bit at or after `first`, or
+  /// `no_bits_left` if there are none
+  [[nodiscard]] constexpr uint64_t find_next_clear(
+      uint64_t first) const noexcept {
+    return find_next<false>(first, N);
+  }
+
+  /// Returns the index of the first unset bit in [first, last), or
+  /// `no_bits_left` if there are none
+  [[nodiscard]] constexpr uint64_t find_next_clear(
+      uint64_t first, uint64_t last) const noexcept {
+    return find_next<false>(first, std::min(last, N));
+  }
+
+  /// Returns the index of the last set bit before `last`, or `no_bits_left` if
+  /// there are none
+  [[nodiscard]] constexpr uint64_t find_prev_set(
+      uint64_t last) const noexcept {
+    return find_prev<true>(0, std::min(last, N));
+  }
+
+  /// Returns the index of the last set bit in [first, last), or
+  /// `no_bits_left` if there are none
+  [[nodiscard]] constexpr uint64_t find_prev_set(
+      uint64_t first, uint64_t last) const noexcept {
+    return find_prev<true>(first, std::min(last, N));
+  }
+
+  /// Returns the index of the last unset bit before `last`, or `no_bits_left`
+  /// if there are none
+  [[nodiscard]] constexpr uint64_t find_prev_clear(
+      uint64_t last) const noexcept {
+    return find_prev<false>(0, std::min(last, N));
+  }
+
+  /// Returns the index of the last unset bit in [first, last), or
+  /// `no_bits_left` if there are none
+  [[nodiscard]] constexpr uint64_t find_prev_clear(
+      uint64_t first, uint64_t last) const noexcept {
+    return find_prev<false>(first, std::min(last, N));
+  }
+
+  /// Returns the start of the first run of at least `length` set (or unset)
+  /// bits that lies within [first, last), or `no_bits_left` if there are none.
+  [[nodiscard]] constexpr uint64_t find_first_run(
+      uint64_t length, bool set, uint64_t first = 0,
+      uint64_t last = N) const noexcept {
+    last = std::min(last, N);
+
+    if (length == 0) {
+      return (first <= last) ? first : no_bits_left;
+    }
+
+    while (first < last && last - first >= length) {
+      const auto start =
+          set ? find_next<true>(first, last) : find_next<false>(first, last);
+
+      if (start == no_bits_left || last - start < length) {
+        return no_bits_left;
+      }
+
+      auto end =
+          set ? find_next<false>(start, last) : find_next<true>(start, last);
+
+      if (end == no_bits_left) {
+        end = last;
+      }
+
+      if (end - start >= length) {
+        return start;
+      }
+
+      first = end;
+    }
+
+    return no_bits_left;
+  }
+
+  /// Equality operator
+  friend constexpr bool operator==(const static_bitmap& lhs,
+                                   const static_bitmap& rhs) noexcept {
+    for (size_t i = 0; i < num_words; i++) {
+      if (uint64_t{lhs._words[i]} != uint64_t{rhs._words[i]}) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  /// Inequality operator
+  friend constexpr bool operator!=(const static_bitmap& lhs,
+                                   const static_bitmap& rhs) noexcept {
+    return !(lhs == rhs);
+  }
+
+ private:
+  /// Replaces each word touched by [start, start + count) with `fn(word,
+  /// mask)`, where `mask` has the bits of the range within the word
+  template <typename Fn>
+  constexpr void modify(uint64_t start, uint64_t count, Fn fn) noexcept {
+    detail::visit_word_range(
+        start, count,
+        [this, &fn](uint64_t w, uint64_t mask) {
+          auto& val = _words[static_cast<size_t>(w)];
+          val = fn(val, mask);
+          return true;
+        },
+        [this, &fn](uint64_t first, uint64_t last) {
+          for (auto w = first; w < last; w++) {
+            auto& val = _words[static_cast<size_t>(w)];
+            val = fn(val, std::numeric_limits<uint64_t>::max());
+          }
+
+          return true;
+        });
+  }
+
+  /// Returns true if `fn(word, mask)` returns true for every word touched by
+  /// [start, start + count), where `mask` has the bits of the range within the
+  /// word
+  template <typename Fn>
+  constexpr bool query(uint64_t start, uint64_t count, Fn fn) const noexcept {
+    return detail::visit_word_range(
+        start, count,
+        [this, &fn](uint64_t w, uint64_t mask) {
+          return fn(_words[static_cast<size_t>(w)], mask);
+        },
+        [this, &fn](uint64_t first, uint64_t last) {
+          for (auto w = first; w < last; w++) {
+            if (!fn(_words[static_cast<size_t>(w)],
+                    std::numeric_limits<uint64_t>::max())) {
+              return false;
+            }
+          }
+
+          return true;
+        });
+  }
+
+  /// Returns the index of the first set (or unset) bit in [first, last), or
+  /// `no_bits_left` if there are none
+  template <bool Set>
+  [[nodiscard]] constexpr uint64_t find_next(uint64_t first,
+                                             uint64_t last) const noexcept {
+    constexpr uint64_t skip = Set ? 0 : std::numeric_limits<uint64_t>::max();
+
+    for (auto w = si(first); first < last; w++, first = w * storage_bits) {
+      const auto bits =
+          (_words[w] ^ skip) & ~detail::word_mask(0, bi(first));
+
+      if (bits != 0) {
+        const auto n =
+            w * storage_bits + static_cast<uint64_t>(countr_zero(bits));
+        return (n < last) ? n : no_bits_left;
+      }
+    }
+
+    return no_bits_left;
+  }
+
+  /// Returns the index of the last set (or unset) bit in [first, last), or
+  /// `no_bits_left` if there are none
+  template <bool Set>
+  [[nodiscard]] constexpr uint64_t find_prev(uint64_t first,
+                                             uint64_t last) const noexcept {
+    constexpr uint64_t skip = Set ? 0 : std::numeric_limits<uint64_t>::max();
+
+    while (first < last) {
+      const auto w = si(last - 1);
+      const auto bits =
+          (_words[w] ^ skip) & detail::word_mask(0, bi(last - 1) + 1);
+
+      if (bits != 0) {
+        const auto n = w * storage_bits + storage_bits - 1 -
+                       static_cast<uint64_t>(countl_zero(bits));
+        return (n >= first) ? n : no_bits_left;
+      }
+
+      last = w * storage_bits;
+    }
+
+    return no_bits_left;
+  }
+
+  std::array<storage_type, num_words> _words{};  ///< Underlying bit storage
+};
+
+}  // namespace yat
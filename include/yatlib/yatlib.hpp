@@ -18,18 +18,27 @@
 #include "algorithm.hpp"
 #include "any.hpp"
 #include "array.hpp"
+#include "atomic_bitmap.hpp"
 #include "bit.hpp"
+#include "bit_span.hpp"
 #include "bitmap.hpp"
+#include "bitmap_rank_select.hpp"
+#include "chained_bitmap_scanner.hpp"
 #include "chrono.hpp"
+#include "compressed_bitmap.hpp"
 #include "concepts.hpp"
 #include "cstring_view.hpp"
 #include "endian.hpp"
 #include "filesystem.hpp"
+#include "hierarchical_bitmap.hpp"
 #include "iterator.hpp"
+#include "mapped_bitmap.hpp"
 #include "memory.hpp"
 #include "optional.hpp"
+#include "parallel_bitmap_scan.hpp"
 #include "ranges.hpp"
 #include "span.hpp"
+#include "static_bitmap.hpp"
 #include "type_traits.hpp"
 #include "utility.hpp"
 #include "variant.hpp"
@@ -0,0 +1,178 @@
+/*
+ * Copyright 2020 Joe T. Sylve, Ph.D.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+#include <yatlib/atomic_bitmap.hpp>
+
+#include "common.hpp"
+
+TEST_CASE("atomic_bitmap", "[bitmap][atomic_bitmap]") {
+  yat::atomic_bitmap bm{130};
+
+  REQUIRE(bm.count() == 130);
+  REQUIRE(bm.snapshot().none_set());
+
+  REQUIRE_FALSE(bm.test_and_set(5));
+  REQUIRE(bm.test_and_set(5));
+  REQUIRE(bm[5]);
+  REQUIRE(bm.test_and_clear(5));
+  REQUIRE_FALSE(bm.test_and_clear(5));
+  REQUIRE_FALSE(bm.test(5));
+
+  bm.set(129);
+  REQUIRE(bm[129]);
+  bm.clear(129);
+  REQUIRE_FALSE(bm[129]);
+
+  // Claims succeed only if every bit is unset
+  REQUIRE(bm.try_claim(10, 100));
+  REQUIRE_FALSE(bm.try_claim(0, 11));
+  REQUIRE_FALSE(bm.try_claim(109, 10));
+  REQUIRE_FALSE(bm.try_claim(0, 130));
+
+  // Failed claims leave no bits behind
+  const auto snapshot = bm.snapshot();
+  REQUIRE(snapshot.all_set(10, 100));
+  REQUIRE(snapshot.none_set(0, 10));
+  REQUIRE(snapshot.none_set(110, 20));
+
+  bm.release(10, 50);
+  REQUIRE(bm.snapshot().none_set(0, 60));
+  REQUIRE(bm.snapshot().all_set(60, 50));
+
+  // Bits are claimed at or after the hint and then from the start
+  REQUIRE(bm.claim_first(5) == 5);
+  REQUIRE(bm.claim_first(110) == 110);
+  REQUIRE(bm.claim_first(129) == 129);
+  REQUIRE(bm.claim_first(129) == 0);
+
+  // Runs are claimed at or after the hint and then from the start
+  constexpr auto none = yat::atomic_bitmap::no_bits_left;
+
+  REQUIRE(bm.claim_run(20, 100) == 6);
+  REQUIRE(bm.claim_run(50, 0) == none);
+  REQUIRE(bm.claim_run(30, 50) == 26);
+  REQUIRE(bm.claim_run(1, 0) == 1);
+  REQUIRE(bm.claim_run(18, 0) == 111);
+  REQUIRE(bm.claim_run(10, 0) == none);
+  REQUIRE(bm.claim_run(0, 0) == none);
+
+  // The bitmap can be built from a view
+  const yat::atomic_bitmap copy{bm.snapshot()};
+  REQUIRE(copy.snapshot().count_set() == bm.snapshot().count_set());
+  REQUIRE(yat::atomic_bitmap{}.claim_first(0) == none);
+}
+
+TEST_CASE("atomic_bitmap (threads)", "[bitmap][atomic_bitmap]") {
+  constexpr uint64_t num_bits = 100'003;
+  constexpr size_t num_threads = 8;
+
+  yat::atomic_bitmap bm{num_bits};
+
+  // Every bit is claimed exactly once
+  std::vector<std::vector<uint64_t>> claimed(num_threads);
+  std::vector<std::thread> threads{};
+
+  for (size_t t = 0; t < num_threads; t++) {
+    threads.emplace_back([&bm, &bits = claimed[t]] {
+      for (auto b = bm.claim_first(); b != yat::atomic_bitmap::no_bits_left;
+           b = bm.claim_first()) {
+        bits.push_back(b);
+      }
+    });
+  }
+
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  std::vector<uint64_t> all{};
+  for (const auto& bits : claimed) {
+    all.insert(all.end(), bits.begin(), bits.end());
+  }
+
+  std::sort(all.begin(), all.end());
+  REQUIRE(all.size() == num_bits);
+  REQUIRE(std::adjacent_find(all.begin(), all.end()) == all.end());
+  REQUIRE(bm.snapshot().all_set());
+
+  // Runs never overlap
+  bm.release(0, num_bits);
+  REQUIRE(bm.snapshot().none_set());
+
+  std::vector<std::vector<uint64_t>> runs(num_threads);
+  threads.clear();
+
+  for (size_t t = 0; t < num_threads; t++) {
+    threads.emplace_back([&bm, &starts = runs[t], t] {
+      std::mt19937_64 rng(random_seed + t);
+
+      for (int i = 0; i < 1000; i++) {
+        const auto s = bm.claim_run(7, rng() % num_bits);
+
+        if (s != yat::atomic_bitmap::no_bits_left) {
+          starts.push_back(s);
+        }
+      }
+    });
+  }
+
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  std::vector<int> owners(num_bits);
+  uint64_t total = 0;
+
+  for (const auto& starts : runs) {
+    for (const auto s : starts) {
+      for (auto b = s; b < s + 7; b++) {
+        owners[b]++;
+      }
+
+      total += 7;
+    }
+  }
+
+  REQUIRE(std::all_of(owners.begin(), owners.end(),
+                      [](int n) { return n <= 1; }));
+  REQUIRE(bm.snapshot().count_set() == total);
+
+  // Only one thread wins a contended claim
+  bm.release(0, num_bits);
+
+  std::atomic<int> winners{};
+  threads.clear();
+
+  for (size_t t = 0; t < num_threads; t++) {
+    threads.emplace_back([&bm, &winners] {
+      if (bm.try_claim(1000, 5000)) {
+        winners++;
+      }
+    });
+  }
+
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  REQUIRE(winners == 1);
+  REQUIRE(bm.snapshot().count_set() == 5000);
+}
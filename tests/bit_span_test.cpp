@@ -0,0 +1,188 @@
+/*
+ * Copyright 2020 Joe T. Sylve, Ph.D.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <vector>
+#include <yatlib/algorithm.hpp>
+#include <yatlib/bit_span.hpp>
+
+#include "common.hpp"
+
+static std::vector<bool> to_bools(yat::const_bit_span bits) {
+  return {bits.begin(), bits.end()};
+}
+
+TEST_CASE("bit_span", "[bit_span]") {
+  static_assert(yat::ranges::random_access_range<yat::bit_span>);
+  static_assert(yat::ranges::random_access_range<yat::const_bit_span>);
+  static_assert(yat::ranges::sized_range<yat::bit_span>);
+  static_assert(yat::ranges::view<yat::bit_span>);
+  static_assert(std::output_iterator<yat::bit_iterator, bool>);
+
+  std::mt19937_64 rng(random_seed);
+
+  yat::bitmap bm = generate_random_bitmap(1000, rng);
+  const yat::bit_span bits{bm};
+  const yat::const_bit_span cbits{bm};
+
+  REQUIRE(bits.size() == 1000);
+  REQUIRE(cbits.size() == 1000);
+  REQUIRE_FALSE(bits.empty());
+  REQUIRE(yat::const_bit_span{}.empty());
+
+  for (uint64_t i = 0; i < bm.count(); i++) {
+    REQUIRE(bits[i] == bm[i]);
+    REQUIRE(cbits[i] == bm[i]);
+  }
+
+  // Writing through the references modifies the bitmap
+  bits[3] = true;
+  bits[4] = false;
+  bits[5] = bits[3];
+  REQUIRE(bm[3]);
+  REQUIRE_FALSE(bm[4]);
+  REQUIRE(bm[5]);
+
+  bits[5].flip();
+  REQUIRE_FALSE(bm[5]);
+  REQUIRE(~bits[5]);
+
+  // Iterator arithmetic
+  const auto first = bits.begin();
+  REQUIRE(bits.end() - first == 1000);
+  REQUIRE(first + 77 - 77 == first);
+  REQUIRE((first + 77) - (first + 5) == 72);
+  REQUIRE((first + 5) - (first + 77) == -72);
+  REQUIRE(first + 70 > first + 69);
+  REQUIRE((first + 100)[-37] == bm[63]);
+
+  auto it = first + 9;
+  REQUIRE(--it == first + 8);
+  REQUIRE(--it == first + 7);
+  REQUIRE(++it == first + 8);
+  REQUIRE(yat::const_bit_iterator{it} == cbits.begin() + 8);
+
+  // Subspans and the ranges algorithms work on the proxies
+  const auto sub = cbits.subspan(13, 500);
+  REQUIRE(sub.size() == 500);
+
+  for (uint64_t i = 0; i < sub.size(); i++) {
+    REQUIRE(sub[i] == bm[i + 13]);
+  }
+
+  REQUIRE(yat::ranges::count(sub, true) ==
+          static_cast<std::ptrdiff_t>(bm.count_set(13, 500)));
+
+  // Spans over views of unaligned byte buffers only read the bytes they need
+  const auto num_bytes = size_t{125};
+  auto buffer = std::make_unique<std::byte[]>(num_bytes + 1);
+  std::memcpy(buffer.get() + 1, yat::bitmap_view{bm}.words().data(), num_bytes);
+  const yat::bitmap_view view{{buffer.get() + 1, num_bytes}, 1000};
+
+  REQUIRE(to_bools(yat::const_bit_span{view}) == to_bools(cbits));
+}
+
+TEST_CASE("bit_span algorithms", "[bit_span]") {
+  std::mt19937_64 rng(random_seed);
+
+  for (int round = 0; round < 300; round++) {
+    const auto num_bits = rng() % 2000 + 1;
+    const auto a = generate_random_bitmap(num_bits, rng);
+    auto b = generate_random_bitmap(num_bits, rng);
+    const auto bools = to_bools(a);
+
+    const auto first = rng() % num_bits;
+    const auto n = rng() % (num_bits - first + 1);
+    const auto src = yat::const_bit_span{a}.subspan(first, n);
+    const auto ref = std::vector<bool>(
+        bools.begin() + static_cast<std::ptrdiff_t>(first),
+        bools.begin() + static_cast<std::ptrdiff_t>(first + n));
+
+    // count and find
+    for (const bool value : {true, false}) {
+      REQUIRE(yat::count(src.begin(), src.end(), value) ==
+              std::count(ref.begin(), ref.end(), value));
+      REQUIRE(yat::find(src.begin(), src.end(), value) - src.begin() ==
+              std::find(ref.begin(), ref.end(), value) - ref.begin());
+    }
+
+    // copy to an unrelated offset
+    const auto to = rng() % (num_bits - n + 1);
+    auto expected = to_bools(b);
+    std::copy(ref.begin(), ref.end(),
+              expected.begin() + static_cast<std::ptrdiff_t>(to));
+
+    const yat::bit_span dst{b};
+    const auto out = dst.begin() + static_cast<std::ptrdiff_t>(to);
+    REQUIRE(yat::copy(src.begin(), src.end(), out) ==
+            out + static_cast<std::ptrdiff_t>(n));
+    REQUIRE(to_bools(b) == expected);
+
+    // equal and mismatch, after planting a difference
+    const auto copied = dst.subspan(to, n);
+    REQUIRE(yat::equal(src.begin(), src.end(), copied.begin()));
+    REQUIRE(yat::equal(src.begin(), src.end(), copied.begin(), copied.end()));
+    REQUIRE(yat::mismatch(src.begin(), src.end(), copied.begin()).first ==
+            src.end());
+
+    if (n != 0) {
+      const auto diff = rng() % n;
+      copied[diff].flip();
+
+      const auto [m1, m2] = yat::mismatch(src.begin(), src.end(),
+                                          copied.begin(), copied.end());
+      REQUIRE(m1 - src.begin() == static_cast<std::ptrdiff_t>(diff));
+      REQUIRE(m2 - copied.begin() == static_cast<std::ptrdiff_t>(diff));
+      REQUIRE_FALSE(yat::equal(src.begin(), src.end(), copied.begin()));
+      REQUIRE_FALSE(yat::equal(src.begin(), src.end() - 1, copied.begin(),
+                               copied.end()));
+    }
+
+    // fill leaves the bits around the range alone
+    for (const bool value : {true, false}) {
+      expected = to_bools(b);
+      std::fill(expected.begin() + static_cast<std::ptrdiff_t>(first),
+                expected.begin() + static_cast<std::ptrdiff_t>(first + n),
+                value);
+
+      const auto range = dst.subspan(first, n);
+      yat::fill(range.begin(), range.end(), value);
+      REQUIRE(to_bools(b) == expected);
+    }
+  }
+}
+
+TEST_CASE("bit_span algorithms (lookup)", "[bit_span]") {
+  yat::bitmap bm{300};
+  const yat::bit_span bits{bm};
+
+  // Unqualified calls with the std algorithms in scope pick the word-wise
+  // overloads
+  using std::count;
+  using std::fill;
+  using std::find;
+
+  fill(bits.begin() + 100, bits.end(), true);
+  REQUIRE(bm.count_set() == 200);
+  REQUIRE(count(bits.begin(), bits.end(), false) == 100);
+  REQUIRE(find(bits.begin(), bits.end(), true) == bits.begin() + 100);
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2020 Joe T. Sylve, Ph.D.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <yatlib/bitmap_rank_select.hpp>
+
+#include "common.hpp"
+
+// Checks every rank and select query against a bit-by-bit scan
+static void check_rank_select(const yat::bitmap_view& view) {
+  const yat::bitmap_rank_select index{view};
+
+  uint64_t ones = 0;
+  uint64_t zeros = 0;
+
+  for (uint64_t i = 0; i < view.count(); i++) {
+    REQUIRE(index.rank1(i) == ones);
+    REQUIRE(index.rank0(i) == zeros);
+
+    if (view[i]) {
+      REQUIRE(index.select1(ones) == i);
+      ones++;
+    } else {
+      REQUIRE(index.select0(zeros) == i);
+      zeros++;
+    }
+  }
+
+  REQUIRE(index.rank1(view.count()) == ones);
+  REQUIRE(index.rank0(view.count()) == zeros);
+  REQUIRE(index.count_set() == ones);
+  REQUIRE(index.count_clear() == zeros);
+  REQUIRE(index.select1(ones) == yat::bitmap_rank_select::no_bits_left);
+  REQUIRE(index.select0(zeros) == yat::bitmap_rank_select::no_bits_left);
+}
+
+TEST_CASE("bitmap_rank_select", "[bitmap][bitmap_rank_select]") {
+  std::mt19937_64 rng(random_seed);
+
+  for (const uint64_t num_bits :
+       {uint64_t{0}, uint64_t{1}, uint64_t{64}, uint64_t{511}, uint64_t{4096},
+        uint64_t{4097}, uint64_t{40'000}, uint64_t{100'003}}) {
+    // Fill the words with varying densities, including bits beyond the end of
+    // the bitmap that must be ignored
+    for (const int density : {0, 1, 4, 8}) {
+      std::vector<yat::little_uint64_t> words((num_bits + 63) / 64 + 1);
+
+      for (auto& w : words) {
+        uint64_t v = (density == 8) ? ~uint64_t{0} : 0;
+
+        for (int i = 0; i < density && density != 8; i++) {
+          v |= uint64_t{1} << (rng() % 64);
+        }
+
+        w = v;
+      }
+
+      if (num_bits % 64 != 0) {
+        words[num_bits / 64] =
+            words[num_bits / 64] | ~((uint64_t{1} << (num_bits % 64)) - 1);
+      }
+
+      check_rank_select(yat::bitmap_view{words.data(), num_bits});
+    }
+  }
+}
+
+TEST_CASE("bitmap_rank_select (runs)", "[bitmap][bitmap_rank_select]") {
+  yat::bitmap bm{300'000};
+
+  bm.set(10, 50'000);
+  bm.set(100'000, 17);
+  bm.set(200'001, 99'999);
+
+  check_rank_select(bm);
+}
+
+TEST_CASE("select_in_word", "[bitmap][bitmap_rank_select]") {
+  for (const uint64_t w : generate_random_values<uint64_t>(1000)) {
+    uint64_t r = 0;
+
+    for (uint64_t i = 0; i < 64; i++) {
+      if ((w >> i) & 1) {
+        REQUIRE(yat::detail::select_in_word(w, r) == i);
+        r++;
+      }
+    }
+  }
+}
@@ -0,0 +1,1757 @@
+/*
+ * Copyright 2020 Joe T. Sylve, Ph.D.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <yatlib/bitmap.hpp>
+
+#include "common.hpp"
+
+// Scan for ranges one bit at a time
+static range_list naive_scan(const yat::bitmap_view& bm, uint64_t num_bits,
+                             bool scan_set) {
+  range_list ranges{};
+
+  for (uint64_t i = 0; i < num_bits;) {
+    if (bm[i] != scan_set) {
+      i++;
+      continue;
+    }
+
+    const uint64_t start = i;
+    while (i < num_bits && bm[i] == scan_set) {
+      i++;
+    }
+
+    ranges.emplace_back(start, i - start);
+  }
+
+  return ranges;
+}
+
+TEST_CASE("bitmap_scanner", "[bitmap][bitmap_scanner]") {
+  for (const uint64_t num_bits :
+       {uint64_t{1}, uint64_t{63}, uint64_t{64}, uint64_t{65}, uint64_t{1000},
+        uint64_t{4096}, uint64_t{100'003}}) {
+    for (uint64_t seed = 0; seed < 4; seed++) {
+      const auto bm = generate_random_bitmap(num_bits, seed);
+
+      for (const bool scan_set : {true, false}) {
+        REQUIRE(scan(yat::bitmap_scanner{bm, scan_set}) ==
+                naive_scan(bm, num_bits, scan_set));
+      }
+    }
+  }
+}
+
+// Scan for ranges from last to first
+static range_list reverse_scan(const yat::bitmap_scanner& scanner) {
+  range_list ranges{};
+
+  for (auto it = scanner.rbegin(); it != scanner.rend(); ++it) {
+    ranges.emplace_back(it->start, it->count);
+  }
+
+  return ranges;
+}
+
+// Clips a list of ranges to the window [first, last)
+static range_list clip(const range_list& ranges, uint64_t first,
+                       uint64_t last) {
+  range_list clipped{};
+
+  for (const auto& [start, count] : ranges) {
+    const auto s = std::max(start, first);
+    const auto e = std::min(start + count, last);
+
+    if (s < e) {
+      clipped.emplace_back(s, e - s);
+    }
+  }
+
+  return clipped;
+}
+
+TEST_CASE("bitmap_scanner (window)", "[bitmap][bitmap_scanner]") {
+  std::mt19937_64 rng(random_seed);
+
+  for (const uint64_t num_bits :
+       {uint64_t{1}, uint64_t{65}, uint64_t{1000}, uint64_t{100'003}}) {
+    const auto bm = generate_random_bitmap(num_bits, 5);
+
+    for (int i = 0; i < 50; i++) {
+      const auto first = rng() % (num_bits + 1);
+      const auto last = first + rng() % (num_bits - first + 1);
+
+      for (const bool scan_set : {true, false}) {
+        const auto expected =
+            clip(naive_scan(bm, num_bits, scan_set), first, last);
+        const yat::bitmap_scanner scanner{bm, first, last, scan_set};
+
+        REQUIRE(scan(scanner) == expected);
+        REQUIRE(reverse_scan(scanner) ==
+                range_list(expected.rbegin(), expected.rend()));
+
+        // Seeking clips the ranges to the new starting point
+        const auto target = first + rng() % (last - first + 1);
+        range_list sought{};
+
+        for (auto it = scanner.seek(target); it != scanner.end(); ++it) {
+          sought.emplace_back(it->start, it->count);
+        }
+
+        REQUIRE(sought == clip(expected, target, last));
+      }
+    }
+
+    // Reverse scanning the whole bitmap
+    for (const bool scan_set : {true, false}) {
+      const auto expected = naive_scan(bm, num_bits, scan_set);
+      REQUIRE(reverse_scan(yat::bitmap_scanner{bm, scan_set}) ==
+              range_list(expected.rbegin(), expected.rend()));
+    }
+  }
+
+  // Windows beyond the end of the bitmap are clamped
+  yat::bitmap bm{100};
+  bm.set(90, 10);
+
+  const yat::bitmap_scanner scanner{bm, 95, 1000};
+  CHECK(scanner.window_first() == 95);
+  CHECK(scanner.window_last() == 100);
+  CHECK(scan(scanner) == range_list{{95, 5}});
+  CHECK(scan(yat::bitmap_scanner{bm, 1000, 2000}).empty());
+}
+
+TEST_CASE("bitmap_scanner (uniform)", "[bitmap][bitmap_scanner]") {
+  yat::bitmap bm{10'000};
+
+  CHECK(scan(yat::bitmap_scanner{bm, true}).empty());
+  CHECK(scan(yat::bitmap_scanner{bm, false}) == range_list{{0, 10'000}});
+
+  bm.set(0, 10'000);
+
+  CHECK(scan(yat::bitmap_scanner{bm, true}) == range_list{{0, 10'000}});
+  CHECK(scan(yat::bitmap_scanner{bm, false}).empty());
+
+  bm.clear(9'999);
+
+  CHECK(scan(yat::bitmap_scanner{bm, true}) == range_list{{0, 9'999}});
+  CHECK(scan(yat::bitmap_scanner{bm, false}) == range_list{{9'999, 1}});
+}
+
+TEST_CASE("bitmap kernels", "[bitmap][simd]") {
+  using yat::detail::simd_isa;
+
+  std::mt19937_64 rng(random_seed);
+  std::vector<yat::little_uint64_t> words(300);
+
+  for (const auto isa :
+       {simd_isa::scalar, simd_isa::sse2, simd_isa::avx2, simd_isa::avx512}) {
+    if (!yat::detail::simd_isa_supported(isa)) {
+      continue;
+    }
+
+    const auto& kernels = yat::detail::bitmap_kernels_for(isa);
+
+    for (const uint64_t pattern : {uint64_t{0}, ~uint64_t{0}}) {
+      for (size_t diff = 0; diff <= words.size(); diff++) {
+        for (auto& w : words) {
+          w = pattern;
+        }
+
+        if (diff < words.size()) {
+          words[diff] = pattern ^ (uint64_t{1} << (rng() % 64));
+        }
+
+        for (const size_t first : {size_t{0}, size_t{3}, size_t{77}}) {
+          const size_t expected = (diff < first) ? words.size() : diff;
+          CHECK(kernels.find_word_not_equal(words.data(), first, words.size(),
+                                            pattern) == expected);
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("bitmap range operations", "[bitmap]") {
+  constexpr uint64_t num_bits = 1000;
+  std::mt19937_64 rng(random_seed);
+
+  auto bm = generate_random_bitmap(num_bits, 0);
+  std::vector<bool> expected(num_bits);
+  for (uint64_t i = 0; i < num_bits; i++) {
+    expected[i] = bm[i];
+  }
+
+  for (int iteration = 0; iteration < 2000; iteration++) {
+    const uint64_t start = rng() % num_bits;
+    const uint64_t count = rng() % (num_bits - start + 1);
+
+    switch (rng() % 3) {
+      case 0:
+        bm.set(start, count);
+        for (uint64_t i = start; i < start + count; i++) {
+          expected[i] = true;
+        }
+        break;
+      case 1:
+        bm.clear(start, count);
+        for (uint64_t i = start; i < start + count; i++) {
+          expected[i] = false;
+        }
+        break;
+      default:
+        bm.flip(start, count);
+        for (uint64_t i = start; i < start + count; i++) {
+          expected[i] = !expected[i];
+        }
+        break;
+    }
+
+    for (uint64_t i = 0; i < num_bits; i++) {
+      REQUIRE(bm[i] == expected[i]);
+    }
+
+    // Query a different random range
+    const uint64_t qstart = rng() % num_bits;
+    const uint64_t qmax = (iteration % 2 == 0) ? 5 : 300;
+    const uint64_t qcount = rng() % (std::min(num_bits - qstart, qmax) + 1);
+
+    bool all = true;
+    bool any = false;
+    for (uint64_t i = qstart; i < qstart + qcount; i++) {
+      all = all && expected[i];
+      any = any || expected[i];
+    }
+
+    const yat::bitmap_view view{bm};
+    REQUIRE(view.all_set(qstart, qcount) == all);
+    REQUIRE(view.any_set(qstart, qcount) == any);
+    REQUIRE(view.none_set(qstart, qcount) == !any);
+    REQUIRE(bm.all_set(qstart, qcount) == all);
+    REQUIRE(bm.any_set(qstart, qcount) == any);
+    REQUIRE(bm.none_set(qstart, qcount) == !any);
+  }
+}
+
+TEST_CASE("bitmap range queries", "[bitmap]") {
+  yat::bitmap bm{1000};
+
+  CHECK(bm.none_set());
+  CHECK_FALSE(bm.any_set());
+  CHECK_FALSE(bm.all_set());
+  CHECK(bm.all_set(10, 0));
+  CHECK(bm.none_set(10, 0));
+
+  bm.set(3, 900);
+
+  CHECK(bm.all_set(3, 900));
+  CHECK_FALSE(bm.all_set(2, 900));
+  CHECK_FALSE(bm.all_set(4, 900));
+  CHECK(bm.none_set(0, 3));
+  CHECK(bm.none_set(903, 97));
+  CHECK(bm.any_set(902, 98));
+  CHECK_FALSE(bm.any_set(903, 97));
+
+  bm.flip(0, 1000);
+
+  CHECK(bm.none_set(3, 900));
+  CHECK(bm.all_set(0, 3));
+  CHECK(bm.all_set(903, 97));
+
+  bm.clear(0, 1000);
+  CHECK(bm.none_set());
+}
+
+TEST_CASE("bitmap bitwise operations", "[bitmap]") {
+  using yat::bitwise_op;
+
+  for (const auto& [lhs_bits, rhs_bits] :
+       {std::pair<uint64_t, uint64_t>{1000, 1000}, {1000, 700}, {700, 1000},
+        {64, 130}, {5000, 4999}, {4999, 5000}, {1000, 0}, {64, 0}, {0, 0}}) {
+    const auto lhs = generate_random_bitmap(lhs_bits, 1);
+    auto rhs = generate_random_bitmap(rhs_bits, 2);
+
+    // Make sure that garbage beyond the end of rhs is never used
+    rhs.resize(rhs_bits + 1);
+    rhs.set(rhs_bits);
+
+    // An empty rhs has no storage at all
+    const yat::bitmap empty{};
+    const auto rhs_view =
+        (rhs_bits == 0)
+            ? yat::bitmap_view{empty}
+            : yat::bitmap_view{yat::bitmap_view{rhs}.words().data(), rhs_bits};
+
+    for (const auto op : {bitwise_op::bit_and, bitwise_op::bit_or,
+                          bitwise_op::bit_xor, bitwise_op::bit_and_not}) {
+      yat::bitmap expected{lhs_bits};
+
+      for (uint64_t i = 0; i < lhs_bits; i++) {
+        const bool l = lhs[i];
+        const bool r = (i < rhs_bits) && rhs[i];
+        bool e{};
+
+        switch (op) {
+          case bitwise_op::bit_and:
+            e = l && r;
+            break;
+          case bitwise_op::bit_or:
+            e = l || r;
+            break;
+          case bitwise_op::bit_xor:
+            e = l != r;
+            break;
+          case bitwise_op::bit_and_not:
+            e = l && !r;
+            break;
+        }
+
+        if (e) {
+          expected.set(i);
+        }
+      }
+
+      const auto result = yat::apply(op, lhs, rhs_view);
+      REQUIRE(result.count() == lhs_bits);
+
+      for (const bool scan_set : {true, false}) {
+        const auto expected_ranges = naive_scan(expected, lhs_bits, scan_set);
+
+        REQUIRE(naive_scan(result, lhs_bits, scan_set) == expected_ranges);
+        REQUIRE(scan(yat::bitmap_scanner{lhs, op, rhs_view, scan_set}) ==
+                expected_ranges);
+        REQUIRE(reverse_scan(yat::bitmap_scanner{lhs, op, rhs_view,
+                                                 scan_set}) ==
+                range_list(expected_ranges.rbegin(), expected_ranges.rend()));
+
+        // Batches of ranges
+        const yat::bitmap_scanner scanner{lhs, op, rhs_view, scan_set};
+        std::vector<yat::bitmap_range> buffer(7);
+        range_list ranges{};
+
+        for (uint64_t cursor = 0; cursor != scanner.window_last();) {
+          const auto batch = scanner.scan_batch(buffer, cursor);
+
+          for (size_t i = 0; i < batch.count; i++) {
+            ranges.emplace_back(buffer[i].start, buffer[i].count);
+          }
+
+          cursor = batch.cursor;
+        }
+
+        REQUIRE(ranges == expected_ranges);
+      }
+    }
+  }
+}
+
+TEST_CASE("bitmap bitwise operators", "[bitmap]") {
+  yat::bitmap a{200};
+  yat::bitmap b{200};
+
+  a.set(0, 100);
+  b.set(50, 100);
+
+  CHECK(scan(yat::bitmap_scanner{a & b}) == range_list{{50, 50}});
+  CHECK(scan(yat::bitmap_scanner{a | b}) == range_list{{0, 150}});
+  CHECK(scan(yat::bitmap_scanner{a ^ b}) == range_list{{0, 50}, {100, 50}});
+  CHECK(scan(yat::bitmap_scanner{yat::and_not(a, b)}) == range_list{{0, 50}});
+
+  auto c = a;
+  c &= b;
+  CHECK(scan(yat::bitmap_scanner{c}) == range_list{{50, 50}});
+
+  c = a;
+  c |= b;
+  CHECK(scan(yat::bitmap_scanner{c}) == range_list{{0, 150}});
+
+  c = a;
+  c ^= b;
+  CHECK(scan(yat::bitmap_scanner{c}) == range_list{{0, 50}, {100, 50}});
+
+  c = a;
+  c.and_not(b);
+  CHECK(scan(yat::bitmap_scanner{c}) == range_list{{0, 50}});
+}
+
+TEST_CASE("bitmap bitwise kernels", "[bitmap][simd]") {
+  using yat::bitwise_op;
+  using yat::detail::simd_isa;
+
+  std::mt19937_64 rng(random_seed);
+  std::vector<yat::little_uint64_t> lhs(37);
+  std::vector<yat::little_uint64_t> rhs(37);
+
+  for (size_t i = 0; i < lhs.size(); i++) {
+    lhs[i] = rng();
+    rhs[i] = rng();
+  }
+
+  for (const auto isa :
+       {simd_isa::scalar, simd_isa::sse2, simd_isa::avx2, simd_isa::avx512}) {
+    if (!yat::detail::simd_isa_supported(isa)) {
+      continue;
+    }
+
+    const auto& kernels = yat::detail::bitmap_kernels_for(isa);
+
+    for (const auto op : {bitwise_op::bit_and, bitwise_op::bit_or,
+                          bitwise_op::bit_xor, bitwise_op::bit_and_not}) {
+      for (size_t n = 0; n <= lhs.size(); n++) {
+        auto dst = lhs;
+        kernels.bitwise(dst.data(), rhs.data(), n, op);
+
+        for (size_t i = 0; i < lhs.size(); i++) {
+          const uint64_t e =
+              (i < n) ? yat::detail::apply_bitwise_op(op, lhs[i], rhs[i])
+                      : uint64_t{lhs[i]};
+          REQUIRE(dst[i] == e);
+        }
+
+        // The result is never equal to the pattern, so the first word is
+        // always found
+        const uint64_t pattern =
+            yat::detail::apply_bitwise_op(op, lhs[n / 2], rhs[n / 2]) + 1;
+        const size_t first = n / 2;
+        size_t expected = n;
+
+        for (size_t i = first; i < n; i++) {
+          if (yat::detail::apply_bitwise_op(op, lhs[i], rhs[i]) != pattern) {
+            expected = i;
+            break;
+          }
+        }
+
+        REQUIRE(kernels.find_op_word_not_equal(lhs.data(), rhs.data(), op,
+                                               first, n, pattern) == expected);
+      }
+    }
+  }
+}
+
+TEST_CASE("bitmap search", "[bitmap]") {
+  constexpr uint64_t num_bits = 3000;
+  constexpr auto npos = yat::bitmap_view::no_bits_left;
+
+  std::mt19937_64 rng(random_seed);
+  auto bm = generate_random_bitmap(num_bits + 1, 3);
+
+  // Make sure that garbage beyond the end of the view is never used
+  bm.set(num_bits);
+  const yat::bitmap_view view{yat::bitmap_view{bm}.words().data(), num_bits};
+
+  const auto naive_next = [&](bool set, uint64_t first, uint64_t last) {
+    for (auto i = first; i < std::min(last, num_bits); i++) {
+      if (view[i] == set) {
+        return i;
+      }
+    }
+    return npos;
+  };
+
+  const auto naive_prev = [&](bool set, uint64_t first, uint64_t last) {
+    for (auto i = std::min(last, num_bits); i > first; i--) {
+      if (view[i - 1] == set) {
+        return i - 1;
+      }
+    }
+    return npos;
+  };
+
+  const auto naive_run = [&](uint64_t length, bool set, uint64_t first,
+                             uint64_t last) {
+    if (length == 0) {
+      return (first <= std::min(last, num_bits)) ? first : npos;
+    }
+
+    uint64_t run = 0;
+    for (auto i = first; i < std::min(last, num_bits); i++) {
+      run = (view[i] == set) ? run + 1 : 0;
+      if (run == length) {
+        return i + 1 - length;
+      }
+    }
+    return npos;
+  };
+
+  for (int iteration = 0; iteration < 5000; iteration++) {
+    const uint64_t first = rng() % (num_bits + 2);
+    const uint64_t last = first + rng() % (num_bits + 2 - first);
+
+    REQUIRE(view.find_next_set(first, last) == naive_next(true, first, last));
+    REQUIRE(view.find_next_clear(first, last) ==
+            naive_next(false, first, last));
+    REQUIRE(view.find_prev_set(first, last) == naive_prev(true, first, last));
+    REQUIRE(view.find_prev_clear(first, last) ==
+            naive_prev(false, first, last));
+    REQUIRE(view.find_next_set(first) == naive_next(true, first, num_bits));
+    REQUIRE(view.find_prev_clear(last) == naive_prev(false, 0, last));
+
+    const uint64_t length = (iteration % 2 == 0) ? rng() % 20 : rng() % 3000;
+    REQUIRE(view.find_first_run(length, true, first, last) ==
+            naive_run(length, true, first, last));
+    REQUIRE(view.find_first_run(length, false, first) ==
+            naive_run(length, false, first, num_bits));
+  }
+}
+
+TEST_CASE("bitmap search (sparse)", "[bitmap]") {
+  constexpr auto npos = yat::bitmap::no_bits_left;
+
+  yat::bitmap bm{100'000};
+
+  CHECK(bm.find_next_set(0) == npos);
+  CHECK(bm.find_prev_set(100'000) == npos);
+  CHECK(bm.find_next_clear(0) == 0);
+  CHECK(bm.find_prev_clear(100'000) == 99'999);
+  CHECK(bm.find_first_run(100'000, false) == 0);
+  CHECK(bm.find_first_run(100'001, false) == npos);
+
+  bm.set(70'000);
+  bm.set(5);
+
+  CHECK(bm.find_next_set(0) == 5);
+  CHECK(bm.find_next_set(6) == 70'000);
+  CHECK(bm.find_next_set(6, 70'000) == npos);
+  CHECK(bm.find_prev_set(100'000) == 70'000);
+  CHECK(bm.find_prev_set(70'000) == 5);
+  CHECK(bm.find_prev_set(6, 70'000) == npos);
+  CHECK(bm.find_first_run(69'994, false) == 6);
+  CHECK(bm.find_first_run(69'995, false) == npos);
+  CHECK(bm.find_first_run(1, true, 6) == 70'000);
+
+  bm.set(0, 100'000);
+
+  CHECK(bm.find_next_clear(0) == npos);
+  CHECK(bm.find_prev_clear(100'000) == npos);
+  CHECK(bm.find_first_run(50'000, true, 50'000) == 50'000);
+}
+
+TEST_CASE("bitmap reverse kernels", "[bitmap][simd]") {
+  using yat::detail::simd_isa;
+
+  std::mt19937_64 rng(random_seed);
+  std::vector<yat::little_uint64_t> words(300);
+
+  for (const auto isa :
+       {simd_isa::scalar, simd_isa::sse2, simd_isa::avx2, simd_isa::avx512}) {
+    if (!yat::detail::simd_isa_supported(isa)) {
+      continue;
+    }
+
+    const auto& kernels = yat::detail::bitmap_kernels_for(isa);
+
+    for (const uint64_t pattern : {uint64_t{0}, ~uint64_t{0}}) {
+      for (size_t diff = 0; diff <= words.size(); diff++) {
+        for (auto& w : words) {
+          w = pattern;
+        }
+
+        if (diff < words.size()) {
+          words[diff] = pattern ^ (uint64_t{1} << (rng() % 64));
+        }
+
+        for (const size_t last : {words.size(), size_t{200}, size_t{3}}) {
+          const size_t expected = (diff < last) ? diff : last;
+          CHECK(kernels.find_last_word_not_equal(words.data(), 0, last,
+                                                 pattern) == expected);
+          CHECK(kernels.find_last_word_not_equal(words.data(), 2, last,
+                                                 pattern) ==
+                ((diff >= 2 && diff < last) ? diff : last));
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("bitmap popcount kernels", "[bitmap][simd]") {
+  using yat::detail::simd_isa;
+
+  std::mt19937_64 rng(random_seed);
+
+  // Enough words for several Harley-Seal blocks plus a remainder
+  std::vector<yat::little_uint64_t> words(1000);
+
+  for (auto& w : words) {
+    w = rng();
+  }
+
+  for (const auto isa :
+       {simd_isa::scalar, simd_isa::sse2, simd_isa::avx2, simd_isa::avx512}) {
+    if (!yat::detail::simd_isa_supported(isa)) {
+      continue;
+    }
+
+    const auto& kernels = yat::detail::bitmap_kernels_for(isa);
+
+    for (int i = 0; i < 200; i++) {
+      const auto first = static_cast<size_t>(rng() % words.size());
+      const auto last =
+          first + static_cast<size_t>(rng() % (words.size() - first + 1));
+
+      uint64_t expected = 0;
+      for (auto w = first; w < last; w++) {
+        expected += static_cast<uint64_t>(yat::popcount(uint64_t{words[w]}));
+      }
+
+      CHECK(kernels.popcount(words.data(), first, last) == expected);
+    }
+
+    // Every bit set makes sure the carry-save counters don't overflow
+    const std::vector<yat::little_uint64_t> ones(words.size(), ~uint64_t{0});
+    CHECK(kernels.popcount(ones.data(), 0, ones.size()) == ones.size() * 64);
+  }
+}
+
+TEST_CASE("bitmap count_set", "[bitmap]") {
+  std::mt19937_64 rng(random_seed);
+
+  const auto bm = generate_random_bitmap(100'000, 11);
+  const yat::bitmap_view view{bm};
+
+  uint64_t total = 0;
+  for (uint64_t i = 0; i < bm.count(); i++) {
+    total += bm[i] ? 1U : 0U;
+  }
+
+  CHECK(bm.count_set() == total);
+  CHECK(view.count_set() == total);
+
+  for (int i = 0; i < 500; i++) {
+    const auto start = rng() % bm.count();
+    const auto count = rng() % (bm.count() - start + 1);
+
+    uint64_t expected = 0;
+    for (auto n = start; n < start + count; n++) {
+      expected += bm[n] ? 1U : 0U;
+    }
+
+    CHECK(bm.count_set(start, count) == expected);
+  }
+
+  yat::bitmap small{130};
+  CHECK(small.count_set() == 0);
+  CHECK(small.count_set(5, 0) == 0);
+
+  small.set(60, 10);
+  CHECK(small.count_set() == 10);
+  CHECK(small.count_set(64, 64) == 6);
+  CHECK(small.count_set(0, 64) == 4);
+}
+
+TEST_CASE("bitmap_run_scanner", "[bitmap][bitmap_scanner]") {
+  std::mt19937_64 rng(random_seed);
+
+  for (const uint64_t num_bits :
+       {uint64_t{1}, uint64_t{64}, uint64_t{1000}, uint64_t{100'003}}) {
+    const auto bm = generate_random_bitmap(num_bits, 7);
+
+    for (int i = 0; i < 20; i++) {
+      const auto first = (i == 0) ? 0 : rng() % (num_bits + 1);
+      const auto last =
+          (i == 0) ? num_bits : first + rng() % (num_bits - first + 1);
+
+      range_list set_ranges{};
+      range_list clear_ranges{};
+      uint64_t next = first;
+      bool prev_set{};
+
+      for (const auto& r : yat::bitmap_run_scanner{bm, first, last}) {
+        // The runs cover the window without gaps and alternate
+        REQUIRE(r.start == next);
+        REQUIRE(r.count != 0);
+        REQUIRE((next == first || r.set != prev_set));
+
+        (r.set ? set_ranges : clear_ranges).emplace_back(r.start, r.count);
+        next = r.start + r.count;
+        prev_set = r.set;
+      }
+
+      REQUIRE(next == last);
+      REQUIRE(set_ranges == clip(naive_scan(bm, num_bits, true), first, last));
+      REQUIRE(clear_ranges ==
+              clip(naive_scan(bm, num_bits, false), first, last));
+    }
+  }
+
+  yat::bitmap bm{200};
+  bm.set(10, 20);
+
+  std::vector<yat::bitmap_run> runs{};
+  for (const auto& r : yat::bitmap_run_scanner{bm}) {
+    runs.push_back(r);
+  }
+
+  CHECK(runs == std::vector<yat::bitmap_run>{
+                    {0, 10, false}, {10, 20, true}, {30, 170, false}});
+  CHECK(yat::bitmap_run_scanner{yat::bitmap{}}.begin() ==
+        yat::bitmap_run_scanner{yat::bitmap{}}.end());
+}
+
+TEST_CASE("bitmap_scanner (batch)", "[bitmap][bitmap_scanner]") {
+  std::mt19937_64 rng(random_seed);
+
+  const auto lhs = generate_random_bitmap(100'003, 9);
+  const auto rhs = generate_random_bitmap(70'000, 10);
+
+  for (const bool scan_set : {true, false}) {
+    const uint64_t first = rng() % 1000;
+    const uint64_t last = lhs.count() - rng() % 1000;
+
+    for (const auto& scanner :
+         {yat::bitmap_scanner{lhs, scan_set},
+          yat::bitmap_scanner{lhs, first, last, scan_set},
+          yat::bitmap_scanner{lhs, yat::bitwise_op::bit_or, rhs, scan_set}}) {
+      const auto expected = scan(scanner);
+
+      for (const size_t batch_size : {size_t{1}, size_t{7}, size_t{4096}}) {
+        std::vector<yat::bitmap_range> buffer(batch_size);
+        range_list ranges{};
+        uint64_t cursor = scanner.window_first();
+
+        while (cursor != scanner.window_last()) {
+          const auto result = scanner.scan_batch(buffer, cursor);
+
+          REQUIRE(result.count <= batch_size);
+          REQUIRE(result.cursor >= cursor);
+
+          for (size_t i = 0; i < result.count; i++) {
+            ranges.emplace_back(buffer[i].start, buffer[i].count);
+          }
+
+          cursor = result.cursor;
+        }
+
+        REQUIRE(ranges == expected);
+      }
+    }
+  }
+
+  // An empty buffer doesn't move the cursor
+  const yat::bitmap_scanner scanner{lhs};
+  const auto result = scanner.scan_batch({}, 10);
+  CHECK(result.count == 0);
+  CHECK(result.cursor == 10);
+}
+
+// Merges ranges separated by small gaps and drops short ranges
+static range_list filter(const range_list& ranges,
+                         const yat::bitmap_scan_options& options) {
+  range_list merged{};
+
+  for (const auto& [start, count] : ranges) {
+    if (!merged.empty() && start - (merged.back().first +
+                                    merged.back().second) <=
+                               options.max_gap_to_merge) {
+      merged.back().second = start + count - merged.back().first;
+    } else {
+      merged.emplace_back(start, count);
+    }
+  }
+
+  range_list filtered{};
+
+  for (const auto& r : merged) {
+    if (r.second >= options.min_run_length) {
+      filtered.push_back(r);
+    }
+  }
+
+  return filtered;
+}
+
+TEST_CASE("bitmap_scanner (options)", "[bitmap][bitmap_scanner]") {
+  const auto bm = generate_random_bitmap(100'003, 12);
+
+  for (const auto& options :
+       {yat::bitmap_scan_options{}, yat::bitmap_scan_options{5, 0},
+        yat::bitmap_scan_options{0, 3}, yat::bitmap_scan_options{100, 10},
+        yat::bitmap_scan_options{1000, 1000}}) {
+    for (const bool scan_set : {true, false}) {
+      const auto expected = filter(naive_scan(bm, bm.count(), scan_set),
+                                   options);
+      const yat::bitmap_scanner scanner{bm, scan_set, options};
+
+      REQUIRE(scan(scanner) == expected);
+      REQUIRE(reverse_scan(scanner) ==
+              range_list(expected.rbegin(), expected.rend()));
+
+      // Batches that end on a pending range resume from it
+      std::vector<yat::bitmap_range> buffer(3);
+      range_list batched{};
+      uint64_t cursor = 0;
+
+      while (cursor != scanner.window_last()) {
+        const auto result = scanner.scan_batch(buffer, cursor);
+
+        for (size_t i = 0; i < result.count; i++) {
+          batched.emplace_back(buffer[i].start, buffer[i].count);
+        }
+
+        cursor = result.cursor;
+      }
+
+      REQUIRE(batched == expected);
+    }
+  }
+
+  yat::bitmap small{100};
+  small.set(10, 5);
+  small.set(17, 5);
+  small.set(40, 2);
+
+  CHECK(scan(yat::bitmap_scanner{small, true, {0, 2}}) ==
+        range_list{{10, 12}, {40, 2}});
+  CHECK(scan(yat::bitmap_scanner{small, true, {3, 2}}) ==
+        range_list{{10, 12}});
+  CHECK(scan(yat::bitmap_scanner{small, true, {6, 0}}).empty());
+}
+
+// Checks that a bitmap's storage is aligned and that its padding is unset
+template <typename Bitmap>
+static void check_storage(const Bitmap& bm) {
+  const auto* words = yat::bitmap_view{bm}.words().data();
+  REQUIRE(reinterpret_cast<uintptr_t>(words) % Bitmap::alignment == 0);
+
+  // The padding words are readable and unset
+  const auto block = Bitmap::alignment / sizeof(uint64_t);
+  const auto used = (bm.count() + 63) / 64;
+  const auto padded = (used + block - 1) / block * block;
+
+  for (auto w = used; w < padded; w++) {
+    REQUIRE(words[w] == 0U);
+  }
+
+  if (const auto n = bm.count() % 64; n != 0) {
+    REQUIRE((words[used - 1] >> n) == 0U);
+  }
+}
+
+TEST_CASE("bitmap storage", "[bitmap]") {
+  std::mt19937_64 rng(random_seed);
+
+  for (int round = 0; round < 100; round++) {
+    const auto num_bits = rng() % 5000 + 1;
+    yat::bitmap bm{num_bits};
+    bm.set(0, num_bits);
+    check_storage(bm);
+
+    // Shrinking clears the bits that were cut off
+    const auto shrunk = rng() % num_bits;
+    bm.resize(shrunk);
+    check_storage(bm);
+    bm.resize(num_bits);
+    check_storage(bm);
+    REQUIRE(bm.count_set() == shrunk);
+
+    // Copies of views don't bring along bits beyond the end of the view
+    yat::bitmap all{num_bits};
+    all.set(0, num_bits);
+    const yat::bitmap copy{
+        yat::bitmap_view{yat::bitmap_view{all}.words().data(), shrunk}};
+    check_storage(copy);
+    REQUIRE(copy.count_set() == shrunk);
+  }
+
+  yat::basic_bitmap<std::allocator<yat::little_uint64_t>, 128> wide{1000};
+  wide.set(0, 1000);
+  check_storage(wide);
+  REQUIRE(yat::bitmap{wide}.count_set() == 1000);
+}
+
+TEST_CASE("bitmap (pmr)", "[bitmap]") {
+  std::array<std::byte, 4096> buffer{};
+  std::pmr::monotonic_buffer_resource resource{
+      buffer.data(), buffer.size(), std::pmr::null_memory_resource()};
+
+  yat::pmr::bitmap bm{1000, &resource};
+  REQUIRE(bm.get_allocator().resource() == &resource);
+  check_storage(bm);
+
+  const auto* words = yat::bitmap_view{bm}.words().data();
+  REQUIRE(static_cast<const void*>(words) >= buffer.data());
+  REQUIRE(static_cast<const void*>(words) < buffer.data() + buffer.size());
+
+  bm.set(10, 500);
+  bm.flip(0, 20);
+
+  auto expected = yat::bitmap{1000};
+  expected.set(10, 500);
+  expected.flip(0, 20);
+
+  REQUIRE(yat::bitmap{bm}.count_set() == expected.count_set());
+  REQUIRE((yat::bitmap{bm} ^ expected).none_set());
+
+  // Bitmaps made from views use the allocator that they are given
+  const yat::pmr::bitmap copy{expected, &resource};
+  REQUIRE(copy.get_allocator().resource() == &resource);
+  REQUIRE((expected ^ copy).none_set());
+}
+
+// Stores the bits of a bitmap as `Word`s with bits numbered in `Order`
+template <typename Word, yat::bit_order Order>
+static std::vector<uint64_t> encode_layout(const yat::bitmap_view& bm) {
+  constexpr uint64_t word_bits = sizeof(Word) * 8;
+  constexpr bool big = yat::detail::is_big_endian_word_v<Word>;
+
+  std::vector<uint64_t> data((bm.count() + 63) / 64);
+  auto* bytes = reinterpret_cast<unsigned char*>(data.data());
+
+  for (uint64_t i = 0; i < bm.count(); i++) {
+    if (!bm[i]) {
+      continue;
+    }
+
+    // Find the bit of the word's value and then the byte that it's stored in
+    const auto b = i % word_bits;
+    const auto v = (Order == yat::bit_order::lsb_first) ? b : word_bits - 1 - b;
+    const auto byte = big ? sizeof(Word) - 1 - v / 8 : v / 8;
+
+    bytes[i / word_bits * sizeof(Word) + byte] |=
+        static_cast<unsigned char>(1U << (v % 8));
+  }
+
+  return data;
+}
+
+template <typename Word, yat::bit_order Order>
+static void check_layout(uint64_t seed) {
+  using view = yat::basic_bitmap_view<Word, Order>;
+  using scanner = yat::basic_bitmap_scanner<Word, Order>;
+
+  std::mt19937_64 rng(random_seed + seed);
+
+  for (int round = 0; round < 20; round++) {
+    const auto num_bits = rng() % 3000 + 1;
+    const auto bm = generate_random_bitmap(num_bits, seed + 100 + rng() % 100);
+    const auto other = generate_random_bitmap(num_bits, seed + 200);
+
+    const auto data = encode_layout<Word, Order>(bm);
+    const auto other_data = encode_layout<Word, Order>(other);
+    const view v{data.data(), num_bits};
+    const view ov{other_data.data(), num_bits};
+
+    for (uint64_t i = 0; i < num_bits; i++) {
+      REQUIRE(v[i] == bm[i]);
+    }
+
+    REQUIRE(v.count_set() == bm.count_set());
+
+    const auto start = rng() % num_bits;
+    const auto count = rng() % (num_bits - start + 1);
+    REQUIRE(v.count_set(start, count) == bm.count_set(start, count));
+    REQUIRE(v.all_set(start, count) == bm.all_set(start, count));
+    REQUIRE(v.none_set(start, count) == bm.none_set(start, count));
+    REQUIRE(v.find_next_set(start) == bm.find_next_set(start));
+    REQUIRE(v.find_next_clear(start) == bm.find_next_clear(start));
+    REQUIRE(v.find_prev_set(start) == bm.find_prev_set(start));
+    REQUIRE(v.find_prev_clear(start) == bm.find_prev_clear(start));
+
+    for (const bool scan_set : {true, false}) {
+      const scanner s{v, scan_set};
+      REQUIRE(std::vector<yat::bitmap_range>(s.begin(), s.end()) ==
+              std::vector<yat::bitmap_range>(
+                  yat::bitmap_scanner{bm, scan_set}.begin(),
+                  yat::bitmap_scanner{bm, scan_set}.end()));
+
+      std::vector<yat::bitmap_range> reversed{};
+      for (auto it = s.rbegin(); it != s.rend(); ++it) {
+        reversed.insert(reversed.begin(), *it);
+      }
+      REQUIRE(reversed ==
+              std::vector<yat::bitmap_range>(s.begin(), s.end()));
+
+      for (const auto op : {yat::bitwise_op::bit_and, yat::bitwise_op::bit_or,
+                            yat::bitwise_op::bit_xor,
+                            yat::bitwise_op::bit_and_not}) {
+        const scanner os{v, op, ov, scan_set};
+        const yat::bitmap_scanner expected{bm, op, other, scan_set};
+        REQUIRE(std::vector<yat::bitmap_range>(os.begin(), os.end()) ==
+                std::vector<yat::bitmap_range>(expected.begin(),
+                                               expected.end()));
+      }
+    }
+
+    const yat::basic_bitmap_run_scanner<Word, Order> runs{v};
+    const yat::bitmap_run_scanner expected_runs{bm};
+    REQUIRE(std::vector<yat::bitmap_run>(runs.begin(), runs.end()) ==
+            std::vector<yat::bitmap_run>(expected_runs.begin(),
+                                         expected_runs.end()));
+  }
+}
+
+TEST_CASE("bitmap layouts", "[bitmap][bitmap_scanner]") {
+  using yat::bit_order;
+
+  // The yat::bitmap layout with another word width
+  check_layout<yat::little_uint32_t, bit_order::lsb_first>(0);
+
+  check_layout<uint8_t, bit_order::msb_first>(1);
+  check_layout<yat::big_uint16_t, bit_order::lsb_first>(2);
+  check_layout<yat::little_uint16_t, bit_order::msb_first>(3);
+  check_layout<yat::big_uint32_t, bit_order::lsb_first>(4);
+  check_layout<yat::big_uint32_t, bit_order::msb_first>(5);
+  check_layout<yat::little_uint32_t, bit_order::msb_first>(6);
+  check_layout<yat::big_uint64_t, bit_order::lsb_first>(7);
+  check_layout<yat::big_uint64_t, bit_order::msb_first>(8);
+
+  // A hand-written MSB first big endian 32-bit word
+  const std::array<yat::big_uint32_t, 2> words{0x80000001U, 0};
+  const yat::basic_bitmap_view<yat::big_uint32_t, bit_order::msb_first> v{
+      words.data(), 32};
+  REQUIRE(v[0]);
+  REQUIRE(v[31]);
+  REQUIRE(v.count_set() == 2);
+  REQUIRE(v.find_next_set(1) == 31);
+}
+
+TEST_CASE("bitmap_view (byte buffers)", "[bitmap][bitmap_scanner]") {
+  std::mt19937_64 rng(random_seed);
+
+  for (int round = 0; round < 200; round++) {
+    const auto num_bits = rng() % 2000 + 1;
+    const auto num_bytes = static_cast<size_t>((num_bits + 7) / 8);
+    const auto offset = static_cast<size_t>(rng() % 8);
+    const auto bm = generate_random_bitmap(num_bits, rng() % 100);
+    const auto other = generate_random_bitmap(num_bits, rng() % 100);
+
+    // Copy the bits to an odd offset of a buffer that ends right after them,
+    // so that reading past the end is caught by the sanitizers
+    const auto copy_bytes = [&](const yat::bitmap_view& v) {
+      auto buffer = std::make_unique<std::byte[]>(offset + num_bytes);
+      std::memcpy(buffer.get() + offset, v.words().data(), num_bytes);
+      return buffer;
+    };
+
+    const auto data = copy_bytes(bm);
+    const auto other_data = copy_bytes(other);
+    const yat::bitmap_view v{{data.get() + offset, num_bytes}, num_bits};
+    const yat::bitmap_view ov{{other_data.get() + offset, num_bytes}, num_bits};
+
+    for (uint64_t i = 0; i < num_bits; i++) {
+      REQUIRE(v[i] == bm[i]);
+    }
+
+    const auto start = rng() % num_bits;
+    const auto count = rng() % (num_bits - start + 1);
+    REQUIRE(v.count_set() == bm.count_set());
+    REQUIRE(v.count_set(start, count) == bm.count_set(start, count));
+    REQUIRE(v.all_set(start, count) == bm.all_set(start, count));
+    REQUIRE(v.none_set(start, count) == bm.none_set(start, count));
+    REQUIRE(v.find_next_set(start) == bm.find_next_set(start));
+    REQUIRE(v.find_next_clear(start) == bm.find_next_clear(start));
+    REQUIRE(v.find_prev_set(start) == bm.find_prev_set(start));
+    REQUIRE(v.find_prev_clear(start) == bm.find_prev_clear(start));
+    REQUIRE(v.find_first_run(8, true) == bm.find_first_run(8, true));
+
+    // Copies and bitwise operations see the same bits
+    REQUIRE((yat::bitmap{v} ^ bm).none_set());
+    REQUIRE((bm ^ v).none_set());
+    REQUIRE(((other & v) ^ (other & bm)).none_set());
+
+    for (const bool scan_set : {true, false}) {
+      const yat::bitmap_scanner s{v, scan_set};
+      REQUIRE(scan(s) == naive_scan(bm, num_bits, scan_set));
+
+      std::vector<yat::bitmap_range> reversed{};
+      for (auto it = s.rbegin(); it != s.rend(); ++it) {
+        reversed.push_back(*it);
+      }
+      std::reverse(reversed.begin(), reversed.end());
+      REQUIRE(reversed == std::vector<yat::bitmap_range>(s.begin(), s.end()));
+
+      for (const auto op : {yat::bitwise_op::bit_and, yat::bitwise_op::bit_or,
+                            yat::bitwise_op::bit_xor,
+                            yat::bitwise_op::bit_and_not}) {
+        REQUIRE(scan(yat::bitmap_scanner{v, op, ov, scan_set}) ==
+                scan(yat::bitmap_scanner{bm, op, other, scan_set}));
+      }
+    }
+  }
+
+  // Foreign layouts can also be viewed over byte buffers
+  const std::array<std::byte, 3> bytes{std::byte{0x80}, std::byte{0x00},
+                                       std::byte{0x01}};
+  const yat::basic_bitmap_view<uint8_t, yat::bit_order::msb_first> msb{
+      bytes, 24};
+  REQUIRE(msb.count_set() == 2);
+  REQUIRE(msb.find_next_set(0) == 0);
+  REQUIRE(msb.find_next_set(1) == 23);
+  REQUIRE(msb.find_prev_set(23) == 0);
+}
+
+TEST_CASE("bitmap flatten kernels", "[bitmap][simd]") {
+  using yat::detail::simd_isa;
+
+  std::mt19937_64 rng(random_seed);
+
+  // A mix of empty, sparse, dense and full words
+  std::vector<yat::little_uint64_t> words(300);
+
+  for (auto& w : words) {
+    switch (rng() % 4) {
+      case 0:
+        w = 0;
+        break;
+      case 1:
+        w = rng() & rng() & rng();
+        break;
+      case 2:
+        w = rng();
+        break;
+      default:
+        w = ~uint64_t{0};
+        break;
+    }
+  }
+
+  for (const auto isa :
+       {simd_isa::scalar, simd_isa::sse2, simd_isa::avx2, simd_isa::avx512}) {
+    if (!yat::detail::simd_isa_supported(isa)) {
+      continue;
+    }
+
+    const auto& kernels = yat::detail::bitmap_kernels_for(isa);
+
+    for (int i = 0; i < 200; i++) {
+      const auto first = static_cast<size_t>(rng() % words.size());
+      const auto last =
+          first + static_cast<size_t>(rng() % (words.size() - first + 1));
+      const uint64_t flip = (rng() & 1) ? ~uint64_t{0} : 0;
+      const auto capacity = static_cast<size_t>(rng() % 2000);
+
+      // The kernels stop before the first word that doesn't fit
+      std::vector<uint64_t> expected{};
+      size_t stop = first;
+
+      for (; stop < last; stop++) {
+        const uint64_t bits = words[stop] ^ flip;
+
+        if (expected.size() + static_cast<size_t>(yat::popcount(bits)) >
+            capacity) {
+          break;
+        }
+
+        for (uint64_t b = 0; b < 64; b++) {
+          if ((bits >> b) & 1) {
+            expected.push_back(stop * 64 + b);
+          }
+        }
+      }
+
+      std::vector<uint32_t> out32(capacity);
+      auto w = first;
+      auto n = kernels.flatten32(words.data(), w, last, flip, out32.data(),
+                                 capacity);
+      REQUIRE(w == stop);
+      REQUIRE(n == expected.size());
+      REQUIRE(std::equal(expected.begin(), expected.end(), out32.begin()));
+
+      std::vector<uint64_t> out64(capacity);
+      w = first;
+      n = kernels.flatten64(words.data(), w, last, flip, out64.data(),
+                            capacity);
+      REQUIRE(w == stop);
+      REQUIRE(n == expected.size());
+      REQUIRE(std::equal(expected.begin(), expected.end(), out64.begin()));
+    }
+  }
+}
+
+// Flattens the bits of a view in batches of `batch_size` indices
+template <typename T, typename View>
+static std::vector<uint64_t> flatten_all(const View& view, bool set,
+                                         uint64_t first, size_t batch_size) {
+  std::vector<uint64_t> indices{};
+  std::vector<T> out(batch_size);
+
+  while (true) {
+    const auto batch = view.flatten(yat::span<T>{out}, set, first);
+    indices.insert(indices.end(), out.begin(),
+                   out.begin() + static_cast<std::ptrdiff_t>(batch.count));
+
+    if (batch.cursor == view.count()) {
+      return indices;
+    }
+
+    REQUIRE(batch.cursor > first);
+    first = batch.cursor;
+  }
+}
+
+TEST_CASE("bitmap flatten", "[bitmap]") {
+  std::mt19937_64 rng(random_seed);
+
+  for (int round = 0; round < 200; round++) {
+    const auto num_bits = rng() % 5000 + 1;
+    auto bm = generate_random_bitmap(num_bits, rng() % 100);
+
+    // Sprinkle in scattered bits
+    for (int i = 0; i < 50; i++) {
+      bm.flip(rng() % num_bits);
+    }
+
+    const auto first = rng() % (num_bits + 1);
+    const auto batch_size = static_cast<size_t>(rng() % 300 + 1);
+
+    for (const bool set : {true, false}) {
+      std::vector<uint64_t> expected{};
+
+      for (auto i = first; i < num_bits; i++) {
+        if (bm[i] == set) {
+          expected.push_back(i);
+        }
+      }
+
+      REQUIRE(flatten_all<uint32_t>(bm, set, first, batch_size) == expected);
+      REQUIRE(flatten_all<uint64_t>(bm, set, first, batch_size) == expected);
+
+      // A view of the same bits in another layout
+      const auto bytes = encode_layout<uint8_t, yat::bit_order::msb_first>(bm);
+      const yat::basic_bitmap_view<uint8_t, yat::bit_order::msb_first> msb{
+          bytes.data(), num_bits};
+      REQUIRE(flatten_all<uint32_t>(msb, set, first, batch_size) == expected);
+
+      // A view over a byte buffer with a partial last word
+      const auto num_bytes = static_cast<size_t>((num_bits + 7) / 8);
+      auto buffer = std::make_unique<std::byte[]>(num_bytes);
+      std::memcpy(buffer.get(), yat::bitmap_view{bm}.words().data(), num_bytes);
+      const yat::bitmap_view tail{yat::span<const std::byte>{buffer.get(),
+                                                             num_bytes},
+                                  num_bits};
+      REQUIRE(flatten_all<uint64_t>(tail, set, first, batch_size) ==
+              expected);
+
+      // The whole range in one batch
+      std::vector<uint32_t> out(num_bits);
+      const auto batch = bm.flatten(out, set, first);
+      REQUIRE(batch.count == expected.size());
+      REQUIRE(batch.cursor == num_bits);
+      REQUIRE(std::equal(expected.begin(), expected.end(), out.begin()));
+    }
+  }
+
+  // An empty output span only advances past bits that aren't wanted
+  yat::bitmap bm{200};
+  bm.set(130);
+  REQUIRE(bm.flatten(yat::span<uint32_t>{}).cursor == 130);
+  REQUIRE(bm.flatten(yat::span<uint64_t>{}, true, 131).cursor == 200);
+  REQUIRE(bm.flatten(yat::span<uint64_t>{}, true, 500).cursor == 200);
+}
+
+TEST_CASE("views::set_bits", "[bitmap]") {
+  static_assert(yat::ranges::input_range<yat::set_bits_view>);
+  static_assert(yat::ranges::view<yat::set_bits_view>);
+
+  std::mt19937_64 rng(random_seed);
+
+  for (int round = 0; round < 50; round++) {
+    const auto num_bits = rng() % 5000 + 1;
+    const auto bm = generate_random_bitmap(num_bits, rng() % 100);
+
+    std::vector<uint64_t> set{};
+    std::vector<uint64_t> unset{};
+
+    for (uint64_t i = 0; i < num_bits; i++) {
+      (bm[i] ? set : unset).push_back(i);
+    }
+
+    std::vector<uint64_t> found{};
+    for (const auto i : yat::views::set_bits(bm)) {
+      found.push_back(i);
+    }
+    REQUIRE(found == set);
+
+    found.clear();
+    for (const auto i : yat::views::unset_bits(bm)) {
+      found.push_back(i);
+    }
+    REQUIRE(found == unset);
+
+    // Other layouts are decoded in place
+    const auto bytes = encode_layout<uint8_t, yat::bit_order::msb_first>(bm);
+    const yat::basic_bitmap_view<uint8_t, yat::bit_order::msb_first> msb{
+        bytes.data(), num_bits};
+
+    found.clear();
+    for (const auto i : yat::views::set_bits(msb)) {
+      found.push_back(i);
+    }
+    REQUIRE(found == set);
+  }
+
+  // Feed a ranges pipeline
+  yat::bitmap bm{1000};
+  for (uint64_t i = 0; i < 1000; i += 7) {
+    bm.set(i);
+  }
+
+  std::vector<uint64_t> found{};
+  for (const auto i : yat::views::set_bits(bm) | yat::views::take(4)) {
+    found.push_back(i);
+  }
+  REQUIRE(found == std::vector<uint64_t>{0, 7, 14, 21});
+
+  const yat::bitmap empty{100};
+  REQUIRE(yat::views::set_bits(empty).begin() ==
+          yat::views::set_bits(empty).end());
+
+  // Iterators compare by position and postfix increment keeps the old index
+  const auto view = yat::views::set_bits(bm);
+  auto it = view.begin();
+  const auto start = it;
+  REQUIRE(*it++ == 0);
+  REQUIRE(*it == 7);
+  REQUIRE(it != start);
+  REQUIRE(std::distance(view.begin(), view.end()) == 143);
+}
+
+// Generates values that often equal `rhs` or its neighbours
+template <typename T>
+static std::vector<T> generate_compare_values(size_t n, T rhs,
+                                              std::mt19937_64& rng) {
+  std::vector<T> values(n);
+
+  for (auto& v : values) {
+    switch (rng() % 3) {
+      case 0:
+        v = rhs;
+        break;
+      case 1:
+        if constexpr (std::is_floating_point_v<T>) {
+          v = static_cast<T>(static_cast<int64_t>(rng())) /
+              static_cast<T>(1 << 20);
+        } else {
+          v = static_cast<T>(rng());
+        }
+        break;
+      default:
+        if constexpr (std::is_floating_point_v<T>) {
+          v = static_cast<T>(static_cast<int64_t>(rng() % 5) - 2) + rhs;
+        } else {
+          // Wrap around instead of overflowing
+          v = static_cast<T>(static_cast<uint64_t>(rhs) + rng() % 5 - 2);
+        }
+        break;
+    }
+  }
+
+  return values;
+}
+
+template <typename T>
+static void check_compare_kernels(std::mt19937_64& rng) {
+  using yat::detail::simd_isa;
+
+  constexpr size_t num_words = 5;
+
+  for (int round = 0; round < 20; round++) {
+    // Include the extremes, where the sign bit flips of the unsigned
+    // comparisons matter
+    T rhs{};
+    switch (round % 3) {
+      case 0:
+        rhs = std::numeric_limits<T>::lowest();
+        break;
+      case 1:
+        rhs = std::numeric_limits<T>::max();
+        break;
+      default:
+        rhs = generate_compare_values<T>(1, T{}, rng)[0];
+        break;
+    }
+
+    auto values = generate_compare_values<T>(num_words * 64, rhs, rng);
+
+    if constexpr (std::is_floating_point_v<T>) {
+      values[3] = std::numeric_limits<T>::quiet_NaN();
+    }
+
+    for (const auto op :
+         {yat::compare_op::equal, yat::compare_op::not_equal,
+          yat::compare_op::less, yat::compare_op::less_equal,
+          yat::compare_op::greater, yat::compare_op::greater_equal}) {
+      std::vector<yat::little_uint64_t> expected(num_words);
+
+      for (size_t i = 0; i < values.size(); i++) {
+        if (yat::detail::compare_values(op, values[i], rhs)) {
+          expected[i / 64] = expected[i / 64] | (uint64_t{1} << (i % 64));
+        }
+      }
+
+      for (const auto isa : {simd_isa::scalar, simd_isa::sse2, simd_isa::avx2,
+                             simd_isa::avx512}) {
+        if (!yat::detail::simd_isa_supported(isa)) {
+          continue;
+        }
+
+        std::vector<yat::little_uint64_t> out(num_words);
+        yat::detail::compare_words(values.data(), num_words, op, rhs,
+                                   out.data(), isa);
+        REQUIRE(out == expected);
+      }
+    }
+  }
+}
+
+TEST_CASE("bitmap compare kernels", "[bitmap][simd]") {
+  std::mt19937_64 rng(random_seed);
+
+  check_compare_kernels<int8_t>(rng);
+  check_compare_kernels<uint8_t>(rng);
+  check_compare_kernels<int16_t>(rng);
+  check_compare_kernels<uint16_t>(rng);
+  check_compare_kernels<int32_t>(rng);
+  check_compare_kernels<uint32_t>(rng);
+  check_compare_kernels<int64_t>(rng);
+  check_compare_kernels<uint64_t>(rng);
+  check_compare_kernels<float>(rng);
+  check_compare_kernels<double>(rng);
+}
+
+TEST_CASE("bitmap from_predicate", "[bitmap]") {
+  std::mt19937_64 rng(random_seed);
+
+  for (int round = 0; round < 100; round++) {
+    const auto n = static_cast<size_t>(rng() % 3000);
+    const auto values = generate_compare_values<uint32_t>(n, 1000, rng);
+    const auto pred = [](uint32_t v) { return v % 3 == 0; };
+
+    const auto bm =
+        yat::bitmap::from_predicate(yat::span<const uint32_t>{values}, pred);
+    REQUIRE(bm.count() == n);
+
+    const auto cmp = yat::bitmap::from_compare(
+        yat::span<const uint32_t>{values}, yat::compare_op::greater, 1000);
+    REQUIRE(cmp.count() == n);
+
+    for (size_t i = 0; i < n; i++) {
+      REQUIRE(bm[i] == pred(values[i]));
+      REQUIRE(cmp[i] == (values[i] > 1000));
+    }
+
+    // Assigning part of a bitmap leaves the other bits alone
+    auto target = generate_random_bitmap(n + 200, rng() % 100);
+    const yat::bitmap original{target};
+    const auto first = rng() % 200;
+
+    target.assign_compare(first, yat::span<const uint32_t>{values},
+                          yat::compare_op::less_equal, 1000);
+
+    for (uint64_t i = 0; i < target.count(); i++) {
+      if (i < first || i >= first + n) {
+        REQUIRE(target[i] == original[i]);
+      } else {
+        REQUIRE(target[i] ==
+                (values[static_cast<size_t>(i - first)] <= 1000));
+      }
+    }
+  }
+
+  // Types without vectorized comparisons use the scalar fallback
+  std::vector<std::string> names{"a", "b", "c", "a"};
+  const auto a = yat::bitmap::from_compare(yat::span<std::string>{names},
+                                           yat::compare_op::equal, "a");
+  REQUIRE(a.count() == 4);
+  REQUIRE(a[0]);
+  REQUIRE(!a[1]);
+  REQUIRE(!a[2]);
+  REQUIRE(a[3]);
+}
+
+template <typename T>
+static void check_compact_kernels(std::mt19937_64& rng) {
+  using yat::detail::simd_isa;
+
+  std::vector<T> in(64);
+
+  for (size_t i = 0; i < in.size(); i++) {
+    in[i] = static_cast<T>(i + 1000);
+  }
+
+  for (int round = 0; round < 200; round++) {
+    uint64_t bits = rng();
+
+    switch (round % 4) {
+      case 0:
+        bits &= rng() & rng();
+        break;
+      case 1:
+        bits |= rng() | rng();
+        break;
+      default:
+        break;
+    }
+
+    std::vector<T> expected{};
+    for (size_t i = 0; i < 64; i++) {
+      if ((bits >> i) & 1) {
+        expected.push_back(in[i]);
+      }
+    }
+
+    for (const auto isa :
+         {simd_isa::scalar, simd_isa::sse2, simd_isa::avx2, simd_isa::avx512}) {
+      if (!yat::detail::simd_isa_supported(isa)) {
+        continue;
+      }
+
+      std::vector<T> out(64);
+      const auto n =
+          yat::detail::compact_word_kernel<T>(isa)(bits, in.data(), out.data());
+      REQUIRE(n == expected.size());
+      out.resize(n);
+      REQUIRE(out == expected);
+    }
+  }
+}
+
+TEST_CASE("bitmap compact kernels", "[bitmap][simd]") {
+  std::mt19937_64 rng(random_seed);
+
+  check_compact_kernels<int16_t>(rng);
+  check_compact_kernels<int32_t>(rng);
+  check_compact_kernels<uint64_t>(rng);
+  check_compact_kernels<float>(rng);
+  check_compact_kernels<double>(rng);
+}
+
+TEST_CASE("bitmap compact", "[bitmap]") {
+  std::mt19937_64 rng(random_seed);
+
+  for (int round = 0; round < 200; round++) {
+    const auto num_bits = rng() % 3000;
+    auto selection = generate_random_bitmap(num_bits, rng() % 100);
+
+    for (int i = 0; i < 50 && num_bits != 0; i++) {
+      selection.flip(rng() % num_bits);
+    }
+
+    // The columns might be shorter or longer than the selection
+    const auto rows = static_cast<size_t>(
+        (rng() & 1) ? num_bits : rng() % (num_bits + 100));
+
+    std::vector<uint32_t> ids(rows);
+    std::vector<double> values(rows);
+    std::vector<uint8_t> flags(rows);
+
+    for (size_t i = 0; i < rows; i++) {
+      ids[i] = static_cast<uint32_t>(i);
+      values[i] = static_cast<double>(i) / 2;
+      flags[i] = static_cast<uint8_t>(i);
+    }
+
+    std::vector<size_t> expected{};
+    for (size_t i = 0; i < std::min<size_t>(rows, num_bits); i++) {
+      if (selection[i]) {
+        expected.push_back(i);
+      }
+    }
+
+    // Sometimes there's only room for part of the selection
+    auto capacity = expected.size();
+    if (round % 3 == 0) {
+      capacity = static_cast<size_t>(rng() % (capacity + 1));
+    }
+
+    std::vector<uint32_t> out_ids(capacity);
+    const auto n = yat::compact(selection, ids, yat::span<uint32_t>{out_ids});
+    REQUIRE(n == capacity);
+
+    for (size_t i = 0; i < n; i++) {
+      REQUIRE(out_ids[i] == expected[i]);
+    }
+
+    std::vector<uint32_t> ids2(capacity);
+    std::vector<double> values2(capacity);
+    std::vector<uint8_t> flags2(capacity);
+
+    const auto m = yat::compact(
+        selection,
+        std::tuple{yat::span<const uint32_t>{ids},
+                   yat::span<const double>{values},
+                   yat::span<const uint8_t>{flags}},
+        std::tuple{yat::span<uint32_t>{ids2}, yat::span<double>{values2},
+                   yat::span<uint8_t>{flags2}});
+    REQUIRE(m == capacity);
+
+    for (size_t i = 0; i < m; i++) {
+      REQUIRE(ids2[i] == expected[i]);
+      REQUIRE(values2[i] == static_cast<double>(expected[i]) / 2);
+      REQUIRE(flags2[i] == static_cast<uint8_t>(expected[i]));
+    }
+  }
+
+  // Types that can't be copied as bits use the scalar path
+  const std::vector<std::string> names{"a", "b", "c", "d"};
+  yat::bitmap selection{4};
+  selection.set(1);
+  selection.set(3);
+
+  std::vector<std::string> out(4);
+  REQUIRE(yat::compact(selection, names, yat::span<std::string>{out}) == 2);
+  REQUIRE(out[0] == "b");
+  REQUIRE(out[1] == "d");
+}
+
+// Copies bits one at a time
+static void naive_copy_bits(std::vector<bool>& dst, uint64_t dst_offset,
+                            const std::vector<bool>& src, uint64_t src_offset,
+                            uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) {
+    dst[static_cast<size_t>(dst_offset + i)] =
+        src[static_cast<size_t>(src_offset + i)];
+  }
+}
+
+static std::vector<bool> to_bools(const yat::bitmap_view& bm) {
+  std::vector<bool> bits(static_cast<size_t>(bm.count()));
+
+  for (uint64_t i = 0; i < bm.count(); i++) {
+    bits[static_cast<size_t>(i)] = bm[i];
+  }
+
+  return bits;
+}
+
+TEST_CASE("bitmap copy_bits", "[bitmap]") {
+  std::mt19937_64 rng(random_seed);
+
+  for (int round = 0; round < 500; round++) {
+    const auto src_bits = rng() % 1500 + 1;
+    const auto dst_bits = rng() % 1500 + 1;
+    const auto src = generate_random_bitmap(src_bits, rng() % 100);
+    auto dst = generate_random_bitmap(dst_bits, rng() % 100);
+
+    const auto src_offset = rng() % src_bits;
+    const auto dst_offset = rng() % dst_bits;
+    const auto n =
+        rng() % (std::min(src_bits - src_offset, dst_bits - dst_offset) + 1);
+
+    auto expected = to_bools(dst);
+    naive_copy_bits(expected, dst_offset, to_bools(src), src_offset, n);
+    dst.copy_bits(dst_offset, src, src_offset, n);
+    REQUIRE(to_bools(dst) == expected);
+    check_storage(dst);
+
+    // Copy from a view over a byte buffer that ends right after the bits
+    const auto num_bytes = static_cast<size_t>((src_bits + 7) / 8);
+    auto buffer = std::make_unique<std::byte[]>(num_bytes + 1);
+    std::memcpy(buffer.get() + 1, yat::bitmap_view{src}.words().data(),
+                num_bytes);
+    const yat::bitmap_view bytes{{buffer.get() + 1, num_bytes}, src_bits};
+
+    dst.clear(0, dst_bits);
+    std::fill(expected.begin(), expected.end(), false);
+    naive_copy_bits(expected, dst_offset, to_bools(src), src_offset, n);
+    dst.copy_bits(dst_offset, bytes, src_offset, n);
+    REQUIRE(to_bools(dst) == expected);
+
+    // Overlapping copies within the same bitmap work in both directions
+    const auto from = rng() % dst_bits;
+    const auto to = rng() % dst_bits;
+    const auto m = rng() % (dst_bits - std::max(from, to) + 1);
+
+    expected = to_bools(dst);
+    naive_copy_bits(expected, to, std::vector<bool>{expected}, from, m);
+    dst.copy_bits(to, dst, from, m);
+    REQUIRE(to_bools(dst) == expected);
+    check_storage(dst);
+  }
+}
+
+TEST_CASE("bitmap slice and shift", "[bitmap]") {
+  std::mt19937_64 rng(random_seed);
+
+  for (int round = 0; round < 300; round++) {
+    const auto num_bits = rng() % 1500 + 1;
+    const auto bm = generate_random_bitmap(num_bits, rng() % 100);
+    const auto bits = to_bools(bm);
+
+    // Slices
+    const auto first = rng() % num_bits;
+    const auto n = rng() % (num_bits - first + 1);
+    const auto slice = bm.slice(first, n);
+
+    REQUIRE(slice.count() == n);
+    const auto sliced =
+        std::vector<bool>(bits.begin() + static_cast<ptrdiff_t>(first),
+                          bits.begin() + static_cast<ptrdiff_t>(first + n));
+    REQUIRE(to_bools(slice) == sliced);
+    check_storage(slice);
+
+    // Shifts, including ones that move every bit out
+    const auto shift = rng() % (num_bits + 10);
+    std::vector<bool> left(bits.size());
+    std::vector<bool> right(bits.size());
+
+    for (uint64_t i = shift; i < num_bits; i++) {
+      left[static_cast<size_t>(i)] = bits[static_cast<size_t>(i - shift)];
+      right[static_cast<size_t>(i - shift)] = bits[static_cast<size_t>(i)];
+    }
+
+    yat::bitmap shifted{bm};
+    REQUIRE(to_bools(shifted.shift_left(shift)) == left);
+    check_storage(shifted);
+
+    shifted = bm;
+    REQUIRE(to_bools(shifted.shift_right(shift)) == right);
+    check_storage(shifted);
+
+    shifted = bm;
+    REQUIRE(to_bools(shifted.shift_left(0)) == bits);
+
+    // Appending other bitmaps and the bitmap itself
+    auto appended = generate_random_bitmap(rng() % 300, rng() % 100);
+    auto expected = to_bools(appended);
+
+    appended.append(bm);
+    expected.insert(expected.end(), bits.begin(), bits.end());
+    REQUIRE(to_bools(appended) == expected);
+    check_storage(appended);
+
+    const auto before = expected;
+    appended.append(appended);
+    expected.insert(expected.end(), before.begin(), before.end());
+    REQUIRE(to_bools(appended) == expected);
+    check_storage(appended);
+  }
+
+  // Appending to and from empty bitmaps
+  yat::bitmap empty{};
+  empty.append(yat::bitmap{});
+  REQUIRE(empty.count() == 0);
+
+  yat::bitmap ones{70};
+  ones.set(0, 70);
+  empty.append(ones);
+  REQUIRE(empty.count() == 70);
+  REQUIRE(empty.all_set());
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2020 Joe T. Sylve, Ph.D.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <yatlib/chained_bitmap_scanner.hpp>
+
+#include "common.hpp"
+
+// Scans a bitmap made of copies of the chunks of a logical bitmap
+static std::vector<yat::bitmap_range> scan_chunks(
+    const std::vector<yat::bitmap>& chunks,
+    const std::vector<uint64_t>& offsets, bool scan_set, size_t& fetched) {
+  size_t next = 0;
+
+  yat::chained_bitmap_scanner scanner{
+      [&]() -> yat::optional<yat::bitmap_chunk> {
+        if (next == chunks.size()) {
+          return yat::nullopt;
+        }
+
+        fetched++;
+        next++;
+        return yat::bitmap_chunk{offsets[next - 1], chunks[next - 1]};
+      },
+      scan_set};
+
+  std::vector<yat::bitmap_range> ranges{};
+
+  for (const auto& r : scanner) {
+    ranges.push_back(r);
+  }
+
+  return ranges;
+}
+
+static std::vector<yat::bitmap_range> scan(const yat::bitmap_view& view,
+                                           bool scan_set) {
+  std::vector<yat::bitmap_range> ranges{};
+
+  for (const auto& r : yat::bitmap_scanner{view, scan_set}) {
+    ranges.push_back(r);
+  }
+
+  return ranges;
+}
+
+TEST_CASE("chained_bitmap_scanner", "[bitmap][chained_bitmap_scanner]") {
+  std::mt19937_64 rng(random_seed);
+
+  for (int round = 0; round < 50; round++) {
+    // Build a logical bitmap with long runs so that plenty of them cross
+    // chunk boundaries
+    const auto num_bits = rng() % 100'000 + 1;
+    yat::bitmap bm{num_bits};
+
+    for (uint64_t i = 0; i < num_bits;) {
+      const auto n = std::min<uint64_t>(num_bits - i, rng() % 3000 + 1);
+
+      if (rng() & 1) {
+        bm.set(i, n);
+      }
+
+      i += n;
+    }
+
+    // Split it into chunks of random sizes, which don't need to be aligned
+    std::vector<yat::bitmap> chunks{};
+    std::vector<uint64_t> offsets{};
+
+    for (uint64_t i = 0; i < num_bits;) {
+      const auto n = std::min<uint64_t>(num_bits - i, rng() % 5000 + 1);
+      yat::bitmap chunk{n};
+
+      for (uint64_t j = 0; j < n; j++) {
+        if (bm[i + j]) {
+          chunk.set(j);
+        }
+      }
+
+      chunks.push_back(std::move(chunk));
+      offsets.push_back(i);
+      i += n;
+    }
+
+    for (const bool scan_set : {true, false}) {
+      size_t fetched = 0;
+      REQUIRE(scan_chunks(chunks, offsets, scan_set, fetched) ==
+              scan(bm, scan_set));
+      REQUIRE(fetched == chunks.size());
+    }
+  }
+}
+
+TEST_CASE("chained_bitmap_scanner (gaps)", "[bitmap][chained_bitmap_scanner]") {
+  yat::bitmap a{100};
+  yat::bitmap b{100};
+
+  a.set(90, 10);
+  b.set(0, 5);
+  b.set(50, 10);
+
+  // The chunks start at 1000 and have a gap of 100 bits between them
+  const std::vector<yat::bitmap> chunks{a, b};
+  const std::vector<uint64_t> offsets{1000, 1200};
+
+  size_t fetched = 0;
+
+  REQUIRE(scan_chunks(chunks, offsets, true, fetched) ==
+          std::vector<yat::bitmap_range>{{1090, 10}, {1200, 5}, {1250, 10}});
+  REQUIRE(scan_chunks(chunks, offsets, false, fetched) ==
+          std::vector<yat::bitmap_range>{
+              {1000, 90}, {1100, 100}, {1205, 45}, {1260, 40}});
+
+  // Adjacent chunks join their ranges
+  const std::vector<uint64_t> adjacent{0, 100};
+
+  REQUIRE(scan_chunks(chunks, adjacent, true, fetched) ==
+          std::vector<yat::bitmap_range>{{90, 15}, {150, 10}});
+
+  // No chunks at all
+  REQUIRE(scan_chunks({}, {}, true, fetched).empty());
+}
@@ -13,6 +13,12 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+#include <yatlib/bitmap.hpp>
 #include <yatlib/features.hpp>
 
 YAT_IGNORE_MSVC_WARNING_PUSH(4619)
@@ -43,3 +49,71 @@ std::vector<T> generate_random_values(size_t numValuesToTest) {
   }
   return result;
 }
+
+// The (start, count) pairs of the ranges found by a bitmap scanner
+using range_list = std::vector<std::pair<uint64_t, uint64_t>>;
+
+// Collects the ranges found by a bitmap scanner
+template <typename Scanner>
+range_list scan(const Scanner& scanner) {
+  range_list ranges{};
+
+  for (const auto& r : scanner) {
+    ranges.emplace_back(r.start, r.count);
+  }
+
+  return ranges;
+}
+
+// Builds a bitmap out of segments that are empty, full, sparse, dense or made
+// of short alternating runs.  The segments range from a single bit to a couple
+// of compressed_bitmap chunks long.
+inline yat::bitmap generate_random_bitmap(uint64_t num_bits,
+                                          std::mt19937_64& rng) {
+  yat::bitmap bm{num_bits};
+
+  for (uint64_t i = 0; i < num_bits;) {
+    const auto end =
+        i + std::min(num_bits - i, 1 + rng() % (uint64_t{2} << (rng() % 17)));
+
+    switch (rng() % 5) {
+      case 0:  // empty
+        break;
+      case 1:  // full
+        bm.set(i, end - i);
+        break;
+      case 2:  // sparse
+        for (auto j = i + rng() % 64; j < end; j += 1 + rng() % 1024) {
+          bm.set(j);
+        }
+        break;
+      case 3:  // dense
+        for (auto j = i; j < end; j++) {
+          if (rng() % 4 != 0) {
+            bm.set(j);
+          }
+        }
+        break;
+      default:  // short runs
+        for (auto j = i; j < end;) {
+          const auto n = std::min(end - j, 1 + rng() % 12);
+
+          if ((rng() & 1) != 0) {
+            bm.set(j, n);
+          }
+
+          j += n;
+        }
+        break;
+    }
+
+    i = end;
+  }
+
+  return bm;
+}
+
+inline yat::bitmap generate_random_bitmap(uint64_t num_bits, uint64_t seed) {
+  std::mt19937_64 rng(random_seed + seed);
+  return generate_random_bitmap(num_bits, rng);
+}
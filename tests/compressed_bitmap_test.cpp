@@ -0,0 +1,138 @@
+/*
+ * Copyright 2020 Joe T. Sylve, Ph.D.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+#include <yatlib/compressed_bitmap.hpp>
+
+#include "common.hpp"
+
+// Checks that a compressed bitmap has the same bits as a bitmap
+static void check_equal(const yat::compressed_bitmap& cbm,
+                        const yat::bitmap& bm) {
+  REQUIRE(cbm.count() == bm.count());
+
+  uint64_t num_set = 0;
+  for (const auto& r : yat::bitmap_scanner{bm}) {
+    num_set += r.count;
+  }
+  REQUIRE(cbm.count_set() == num_set);
+
+  REQUIRE(scan(yat::compressed_bitmap_scanner{cbm}) ==
+          scan(yat::bitmap_scanner{bm}));
+  REQUIRE(scan(yat::compressed_bitmap_scanner{cbm, false}) ==
+          scan(yat::bitmap_scanner{bm, false}));
+
+  const auto copy = cbm.to_bitmap();
+  REQUIRE(scan(yat::bitmap_scanner{copy}) == scan(yat::bitmap_scanner{bm}));
+}
+
+TEST_CASE("compressed_bitmap", "[bitmap][compressed_bitmap]") {
+  std::mt19937_64 rng(random_seed);
+
+  for (const uint64_t num_bits :
+       {uint64_t{0}, uint64_t{1}, uint64_t{65'536}, uint64_t{65'537},
+        uint64_t{1'000'000}}) {
+    const auto bm = generate_random_bitmap(num_bits, rng);
+    const yat::compressed_bitmap cbm{bm};
+
+    check_equal(cbm, bm);
+
+    const yat::bitmap_view view{bm};
+
+    for (int i = 0; i < 500 && num_bits != 0; i++) {
+      const auto n = rng() % num_bits;
+
+      REQUIRE(cbm[n] == bm[n]);
+      REQUIRE(cbm.find_next_set(n) == view.find_next_set(n));
+      REQUIRE(cbm.find_next_clear(n) == view.find_next_clear(n));
+    }
+  }
+}
+
+TEST_CASE("compressed_bitmap (containers)", "[bitmap][compressed_bitmap]") {
+  using ct = yat::compressed_bitmap::container_type;
+
+  yat::bitmap bm{4 * yat::compressed_bitmap::chunk_bits};
+
+  // Chunk 0 is sparse, chunk 1 is empty, chunk 2 is a single run and chunk 3
+  // is random noise
+  for (uint64_t i = 0; i < 1000; i++) {
+    bm.set(i * 61);
+  }
+
+  bm.set(2 * yat::compressed_bitmap::chunk_bits + 10, 50'000);
+
+  std::mt19937_64 rng(random_seed);
+  for (uint64_t i = 3 * yat::compressed_bitmap::chunk_bits; i < bm.count();
+       i++) {
+    if (rng() & 1) {
+      bm.set(i);
+    }
+  }
+
+  const yat::compressed_bitmap cbm{bm};
+
+  REQUIRE(cbm.num_chunks() == 3);
+  REQUIRE(cbm.chunk_type(0) == ct::array);
+  REQUIRE(cbm.chunk_type(1) == ct::runs);
+  REQUIRE(cbm.chunk_type(2) == ct::bitset);
+  REQUIRE(cbm.memory_usage() < bm.count() / 8);
+  check_equal(cbm, bm);
+
+  // Large, sparse bitmaps stay small
+  yat::bitmap sparse{uint64_t{1} << 32};
+  sparse.set(12345);
+  sparse.set(uint64_t{3} << 30, 1'000'000);
+  REQUIRE(yat::compressed_bitmap{sparse}.memory_usage() < 4096);
+}
+
+TEST_CASE("compressed_bitmap (bitwise operations)",
+          "[bitmap][compressed_bitmap]") {
+  std::mt19937_64 rng(random_seed);
+
+  for (const auto& [lhs_bits, rhs_bits] :
+       {std::pair<uint64_t, uint64_t>{1'000'000, 1'000'000},
+        {1'000'000, 700'001},
+        {700'001, 1'000'000},
+        {65'536, 65'537}}) {
+    for (int round = 0; round < 4; round++) {
+      const auto lhs = generate_random_bitmap(lhs_bits, rng);
+      const auto rhs = generate_random_bitmap(rhs_bits, rng);
+      const yat::compressed_bitmap clhs{lhs};
+      const yat::compressed_bitmap crhs{rhs};
+
+      for (const auto op : {yat::bitwise_op::bit_and, yat::bitwise_op::bit_or,
+                            yat::bitwise_op::bit_xor,
+                            yat::bitwise_op::bit_and_not}) {
+        check_equal(yat::apply(op, clhs, crhs), yat::apply(op, lhs, rhs));
+      }
+
+      check_equal(clhs & crhs, lhs & rhs);
+      check_equal(clhs | crhs, lhs | rhs);
+      check_equal(clhs ^ crhs, lhs ^ rhs);
+      check_equal(yat::and_not(clhs, crhs), yat::and_not(lhs, rhs));
+
+      auto copy = clhs;
+      copy &= clhs;
+      check_equal(copy, lhs);
+      copy ^= clhs;
+      REQUIRE(copy.num_chunks() == 0);
+    }
+  }
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2020 Joe T. Sylve, Ph.D.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <yatlib/hierarchical_bitmap.hpp>
+
+#include "common.hpp"
+
+// Checks the searches of a hierarchical bitmap against a flat bitmap
+static void check_searches(const yat::hierarchical_bitmap& hbm,
+                           const yat::bitmap& bm, std::mt19937_64& rng) {
+  const yat::bitmap_view view{bm};
+
+  REQUIRE(hbm.count() == bm.count());
+  REQUIRE(hbm.all_set() == view.all_set());
+  REQUIRE(hbm.any_set() == view.any_set());
+  REQUIRE(hbm.none_set() == view.none_set());
+
+  for (int i = 0; i < 200; i++) {
+    const auto first = rng() % (bm.count() + 2);
+
+    REQUIRE(hbm.find_next_set(first) == view.find_next_set(first));
+    REQUIRE(hbm.find_next_clear(first) == view.find_next_clear(first));
+
+    const auto length = uint64_t{1} << (rng() % 12);
+    REQUIRE(hbm.find_first_run(length, true, first) ==
+            view.find_first_run(length, true, first));
+    REQUIRE(hbm.find_first_run(length, false, first) ==
+            view.find_first_run(length, false, first));
+    REQUIRE(hbm.find_sparse_region(length, 0, first) ==
+            view.find_first_run(length, false, first));
+  }
+}
+
+// Finds the first sparse region by counting the set bits in every region
+static uint64_t find_sparse_region(const yat::bitmap& bm, uint64_t length,
+                                   uint64_t max_set, uint64_t first) {
+  const yat::bitmap_view view{bm};
+
+  for (auto start = first; start <= bm.count() && bm.count() - start >= length;
+       start++) {
+    if (view.count_set(start, length) <= max_set) {
+      return start;
+    }
+  }
+
+  return yat::hierarchical_bitmap::no_bits_left;
+}
+
+TEST_CASE("hierarchical_bitmap", "[bitmap][hierarchical_bitmap]") {
+  std::mt19937_64 rng(random_seed);
+
+  for (const uint64_t num_bits :
+       {uint64_t{1}, uint64_t{64}, uint64_t{65}, uint64_t{4096},
+        uint64_t{4097}, uint64_t{300'000}, uint64_t{262'145}}) {
+    yat::hierarchical_bitmap hbm{num_bits};
+    yat::bitmap bm{num_bits};
+
+    REQUIRE(hbm.none_set());
+    check_searches(hbm, bm, rng);
+
+    for (int round = 0; round < 50; round++) {
+      const auto start = rng() % num_bits;
+      const auto count = rng() % (num_bits - start + 1) / (1 + rng() % 64);
+
+      switch (rng() % 6) {
+        case 0:
+          hbm.set(start);
+          bm.set(start);
+          break;
+        case 1:
+          hbm.clear(start);
+          bm.clear(start);
+          break;
+        case 2:
+          hbm.flip(start, count);
+          bm.flip(start, count);
+          break;
+        case 3:
+          hbm.set(start, count);
+          bm.set(start, count);
+          break;
+        case 4:
+          hbm.clear(start, count);
+          bm.clear(start, count);
+          break;
+        default:
+          hbm.flip(start);
+          bm.flip(start);
+          break;
+      }
+
+      REQUIRE(hbm[start] == bm[start]);
+      check_searches(hbm, bm, rng);
+    }
+
+    // Fill everything so that searches for unset bits have to fail
+    hbm.set(0, num_bits);
+    bm.set(0, num_bits);
+    REQUIRE(hbm.all_set());
+    check_searches(hbm, bm, rng);
+
+    // Leave a single unset bit at the very end
+    hbm.clear(num_bits - 1);
+    bm.clear(num_bits - 1);
+    REQUIRE(hbm.find_next_clear(0) == num_bits - 1);
+    check_searches(hbm, bm, rng);
+
+    // Copying from a view builds the same summaries
+    const yat::hierarchical_bitmap copy{yat::bitmap_view{hbm.bits()}};
+    check_searches(copy, bm, rng);
+  }
+}
+
+TEST_CASE("hierarchical_bitmap sparse regions",
+          "[bitmap][hierarchical_bitmap]") {
+  std::mt19937_64 rng(random_seed);
+
+  for (int round = 0; round < 200; round++) {
+    const auto num_bits = rng() % 3000 + 1;
+    yat::hierarchical_bitmap hbm{num_bits};
+
+    // Mix dense runs with scattered bits
+    for (int i = 0; i < 20; i++) {
+      const auto start = rng() % num_bits;
+      hbm.set(start, std::min(num_bits - start, rng() % 300));
+
+      for (int j = 0; j < 10; j++) {
+        hbm.set(rng() % num_bits);
+      }
+
+      const auto hole = rng() % num_bits;
+      hbm.clear(hole, std::min(num_bits - hole, rng() % 100));
+    }
+
+    for (int i = 0; i < 20; i++) {
+      const auto first = rng() % (num_bits + 2);
+      const auto length = rng() % 400;
+      const auto max_set = rng() % 3 == 0 ? 0 : rng() % 40;
+
+      REQUIRE(hbm.find_sparse_region(length, max_set, first) ==
+              find_sparse_region(hbm.bits(), length, max_set, first));
+    }
+  }
+
+  // A dense region is skipped a run at a time
+  yat::hierarchical_bitmap hbm{1 << 20};
+  hbm.set(0, 1 << 19);
+  hbm.set(600'000);
+  hbm.set(600'010);
+  REQUIRE(hbm.find_sparse_region(1 << 16, 1) == (1 << 19) - 1);
+  REQUIRE(hbm.find_sparse_region(1 << 16, 2) == (1 << 19) - 2);
+  REQUIRE(hbm.find_sparse_region(200'000, 0) == 600'011);
+  REQUIRE(hbm.find_sparse_region(200'000, 2) == 1 << 19);
+  REQUIRE(hbm.find_sparse_region(1 << 20, 1 << 19) ==
+          yat::hierarchical_bitmap::no_bits_left);
+}
+
+TEST_CASE("hierarchical_bitmap (empty)", "[bitmap][hierarchical_bitmap]") {
+  const yat::hierarchical_bitmap hbm{};
+
+  REQUIRE(hbm.count() == 0);
+  REQUIRE(hbm.all_set());
+  REQUIRE(hbm.none_set());
+  REQUIRE(hbm.find_next_set(0) == yat::hierarchical_bitmap::no_bits_left);
+  REQUIRE(hbm.find_next_clear(0) == yat::hierarchical_bitmap::no_bits_left);
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright 2020 Joe T. Sylve, Ph.D.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <fstream>
+#include <random>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include <yatlib/mapped_bitmap.hpp>
+
+#include "common.hpp"
+
+// A file in the temp directory that is removed when it goes out of scope
+struct temp_file {
+  explicit temp_file(const std::string& name)
+      : path{yat::filesystem::temp_directory_path() /
+             ("yatlib_" + name + "_" + std::to_string(random_seed))} {
+    yat::filesystem::remove(path);
+  }
+
+  temp_file(const temp_file&) = delete;
+  temp_file& operator=(const temp_file&) = delete;
+
+  ~temp_file() {
+    std::error_code ec{};
+    yat::filesystem::remove(path, ec);
+  }
+
+  yat::filesystem::path path;
+};
+
+TEST_CASE("mapped_bitmap_view", "[bitmap][mapped_bitmap]") {
+  const temp_file file{"mapped_bitmap_view"};
+
+  // Write a header followed by the bitmap at an offset that isn't page aligned
+  constexpr uint64_t offset = 4104;
+  constexpr uint64_t num_bits = 1'000'003;
+
+  std::mt19937_64 rng(random_seed);
+  std::vector<yat::little_uint64_t> words((offset + num_bits / 8 + 1) / 8 + 1);
+
+  for (auto& w : words) {
+    w = rng() & rng();
+  }
+
+  {
+    yat::ofstream out{file.path, std::ios::binary};
+    out.write(reinterpret_cast<const char*>(words.data()),
+              static_cast<std::streamsize>(offset + (num_bits + 7) / 8));
+  }
+
+  const yat::mapped_bitmap_view view{file.path, offset, num_bits};
+  const yat::bitmap_view expected{&words[offset / 8], num_bits};
+
+  REQUIRE(view.count() == num_bits);
+  REQUIRE(scan(yat::bitmap_scanner{view}) ==
+          scan(yat::bitmap_scanner{expected}));
+  REQUIRE(scan(yat::bitmap_scanner{view, false}) ==
+          scan(yat::bitmap_scanner{expected, false}));
+
+  // Moving the view keeps the mapping alive
+  const auto moved = yat::mapped_bitmap_view{file.path, offset, num_bits,
+                                             {false, false}};
+  REQUIRE(yat::bitmap{moved}.count() == num_bits);
+  REQUIRE(yat::bitmap_view{moved}.find_next_set(0) ==
+          expected.find_next_set(0));
+
+  // A view that was moved from is left empty
+  yat::mapped_bitmap_view source{file.path, offset, num_bits};
+  yat::mapped_bitmap_view target{std::move(source)};
+  REQUIRE(source.count() == 0);
+  REQUIRE(source.words().empty());
+  REQUIRE(scan(yat::bitmap_scanner{target}) ==
+          scan(yat::bitmap_scanner{expected}));
+
+  source = std::move(target);
+  REQUIRE(target.count() == 0);
+  REQUIRE(target.words().empty());
+  REQUIRE(source.count() == num_bits);
+
+  std::error_code ec{};
+
+  // The offset has to be word aligned
+  const yat::mapped_bitmap_view misaligned{file.path, offset + 1, 64, {}, ec};
+  REQUIRE(ec == std::errc::invalid_argument);
+  REQUIRE(misaligned.count() == 0);
+
+  // The file has to be big enough
+  const yat::mapped_bitmap_view too_big{file.path, offset, num_bits + 64, {},
+                                        ec};
+  REQUIRE(ec == std::errc::invalid_argument);
+
+  // The file has to exist
+  const yat::mapped_bitmap_view missing{file.path / "missing", 0, 64, {}, ec};
+  REQUIRE(ec);
+  REQUIRE_THROWS_AS((yat::mapped_bitmap_view{file.path / "missing", 0, 64}),
+                    yat::filesystem::filesystem_error);
+}
+
+TEST_CASE("mapped_bitmap", "[bitmap][mapped_bitmap]") {
+  const temp_file file{"mapped_bitmap"};
+
+  constexpr uint64_t offset = 64;
+  constexpr uint64_t num_bits = 300'001;
+
+  yat::bitmap expected{num_bits};
+
+  {
+    // The file is created and extended
+    yat::mapped_bitmap bm{file.path, offset, num_bits};
+
+    REQUIRE(bm.count() == num_bits);
+    REQUIRE(bm.view().none_set());
+
+    bm.set(5);
+    bm.set(1000, 100'000);
+    bm.clear(50'000, 10);
+    bm.flip(299'000, 1001);
+    bm.flip(7);
+    bm.clear(5);
+
+    expected.set(5);
+    expected.set(1000, 100'000);
+    expected.clear(50'000, 10);
+    expected.flip(299'000, 1001);
+    expected.flip(7);
+    expected.clear(5);
+
+    REQUIRE(bm[7]);
+    REQUIRE(!bm[5]);
+    REQUIRE(scan(yat::bitmap_scanner{bm}) ==
+            scan(yat::bitmap_scanner{expected}));
+
+    bm.sync();
+  }
+
+  REQUIRE(yat::filesystem::file_size(file.path) >= offset + num_bits / 8);
+
+  // The changes made it to the file
+  const yat::mapped_bitmap_view view{file.path, offset, num_bits};
+  REQUIRE(scan(yat::bitmap_scanner{view}) ==
+          scan(yat::bitmap_scanner{expected}));
+
+  // A bitmap that was moved from is left empty
+  yat::mapped_bitmap source{file.path, offset, num_bits};
+  yat::mapped_bitmap target{std::move(source)};
+  REQUIRE(source.count() == 0);
+  REQUIRE(source.view().words().empty());
+  REQUIRE(target[7]);
+
+  source = std::move(target);
+  REQUIRE(target.count() == 0);
+  REQUIRE(target.view().words().empty());
+  REQUIRE(source.count() == num_bits);
+  REQUIRE(source[7]);
+
+  std::error_code ec{};
+  const yat::mapped_bitmap misaligned{file.path, 4, 64, {}, ec};
+  REQUIRE(ec == std::errc::invalid_argument);
+}
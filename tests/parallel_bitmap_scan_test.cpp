@@ -0,0 +1,141 @@
+/*
+ * Copyright 2020 Joe T. Sylve, Ph.D.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include <yatlib/parallel_bitmap_scan.hpp>
+
+#include "common.hpp"
+
+static std::vector<yat::bitmap_range> serial_scan(const yat::bitmap& bm,
+                                                  bool scan_set) {
+  std::vector<yat::bitmap_range> ranges{};
+
+  for (const auto& r : yat::bitmap_scanner{bm, scan_set}) {
+    ranges.push_back(r);
+  }
+
+  return ranges;
+}
+
+TEST_CASE("parallel_scan", "[bitmap][parallel_scan]") {
+  std::mt19937_64 rng(random_seed);
+
+  for (const uint64_t num_bits :
+       {uint64_t{0}, uint64_t{1}, uint64_t{511}, uint64_t{512},
+        uint64_t{100'000}, uint64_t{1'000'003}}) {
+    yat::bitmap bm{num_bits};
+
+    // Runs of random lengths, some of which are much longer than a chunk
+    for (uint64_t i = 0; i < num_bits;) {
+      const auto n = std::min<uint64_t>(
+          num_bits - i, (rng() % 8 == 0) ? rng() % 5000 : rng() % 40 + 1);
+
+      if (rng() & 1) {
+        bm.set(i, n);
+      }
+
+      i += n;
+    }
+
+    for (const bool scan_set : {true, false}) {
+      const auto expected = serial_scan(bm, scan_set);
+
+      for (const size_t num_threads : {size_t{1}, size_t{3}, size_t{0}}) {
+        for (const uint64_t chunk_bits : {uint64_t{1}, uint64_t{1000},
+                                          uint64_t{1} << 22}) {
+          const yat::parallel_scan_options options{scan_set, num_threads,
+                                                   chunk_bits};
+
+          REQUIRE(yat::parallel_scan(bm, options) == expected);
+
+          // Gather the ranges from the callbacks and put them back in order
+          std::mutex mutex{};
+          std::vector<std::vector<yat::bitmap_range>> chunks(
+              (num_bits + 1024 * 1024 * 4 - 1) / 512 + 1);
+
+          yat::parallel_scan(
+              bm,
+              [&](uint64_t chunk, yat::span<const yat::bitmap_range> ranges) {
+                const std::lock_guard<std::mutex> lock{mutex};
+                chunks[chunk].assign(ranges.begin(), ranges.end());
+              },
+              options);
+
+          std::vector<yat::bitmap_range> gathered{};
+          for (const auto& c : chunks) {
+            gathered.insert(gathered.end(), c.begin(), c.end());
+          }
+
+          REQUIRE(gathered == expected);
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("parallel_scan (exceptions)", "[bitmap][parallel_scan]") {
+  yat::bitmap bm{100'000};
+  bm.set(0, 100'000);
+
+  const auto fn = [](uint64_t chunk, yat::span<const yat::bitmap_range>) {
+    if (chunk == 7) {
+      throw std::runtime_error("failed");
+    }
+  };
+
+  REQUIRE_THROWS_AS(yat::parallel_scan(bm, fn, {true, 4, 512}),
+                    std::runtime_error);
+}
+
+TEST_CASE("parallel_from_predicate", "[bitmap][parallel_scan]") {
+  std::mt19937_64 rng(random_seed);
+
+  for (const size_t n :
+       {size_t{0}, size_t{1}, size_t{1000}, size_t{100'003}}) {
+    std::vector<int32_t> values(n);
+
+    for (auto& v : values) {
+      v = static_cast<int32_t>(rng() % 200) - 100;
+    }
+
+    const yat::span<const int32_t> span{values};
+    const auto pred = [](int32_t v) { return v % 7 == 0; };
+    const auto serial = yat::bitmap::from_predicate(span, pred);
+    const auto less = yat::bitmap::from_compare(span, yat::compare_op::less, 0);
+
+    for (const size_t num_threads : {size_t{1}, size_t{4}}) {
+      const yat::parallel_scan_options options{true, num_threads, 512};
+
+      const auto bm = yat::parallel_from_predicate(span, pred, options);
+      REQUIRE(bm.count() == n);
+      REQUIRE((bm ^ serial).none_set());
+
+      const auto cmp = yat::parallel_from_compare(span, yat::compare_op::less,
+                                                  0, options);
+      REQUIRE(cmp.count() == n);
+      REQUIRE((cmp ^ less).none_set());
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      REQUIRE(serial[i] == pred(values[i]));
+      REQUIRE(less[i] == (values[i] < 0));
+    }
+  }
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2020 Joe T. Sylve, Ph.D.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <random>
+#include <yatlib/static_bitmap.hpp>
+
+#include "common.hpp"
+
+// Builds a bitmap in a constant expression
+static constexpr yat::static_bitmap<200> make_constant() {
+  yat::static_bitmap<200> bm{};
+
+  bm.set(3);
+  bm.set(60, 80);
+  bm.flip(100, 10);
+  bm.clear(61);
+
+  return bm;
+}
+
+TEST_CASE("static_bitmap (constexpr)", "[bitmap][static_bitmap]") {
+  constexpr auto bm = make_constant();
+
+  STATIC_REQUIRE(bm.count() == 200);
+  STATIC_REQUIRE(bm[3]);
+  STATIC_REQUIRE(!bm[61]);
+  STATIC_REQUIRE(bm.count_set() == 1 + 80 - 1 - 10);
+  STATIC_REQUIRE(bm.all_set(62, 38));
+  STATIC_REQUIRE(bm.none_set(100, 10));
+  STATIC_REQUIRE(bm.any_set());
+  STATIC_REQUIRE(bm.find_next_set(4) == 60);
+  STATIC_REQUIRE(bm.find_next_clear(60) == 61);
+  STATIC_REQUIRE(bm.find_prev_set(60) == 3);
+  STATIC_REQUIRE(bm.find_prev_clear(140) == 109);
+  STATIC_REQUIRE(bm.find_first_run(30, true) == 62);
+  STATIC_REQUIRE(bm.find_first_run(100, true) == bm.no_bits_left);
+  STATIC_REQUIRE(bm == make_constant());
+  STATIC_REQUIRE(bm != yat::static_bitmap<200>{});
+  STATIC_REQUIRE(yat::static_bitmap<0>{}.none_set());
+}
+
+TEST_CASE("static_bitmap", "[bitmap][static_bitmap]") {
+  std::mt19937_64 rng(random_seed);
+
+  constexpr uint64_t num_bits = 1000;
+
+  yat::static_bitmap<num_bits> bm{};
+  yat::bitmap expected{num_bits};
+
+  for (int i = 0; i < 200; i++) {
+    const auto start = rng() % num_bits;
+    const auto count = rng() % (num_bits - start + 1);
+
+    switch (rng() % 3) {
+      case 0:
+        bm.set(start, count);
+        expected.set(start, count);
+        break;
+      case 1:
+        bm.clear(start, count);
+        expected.clear(start, count);
+        break;
+      default:
+        bm.flip(start, count);
+        expected.flip(start, count);
+        break;
+    }
+
+    const auto first = rng() % num_bits;
+    const auto last = first + rng() % (num_bits - first + 1);
+
+    REQUIRE(bm.count_set() == expected.count_set());
+    REQUIRE(bm.count_set(first, last - first) ==
+            expected.count_set(first, last - first));
+    REQUIRE(bm.all_set(first, last - first) ==
+            expected.all_set(first, last - first));
+    REQUIRE(bm.none_set(first, last - first) ==
+            expected.none_set(first, last - first));
+    REQUIRE(bm.find_next_set(first, last) ==
+            expected.find_next_set(first, last));
+    REQUIRE(bm.find_next_clear(first, last) ==
+            expected.find_next_clear(first, last));
+    REQUIRE(bm.find_prev_set(first, last) ==
+            expected.find_prev_set(first, last));
+    REQUIRE(bm.find_prev_clear(first, last) ==
+            expected.find_prev_clear(first, last));
+
+    const auto length = rng() % 50;
+    REQUIRE(bm.find_first_run(length, true, first, last) ==
+            expected.find_first_run(length, true, first, last));
+    REQUIRE(bm.find_first_run(length, false, first, last) ==
+            expected.find_first_run(length, false, first, last));
+  }
+
+  // The bits can be viewed and scanned without copying
+  const yat::bitmap_view view = bm;
+  REQUIRE(view.words().data() == bm.words().data());
+  REQUIRE(yat::bitmap{view}.count_set() == expected.count_set());
+
+  // A copy of a view is trimmed or padded to size
+  const yat::static_bitmap<100> small{expected};
+  REQUIRE(small.count_set() == expected.count_set(0, 100));
+
+  const yat::static_bitmap<2000> large{expected};
+  REQUIRE(large.count_set() == expected.count_set());
+  REQUIRE(large.none_set(1000, 1000));
+}